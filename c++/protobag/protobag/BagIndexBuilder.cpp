@@ -40,6 +40,10 @@ struct BagIndexBuilder::TopicTimeOrderer {
     observed.push(tt);
   }
 
+  void Observe(TopicTime &&tt) {
+    observed.push(std::move(tt));
+  }
+
   template <typename RepeatedPtrFieldT>
   void MoveOrderedTTsTo(RepeatedPtrFieldT &repeated_field) {
     repeated_field.Reserve(int(observed.size()));
@@ -227,6 +231,40 @@ void BagIndexBuilder::Observe(
   }
 }
 
+void BagIndexBuilder::ObserveIndex(BagIndex &&index) {
+  if (_do_timeseries_indexing) {
+    for (const auto &[topic, index_stats] : index.topic_to_stats()) {
+      auto &stats = GetMutableStats(topic);
+      stats.set_n_messages(stats.n_messages() + index_stats.n_messages());
+    }
+
+    if (index.time_ordered_entries_size() > 0) {
+      if (!_tto) {
+        _tto.reset(new TopicTimeOrderer());
+      }
+      for (auto &tt : *index.mutable_time_ordered_entries()) {
+        _tto->Observe(std::move(tt));
+      }
+      *_index.mutable_start() = std::min(_index.start(), index.start());
+      *_index.mutable_end() = std::max(_index.end(), index.end());
+    }
+  }
+
+  if (_do_descriptor_indexing && index.has_descriptor_pool_data()) {
+    if (!_desc_idx) {
+      _desc_idx.reset(new DescriptorIndexer());
+    }
+    auto &dpd = *index.mutable_descriptor_pool_data();
+    for (auto &entry : *dpd.mutable_type_url_to_descriptor()) {
+      _desc_idx->type_url_to_fds.emplace(entry.first, std::move(entry.second));
+    }
+    for (auto &entry : *dpd.mutable_entryname_to_type_url()) {
+      _desc_idx->entryname_to_type_url.emplace(
+        entry.first, std::move(entry.second));
+    }
+  }
+}
+
 BagIndex BagIndexBuilder::Complete(UPtr &&builder) {
   BagIndex index;
 
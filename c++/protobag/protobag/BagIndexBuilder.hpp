@@ -49,6 +49,10 @@ public:
 
   void Observe(const Entry &entry, const std::string &final_entryname="");
 
+  // Observe all the entries of an existing `index` (e.g. of a bag we are
+  // appending to), so that the completed index covers those entries too
+  void ObserveIndex(BagIndex &&index);
+
   // Completes the indexing for `builder` and returns a file `BagIndex`.  This
   // process moves some resources directly to `BagIndex` from `builder`, so 
   // the given `builder` instance is consumed.
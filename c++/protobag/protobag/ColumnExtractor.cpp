@@ -0,0 +1,327 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "protobag/ColumnExtractor.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#include <fmt/format.h>
+#include <google/protobuf/util/time_util.h>
+
+#include "protobag/Entry.hpp"
+#include "protobag/ReadSession.hpp"
+#include "protobag/Utils/PBUtils.hpp"
+
+namespace protobag {
+
+namespace {
+
+using ::google::protobuf::FieldDescriptor;
+
+ExtractedColumn::Type GetColumnType(const FieldDescriptor *field) {
+  switch (field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_FLOAT:
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      return ExtractedColumn::Type::Double;
+    case FieldDescriptor::CPPTYPE_STRING:
+      return ExtractedColumn::Type::String;
+    default:
+      return ExtractedColumn::Type::Int64;
+  }
+}
+
+Result<int64_t> GetAsInt64(
+    const CompiledFieldPath &path,
+    const ::google::protobuf::Message *message) {
+
+  auto AsInt64 = [](auto maybe_v) -> Result<int64_t> {
+    if (!maybe_v.IsOk()) { return {.error = maybe_v.error}; }
+    return {.value = int64_t(*maybe_v.value)};
+  };
+
+  switch (path.GetLeafField()->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+    case FieldDescriptor::CPPTYPE_ENUM:
+      return AsInt64(path.Get_int32(message));
+    case FieldDescriptor::CPPTYPE_INT64:
+      return AsInt64(path.Get_int64(message));
+    case FieldDescriptor::CPPTYPE_UINT32:
+      return AsInt64(path.Get_uint32(message));
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return AsInt64(path.Get_uint64(message));
+    case FieldDescriptor::CPPTYPE_BOOL:
+      return AsInt64(path.Get_bool(message));
+    default:
+      return {.error = fmt::format(
+        "Field path {} is not an integer", path.GetPath())
+      };
+  }
+}
+
+// Decodes rows [begin, end) of `chunk` into rows [row0 + begin, row0 + end)
+// of `columns`; string values go to `strings[column][row]` for now since
+// they can't be written in parallel
+struct ChunkDecoder {
+  DynamicMsgFactory &factory;
+  const ::google::protobuf::Message *prototype;
+  const std::string &type_url;
+  const std::vector<CompiledFieldPath> &paths;
+  const std::vector<Entry> &chunk;
+  size_t row0;
+  std::vector<ExtractedColumn> &columns;
+  std::vector<std::vector<std::string>> &strings;
+
+  OkOrErr Decode(size_t begin, size_t end) {
+    std::unique_ptr<::google::protobuf::Message> msg(prototype->New());
+    for (size_t i = begin; i < end; ++i) {
+      const Entry &entry = chunk[i];
+      if (entry.msg.type_url() != type_url) {
+        return {.error = fmt::format(
+          "Entry {} has type {} but expected {}; topics with mixed types "
+          "are not supported",
+          entry.entryname, entry.msg.type_url(), type_url)
+        };
+      }
+
+      if (entry.msg.value().empty()) {
+        // All default values
+        msg->Clear();
+      } else {
+        auto status = factory.LoadFromContainer(
+          type_url, entry.msg.value(), msg);
+        if (!status.IsOk()) {
+          return {.error = fmt::format(
+            "Failed to decode {}: {}", entry.entryname, status.error)
+          };
+        }
+      }
+
+      const size_t row = row0 + i;
+      for (size_t c = 0; c < paths.size(); ++c) {
+        ExtractedColumn &column = columns[c];
+        switch (column.type) {
+          case ExtractedColumn::Type::Double: {
+            auto maybe_v = paths[c].Get_as_double(msg.get());
+            column.valid[row] = maybe_v.IsOk();
+            column.doubles[row] = maybe_v.IsOk() ? 
+              *maybe_v.value : std::numeric_limits<double>::quiet_NaN();
+            break;
+          }
+          case ExtractedColumn::Type::Int64: {
+            auto maybe_v = GetAsInt64(paths[c], msg.get());
+            column.valid[row] = maybe_v.IsOk();
+            column.int64s[row] = maybe_v.IsOk() ? *maybe_v.value : 0;
+            break;
+          }
+          case ExtractedColumn::Type::String: {
+            auto maybe_v = paths[c].Get_string(msg.get());
+            column.valid[row] = maybe_v.IsOk();
+            if (maybe_v.IsOk()) {
+              strings[c][i] = std::move(*maybe_v.value);
+            }
+            break;
+          }
+        }
+      }
+    }
+    return kOK;
+  }
+};
+
+} // anon namespace
+
+Result<ExtractedColumns> ColumnExtractor::Extract(const Spec &spec) {
+  if (spec.field_paths.empty()) {
+    return {.error = "ColumnExtractor needs at least one field path"};
+  }
+  if (spec.chunk_size == 0) {
+    return {.error = "ColumnExtractor needs a chunk_size of at least 1"};
+  }
+
+  Selection sel;
+  sel.mutable_window()->add_topics(spec.topic);
+  auto maybe_rs = ReadSession::Create({
+    .archive_spec = spec.archive_spec,
+    .selection = sel,
+    .unpack_stamped_messages = true,
+    .sequential_reads = true,
+  });
+  if (!maybe_rs.IsOk()) {
+    return {.error = maybe_rs.error};
+  }
+  ReadSession &rs = **maybe_rs.value;
+
+  // Decode using the descriptors in the index
+  DynamicMsgFactory factory;
+  {
+    auto maybe_index = rs.ReadIndex();
+    if (!maybe_index.IsOk()) {
+      return {.error = fmt::format(
+        "ColumnExtractor needs an index: {}", maybe_index.error)
+      };
+    }
+    const auto &dpd = maybe_index.value->descriptor_pool_data();
+    for (const auto &entry : dpd.type_url_to_descriptor()) {
+      factory.RegisterTypes(entry.second);
+    }
+  }
+
+  size_t num_threads = spec.num_threads;
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  ExtractedColumns result;
+  result.topic = spec.topic;
+  const ::google::protobuf::Message *prototype = nullptr;
+  std::vector<CompiledFieldPath> paths;
+
+  bool reading = true;
+  while (reading) {
+
+    // Read a chunk
+    std::vector<Entry> chunk;
+    chunk.reserve(spec.chunk_size);
+    while (reading && chunk.size() < spec.chunk_size) {
+      auto maybe_entry = rs.GetNext();
+      if (maybe_entry.IsEndOfSequence()) {
+        reading = false;
+      } else if (!maybe_entry.IsOk()) {
+        return {.error = maybe_entry.error};
+      } else if (maybe_entry.value->ctx.has_value()) {
+        chunk.push_back(std::move(*maybe_entry.value));
+      } // else ignore entries that lack a timestamp
+    }
+    if (chunk.empty()) {
+      continue;
+    }
+
+    // Set up columns from the first message
+    if (!prototype) {
+      result.type_url = chunk.front().msg.type_url();
+      auto maybe_prototype = factory.GetPrototype(result.type_url);
+      if (!maybe_prototype.IsOk()) {
+        return {.error = fmt::format(
+          "Can't decode messages on topic {}: {}",
+          spec.topic, maybe_prototype.error)
+        };
+      }
+      prototype = *maybe_prototype.value;
+
+      for (const auto &field_path : spec.field_paths) {
+        auto maybe_path = CompiledFieldPath::Compile(
+          prototype->GetDescriptor(), field_path);
+        if (!maybe_path.IsOk()) {
+          return {.error = maybe_path.error};
+        }
+        const FieldDescriptor *leaf = maybe_path.value->GetLeafField();
+        if (leaf->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE) {
+          return {.error = fmt::format(
+            "Field path {} is a message, not a scalar", field_path)
+          };
+        }
+        
+        ExtractedColumn column;
+        column.field_path = field_path;
+        column.type = GetColumnType(leaf);
+        if (column.type == ExtractedColumn::Type::String) {
+          column.string_offsets.push_back(0);
+        }
+        result.columns.push_back(std::move(column));
+        paths.push_back(std::move(*maybe_path.value));
+      }
+    }
+
+    // Decode the chunk in parallel
+    const size_t row0 = result.NumRows();
+    const size_t n = chunk.size();
+    for (const auto &entry : chunk) {
+      result.timestamp_ns.push_back(
+        ::google::protobuf::util::TimeUtil::TimestampToNanoseconds(
+          entry.ctx->stamp));
+    }
+    for (auto &column : result.columns) {
+      column.valid.resize(row0 + n);
+      if (column.type == ExtractedColumn::Type::Double) {
+        column.doubles.resize(row0 + n);
+      } else if (column.type == ExtractedColumn::Type::Int64) {
+        column.int64s.resize(row0 + n);
+      }
+    }
+    std::vector<std::vector<std::string>> strings(
+      result.columns.size(), std::vector<std::string>(n));
+
+    ChunkDecoder decoder{
+      .factory = factory,
+      .prototype = prototype,
+      .type_url = result.type_url,
+      .paths = paths,
+      .chunk = chunk,
+      .row0 = row0,
+      .columns = result.columns,
+      .strings = strings,
+    };
+
+    const size_t n_workers = std::min(num_threads, n);
+    const size_t rows_per_worker = (n + n_workers - 1) / n_workers;
+    std::vector<OkOrErr> statuses(n_workers);
+    {
+      std::vector<std::thread> workers;
+      for (size_t w = 1; w < n_workers; ++w) {
+        workers.emplace_back([&, w]() {
+          statuses[w] = decoder.Decode(
+            w * rows_per_worker, std::min(n, (w + 1) * rows_per_worker));
+        });
+      }
+      statuses[0] = decoder.Decode(0, std::min(n, rows_per_worker));
+      for (auto &worker : workers) {
+        worker.join();
+      }
+    }
+    for (const auto &status : statuses) {
+      if (!status.IsOk()) {
+        return {.error = status.error};
+      }
+    }
+
+    // Pack strings
+    for (size_t c = 0; c < result.columns.size(); ++c) {
+      ExtractedColumn &column = result.columns[c];
+      if (column.type == ExtractedColumn::Type::String) {
+        for (const auto &s : strings[c]) {
+          column.string_data += s;
+          column.string_offsets.push_back(column.string_data.size());
+        }
+      }
+    }
+  }
+
+  if (!prototype) {
+    // No messages; we can't know column types, but report empty columns
+    for (const auto &field_path : spec.field_paths) {
+      ExtractedColumn column;
+      column.field_path = field_path;
+      result.columns.push_back(std::move(column));
+    }
+  }
+
+  return {.value = std::move(result)};
+}
+
+} /* namespace protobag */
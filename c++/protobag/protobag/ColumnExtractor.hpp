@@ -0,0 +1,83 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "protobag/archive/Archive.hpp"
+#include "protobag/Utils/Result.hpp"
+
+namespace protobag {
+
+// A single column of values extracted from a field path (see
+// `CompiledFieldPath`) of each message on a topic.  Values are stored in
+// contiguous (struct-of-arrays) buffers suitable for zero-copy export (e.g.
+// to numpy):
+//  * Double: float and double fields
+//  * Int64: integer, bool and enum (number) fields
+//  * String: string and bytes fields; row i is
+//      string_data[string_offsets[i]:string_offsets[i + 1]]
+// If a row lacks the value (e.g. a map key or repeated index is missing),
+// `valid[i]` is 0 and the value is 0 (or NaN or "").
+struct ExtractedColumn {
+  enum class Type { Double, Int64, String };
+
+  std::string field_path;
+  Type type = Type::Double;
+  
+  std::vector<double> doubles;
+  std::vector<int64_t> int64s;
+  std::string string_data;
+  std::vector<int64_t> string_offsets;
+
+  std::vector<uint8_t> valid;
+};
+
+// Columns for all messages on one topic, in time order
+struct ExtractedColumns {
+  std::string topic;
+  std::string type_url;
+
+  // Nanoseconds since the epoch
+  std::vector<int64_t> timestamp_ns;
+  
+  std::vector<ExtractedColumn> columns;
+
+  size_t NumRows() const { return timestamp_ns.size(); }
+};
+
+// Extracts scalar fields from every message on a topic into columns.  Reads
+// messages in chunks of `chunk_size` and decodes each chunk in parallel
+// using `num_threads` threads (and the descriptors in the protobag's index,
+// so generated code for the messages is not needed).
+class ColumnExtractor final {
+public:
+  struct Spec {
+    archive::Archive::Spec archive_spec;
+    std::string topic;
+    std::vector<std::string> field_paths;
+
+    size_t chunk_size = 4096;
+    size_t num_threads = 0; // 0 means use std::thread::hardware_concurrency()
+  };
+
+  static Result<ExtractedColumns> Extract(const Spec &spec);
+};
+
+} /* namespace protobag */
@@ -69,19 +69,15 @@ std::string Entry::ToString() const {
 //     ));
 // }
 
-bool MaybeEntry::IsNotFound() const {
-  static const std::string kIsNotFoundPrefix = 
-    archive::Archive::ReadStatus::EntryNotFound().error + ": ";
-  return error.find(kIsNotFoundPrefix) == 0;
-}
-
 MaybeEntry MaybeEntry::NotFound(const std::string &entryname) {
-  MaybeEntry m;
-  m.error = fmt::format(
-    "{}: {}",
-    archive::Archive::ReadStatus::EntryNotFound().error,
-    entryname);
-  return m;
+  static const std::string kNotFound = 
+    archive::Archive::ReadStatus::EntryNotFound().error;
+  if (entryname.empty()) {
+    return Err(kNotFound, ResultCode::kNotFound);
+  } else {
+    return Err(
+      fmt::format("{}: {}", kNotFound, entryname), ResultCode::kNotFound);
+  }
 }
 
 std::string GetTopicFromEntryname(const std::string &entryname) {
@@ -319,16 +319,20 @@ struct Entry {
 // A Result<Entry> with a reserved "error" state for end of a stream of
 // entries; similar to python `StopIteration`.
 struct MaybeEntry : public Result<Entry> {
-  static MaybeEntry EndOfSequence() { return Err("EndOfSequence"); }
-  bool IsEndOfSequence() const { return error == "EndOfSequence"; }
+  static MaybeEntry EndOfSequence() {
+    return Err("EndOfSequence", ResultCode::kEndOfSequence);
+  }
+  bool IsEndOfSequence() const { return Is(ResultCode::kEndOfSequence); }
 
   // See Archive::ReadStatus for definition; this can be an acceptible error
-  bool IsNotFound() const;
+  bool IsNotFound() const { return Is(ResultCode::kNotFound); }
 
-  static MaybeEntry NotFound(const std::string &entryname);
+  // A not found error with (if given) the missing `entryname` in its message
+  static MaybeEntry NotFound(const std::string &entryname="");
 
-  static MaybeEntry Err(const std::string &s) {
-    MaybeEntry m; m.error = s; return m;
+  static MaybeEntry Err(
+      const std::string &s, ResultCode c = ResultCode::kError) {
+    MaybeEntry m; m.error = s; m.code = c; return m;
   }
 
   static MaybeEntry Ok(Entry &&v) {
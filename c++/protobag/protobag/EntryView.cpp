@@ -0,0 +1,127 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "protobag/EntryView.hpp"
+
+#include <fmt/format.h>
+
+#include "protobag/Utils/PBUtils.hpp"
+#include "protobag/Utils/WireScan.hpp"
+
+namespace protobag {
+
+const EntryView::Header &EntryView::GetHeader() const {
+  if (_header.has_value()) {
+    return *_header;
+  }
+
+  auto SpanOf = [&](std::string_view view) {
+    return view.empty() ?
+      Span{} : 
+      Span{.pos = size_t(view.data() - _bytes.data()), .size = view.size()};
+  };
+
+  Header header;
+  AnyView any;
+  if (_raw) {
+    header.payload = Span{.pos = 0, .size = _bytes.size()};
+  } else if (ScanAny(_bytes, any)) {
+    static const std::string kStampedTypeURL =
+      ::protobag::GetTypeURL<StampedMessage>();
+    if (any.type_url == kStampedTypeURL) {
+      StampedMessageView stamped;
+      if (ScanStampedMessage(any.value, stamped)) {
+        header.valid = true;
+        header.stamped = true;
+        header.type_url = SpanOf(stamped.msg.type_url);
+        header.payload = SpanOf(stamped.msg.value);
+        header.timestamp = SpanOf(stamped.timestamp);
+      }
+    } else {
+      header.valid = true;
+      header.type_url = SpanOf(any.type_url);
+      header.payload = SpanOf(any.value);
+    }
+  }
+  _header = header;
+  return *_header;
+}
+
+std::optional<::google::protobuf::Timestamp> EntryView::GetStamp() const {
+  const Header &header = GetHeader();
+  if (!header.stamped) {
+    return std::nullopt;
+  }
+
+  ::google::protobuf::Timestamp t;
+  const auto data = GetView(header.timestamp);
+  if (!t.ParseFromArray(data.data(), int(data.size()))) {
+    return std::nullopt;
+  }
+  return t;
+}
+
+MaybeEntry EntryView::ToEntry(bool unpack_stamped) const {
+  if (_raw) {
+    Entry entry;
+    entry.entryname = _entryname;
+    entry.msg.set_value(_bytes);
+    return MaybeEntry::Ok(std::move(entry));
+  }
+
+  const Header &header = GetHeader();
+  if (header.valid && (!header.stamped || unpack_stamped)) {
+    // Copy just the payload
+    Entry entry{.entryname = _entryname};
+    const auto type_url = GetTypeURL();
+    const auto payload = GetPayload();
+    entry.msg.set_type_url(type_url.data(), type_url.size());
+    entry.msg.set_value(payload.data(), payload.size());
+    if (header.stamped) {
+      auto maybe_stamp = GetStamp();
+      if (!maybe_stamp.has_value()) {
+        return MaybeEntry::Err(fmt::format(
+          "Failed to decode StampedMessage timestamp from {}", _entryname));
+      }
+      entry.ctx = Entry::Context{
+        .topic = GetTopic(),
+        .stamp = *maybe_stamp,
+        .inner_type_url = entry.msg.type_url(),
+      };
+    }
+    return MaybeEntry::Ok(std::move(entry));
+  }
+
+  // Decode the whole entry (e.g. for text format entries)
+  auto maybe_any = 
+    PBFactory::LoadFromContainer<::google::protobuf::Any>(_bytes);
+  if (!maybe_any.IsOk()) {
+    return MaybeEntry::Err(fmt::format(
+      "Could not read protobuf from {}: {}", _entryname, maybe_any.error));
+  }
+
+  Entry entry{
+    .entryname = _entryname,
+    .msg = std::move(*maybe_any.value),
+  };
+  if (unpack_stamped && entry.IsStampedMessage()) {
+    return entry.UnpackFromStamped();
+  } else {
+    return MaybeEntry::Ok(std::move(entry));
+  }
+}
+
+} /* namespace protobag */
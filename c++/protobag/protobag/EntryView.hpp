@@ -0,0 +1,118 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <google/protobuf/timestamp.pb.h>
+
+#include "protobag/Entry.hpp"
+#include "protobag/Utils/Result.hpp"
+
+namespace protobag {
+
+// A lazily-decoded entry: holds an entry's undecoded archive data and only
+// decodes what is asked for.  The first call to an accessor of the header
+// (type URL, timestamp, ...) scans just the framing of the entry (i.e. the
+// Any and any StampedMessage fields) without parsing or copying the
+// payload; the payload is only decoded in `ToEntry()`.  Useful for readers
+// that route, count, or drop entries by topic and time.
+class EntryView final {
+public:
+  EntryView() = default;
+  EntryView(std::string entryname, std::string &&bytes, bool raw = false)
+    : _entryname(std::move(entryname)), _bytes(std::move(bytes)), _raw(raw)
+  { }
+
+  const std::string &GetEntryname() const { return _entryname; }
+
+  // The undecoded archive data for this entry
+  const std::string &GetBytes() const { return _bytes; }
+
+  bool IsStampedMessage() const { return GetHeader().stamped; }
+
+  // Raw entries (or entries that aren't framed as Protobag writes them)
+  // have no type URL
+  bool IsRaw() const { return GetTypeURL().empty(); }
+
+  // The type URL of the innermost message (not StampedMessage)
+  std::string_view GetTypeURL() const {
+    return GetView(GetHeader().type_url);
+  }
+
+  // The topic of a StampedMessage entry, else empty
+  std::string GetTopic() const {
+    return IsStampedMessage() ? GetTopicFromEntryname(_entryname) : "";
+  }
+
+  // The timestamp of a StampedMessage entry, else nullopt
+  std::optional<::google::protobuf::Timestamp> GetStamp() const;
+
+  // The serialized innermost message
+  std::string_view GetPayload() const {
+    return GetView(GetHeader().payload);
+  }
+
+  // Fully decode this view into an `Entry` (which is the same as what
+  // `ReadSession::GetNext()` would have emitted)
+  MaybeEntry ToEntry(bool unpack_stamped = true) const;
+
+protected:
+  std::string _entryname;
+  std::string _bytes;
+  bool _raw = false;
+
+  // Offsets into `_bytes` (rather than views, which moves can invalidate)
+  struct Span {
+    size_t pos = 0;
+    size_t size = 0;
+  };
+  struct Header {
+    bool valid = false;
+    bool stamped = false;
+    Span type_url;
+    Span payload;
+    Span timestamp;
+  };
+  mutable std::optional<Header> _header;
+
+  const Header &GetHeader() const;
+  
+  std::string_view GetView(const Span &span) const {
+    return std::string_view(_bytes).substr(span.pos, span.size);
+  }
+};
+
+
+// A MaybeEntry for EntryViews
+struct MaybeEntryView : public Result<EntryView> {
+  bool IsEndOfSequence() const { return Is(ResultCode::kEndOfSequence); }
+  bool IsNotFound() const { return Is(ResultCode::kNotFound); }
+
+  // Carry over the (error) status of `m`
+  static MaybeEntryView FromStatus(const MaybeEntry &m) {
+    MaybeEntryView v; v.error = m.error; v.code = m.code; return v;
+  }
+
+  static MaybeEntryView Ok(EntryView &&v) {
+    MaybeEntryView m; m.value = std::move(v); return m;
+  }
+};
+
+} /* namespace protobag */
@@ -0,0 +1,318 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "protobag/FieldFilter.hpp"
+
+#include <fmt/format.h>
+
+namespace protobag {
+
+Result<FieldPredicate::Op> FieldPredicate::OpFromString(const std::string &s) {
+  if (s == "==") {
+    return {.value = Op::EQ};
+  } else if (s == "!=") {
+    return {.value = Op::NE};
+  } else if (s == "<") {
+    return {.value = Op::LT};
+  } else if (s == "<=") {
+    return {.value = Op::LE};
+  } else if (s == ">") {
+    return {.value = Op::GT};
+  } else if (s == ">=") {
+    return {.value = Op::GE};
+  } else if (s == "between") {
+    return {.value = Op::BETWEEN};
+  } else {
+    return {.error = fmt::format("Unknown predicate operator {}", s)};
+  }
+}
+
+double FieldPredicate::Number::AsDouble() const {
+  switch (kind) {
+    case Kind::INT: return double(i);
+    case Kind::UINT: return double(u);
+    default: return d;
+  }
+}
+
+std::string FieldPredicate::Number::ToString() const {
+  switch (kind) {
+    case Kind::INT: return fmt::format("{}", i);
+    case Kind::UINT: return fmt::format("{}", u);
+    default: return fmt::format("{}", d);
+  }
+}
+
+std::string FieldPredicate::ToString() const {
+  static const char * const kOpNames[] = {
+    "==", "!=", "<", "<=", ">", ">=", "between"
+  };
+  const char *op_name = kOpNames[static_cast<int>(op)];
+  if (op == Op::BETWEEN) {
+    return fmt::format(
+      "{} between [{}, {}]", field_path, value.ToString(), upper.ToString());
+  } else if (str_value.has_value()) {
+    return fmt::format("{} {} \"{}\"", field_path, op_name, *str_value);
+  } else {
+    return fmt::format("{} {} {}", field_path, op_name, value.ToString());
+  }
+}
+
+namespace {
+
+template <typename T>
+bool Compare(FieldPredicate::Op op, const T &v, const T &operand) {
+  switch (op) {
+    case FieldPredicate::Op::EQ: return v == operand;
+    case FieldPredicate::Op::NE: return v != operand;
+    case FieldPredicate::Op::LT: return v < operand;
+    case FieldPredicate::Op::LE: return v <= operand;
+    case FieldPredicate::Op::GT: return v > operand;
+    case FieldPredicate::Op::GE: return v >= operand;
+    default: return false;
+  }
+}
+
+// Three-way comparison of integer `Number`s: <0, 0 or >0
+int CompareIntegers(
+    const FieldPredicate::Number &a,
+    const FieldPredicate::Number &b) {
+
+  using Kind = FieldPredicate::Number::Kind;
+  auto Cmp = [](auto x, auto y) { return (x < y) ? -1 : ((y < x) ? 1 : 0); };
+  if (a.kind == Kind::INT && b.kind == Kind::INT) {
+    return Cmp(a.i, b.i);
+  } else if (a.kind == Kind::UINT && b.kind == Kind::UINT) {
+    return Cmp(a.u, b.u);
+  } else if (a.kind == Kind::INT) {
+    return (a.i < 0) ? -1 : Cmp(uint64_t(a.i), b.u);
+  } else {
+    return (b.i < 0) ? 1 : Cmp(a.u, uint64_t(b.i));
+  }
+}
+
+bool Satisfies(
+    FieldPredicate::Op op,
+    const FieldPredicate::Number &v,
+    const FieldPredicate::Number &operand) {
+
+  using Kind = FieldPredicate::Number::Kind;
+  if (v.kind == Kind::DOUBLE || operand.kind == Kind::DOUBLE) {
+    return Compare(op, v.AsDouble(), operand.AsDouble());
+  } else {
+    return Compare(op, CompareIntegers(v, operand), 0);
+  }
+}
+
+// Get the numeric (or bool or enum) value at `path`, keeping integers exact
+Result<FieldPredicate::Number> GetNumber(
+    const CompiledFieldPath &path,
+    const ::google::protobuf::Message *msg) {
+
+  using ::google::protobuf::FieldDescriptor;
+  auto AsNumber = [](auto maybe_v) -> Result<FieldPredicate::Number> {
+    if (!maybe_v.IsOk()) { return {.error = maybe_v.error}; }
+    return {.value = FieldPredicate::Number(*maybe_v.value)};
+  };
+
+  switch (path.GetLeafField()->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+    case FieldDescriptor::CPPTYPE_ENUM:
+      return AsNumber(path.Get_int32(msg));
+    case FieldDescriptor::CPPTYPE_INT64:
+      return AsNumber(path.Get_int64(msg));
+    case FieldDescriptor::CPPTYPE_UINT32:
+      return AsNumber(path.Get_uint32(msg));
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return AsNumber(path.Get_uint64(msg));
+    case FieldDescriptor::CPPTYPE_BOOL:
+      return AsNumber(path.Get_bool(msg));
+    default:
+      return AsNumber(path.Get_as_double(msg));
+  }
+}
+
+bool IsStringLike(const ::google::protobuf::FieldDescriptor *field) {
+  using ::google::protobuf::FieldDescriptor;
+  return 
+    field->cpp_type() == FieldDescriptor::CPPTYPE_STRING ||
+    field->cpp_type() == FieldDescriptor::CPPTYPE_ENUM;
+}
+
+} // anon namespace
+
+Result<FieldFilter::Ptr> FieldFilter::Create(
+    const std::vector<FieldPredicate> &predicates,
+    const BagIndex &index) {
+
+  for (const auto &pred : predicates) {
+    if (pred.op == FieldPredicate::Op::BETWEEN && pred.str_value.has_value()) {
+      return {.error = fmt::format(
+        "Predicate on {}: between only supports numeric values",
+        pred.field_path)
+      };
+    }
+  }
+
+  Ptr filter(new FieldFilter());
+  filter->_predicates = predicates;
+  const auto &dpd = index.descriptor_pool_data();
+  for (const auto &entry : dpd.type_url_to_descriptor()) {
+    filter->_factory.RegisterTypes(entry.second);
+  }
+  return {.value = filter};
+}
+
+FieldFilter::CompiledType &FieldFilter::GetCompiled(
+    const std::string &type_url) {
+
+  auto it = _type_url_to_compiled.find(type_url);
+  if (it != _type_url_to_compiled.end()) {
+    return it->second;
+  }
+
+  CompiledType &compiled = _type_url_to_compiled[type_url];
+  auto maybe_prototype = _factory.GetPrototype(type_url);
+  if (!maybe_prototype.IsOk()) {
+    compiled.error = fmt::format(
+      "Can't apply field predicates to type {}: {}",
+      type_url, maybe_prototype.error);
+    return compiled;
+  }
+  
+  const auto *descriptor = (*maybe_prototype.value)->GetDescriptor();
+  std::vector<CompiledFieldPath> paths;
+  for (const auto &pred : _predicates) {
+    auto maybe_path = CompiledFieldPath::Compile(descriptor, pred.field_path);
+    if (!maybe_path.IsOk()) {
+      compiled.error = fmt::format(
+        "Predicate {} does not apply to type {}: {}",
+        pred.ToString(), type_url, maybe_path.error);
+      return compiled;
+    }
+    paths.push_back(std::move(*maybe_path.value));
+  }
+  compiled.paths = std::move(paths);
+  compiled.msg.reset((*maybe_prototype.value)->New());
+  return compiled;
+}
+
+Result<bool> FieldFilter::Matches(const Entry &entry) {
+  if (_predicates.empty()) {
+    return {.value = true};
+  }
+
+  const ::google::protobuf::Any *any = &entry.msg;
+  StampedMessage stamped;
+  if (entry.IsA<StampedMessage>()) {
+    if (!entry.msg.UnpackTo(&stamped)) {
+      return {.error = fmt::format(
+        "Could not unpack StampedMessage {}", entry.entryname)
+      };
+    }
+    any = &stamped.msg();
+  }
+
+  return MatchesPayload(entry.entryname, any->type_url(), any->value());
+}
+
+Result<bool> FieldFilter::Matches(const EntryView &view) {
+  if (_predicates.empty()) {
+    return {.value = true};
+  }
+
+  if (view.IsRaw()) {
+    // E.g. a text format entry, which we have to decode to inspect
+    auto maybe_entry = view.ToEntry(/* unpack_stamped */ false);
+    if (!maybe_entry.IsOk()) {
+      return {.error = maybe_entry.error};
+    }
+    return Matches(*maybe_entry.value);
+  }
+
+  return MatchesPayload(
+    view.GetEntryname(), std::string(view.GetTypeURL()), view.GetPayload());
+}
+
+Result<bool> FieldFilter::MatchesPayload(
+    const std::string &entryname,
+    const std::string &type_url,
+    std::string_view payload) {
+
+  using ::google::protobuf::FieldDescriptor;
+
+  CompiledType &compiled = GetCompiled(type_url);
+  if (!compiled.error.empty()) {
+    return {.error = fmt::format("{}: {}", entryname, compiled.error)};
+  }
+
+  if (payload.empty()) {
+    // All default values
+    compiled.msg->Clear();
+  } else {
+    auto status = _factory.LoadFromContainer(type_url, payload, compiled.msg);
+    if (!status.IsOk()) {
+      return {.error = fmt::format(
+        "Failed to decode {}: {}", entryname, status.error)
+      };
+    }
+  }
+  const ::google::protobuf::Message *msg = compiled.msg.get();
+
+  for (size_t i = 0; i < _predicates.size(); ++i) {
+    const FieldPredicate &pred = _predicates[i];
+    const CompiledFieldPath &path = compiled.paths[i];
+    const FieldDescriptor *leaf = path.GetLeafField();
+    
+    if (pred.str_value.has_value()) {
+      if (!IsStringLike(leaf)) {
+        return {.error = fmt::format(
+          "Predicate {}: field is a {}, not a string or enum",
+          pred.ToString(), leaf->cpp_type_name())
+        };
+      }
+      auto maybe_v = path.Get_string(msg);
+      if (!maybe_v.IsOk() || !Compare(pred.op, *maybe_v.value, *pred.str_value)) {
+        return {.value = false};
+      }
+    } else {
+      if (leaf->cpp_type() == FieldDescriptor::CPPTYPE_STRING ||
+          leaf->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE) {
+        return {.error = fmt::format(
+          "Predicate {}: field is a {}, not a number",
+          pred.ToString(), leaf->cpp_type_name())
+        };
+      }
+      auto maybe_v = GetNumber(path, msg);
+      if (!maybe_v.IsOk()) {
+        return {.value = false};
+      }
+      const FieldPredicate::Number &v = *maybe_v.value;
+      const bool match = 
+        pred.op == FieldPredicate::Op::BETWEEN ?
+          (Satisfies(FieldPredicate::Op::GE, v, pred.value) &&
+            Satisfies(FieldPredicate::Op::LE, v, pred.upper)) :
+          Satisfies(pred.op, v, pred.value);
+      if (!match) {
+        return {.value = false};
+      }
+    }
+  }
+  return {.value = true};
+}
+
+} /* namespace protobag */
@@ -0,0 +1,140 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "protobag/Entry.hpp"
+#include "protobag/EntryView.hpp"
+#include "protobag/Utils/PBUtils.hpp"
+#include "protobag/Utils/Result.hpp"
+
+#include "protobag_msg/ProtobagMsg.pb.h"
+
+namespace protobag {
+
+// A simple comparison on the value at a field path (see `CompiledFieldPath`)
+// of an entry's message, e.g. "fix_quality >= 4".  Numeric, bool and enum
+// (number) fields compare with `value`; if `str_value` is set, then string,
+// bytes and enum (name) fields compare with `str_value`.
+struct FieldPredicate {
+  enum class Op { EQ, NE, LT, LE, GT, GE, BETWEEN };
+
+  // A numeric operand.  Integer fields compare exactly with integer operands
+  // (a double can't hold every int64 / uint64); if either side is floating
+  // point, both compare as doubles.
+  struct Number {
+    enum class Kind { INT, UINT, DOUBLE };
+    Kind kind = Kind::INT;
+    int64_t i = 0;
+    uint64_t u = 0;
+    double d = 0;
+
+    Number() = default;
+
+    template <
+      typename T,
+      typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    Number(T v) {
+      if constexpr (std::is_floating_point_v<T>) {
+        kind = Kind::DOUBLE;
+        d = v;
+      } else if constexpr (std::is_signed_v<T>) {
+        kind = Kind::INT;
+        i = v;
+      } else {
+        kind = Kind::UINT;
+        u = v;
+      }
+    }
+
+    double AsDouble() const;
+    std::string ToString() const;
+  };
+
+  std::string field_path;
+  Op op = Op::EQ;
+  
+  Number value;
+  
+  // Inclusive upper bound for BETWEEN (`value` is the inclusive lower bound)
+  Number upper;
+  
+  std::optional<std::string> str_value;
+
+  // Parse an Op from "==", "!=", "<", "<=", ">", ">=" or "between"
+  static Result<Op> OpFromString(const std::string &s);
+
+  std::string ToString() const;
+};
+
+// Evaluates a conjunction of `FieldPredicate`s on entries, decoding messages
+// using the descriptors in a protobag index.  An entry matches only if every
+// predicate is satisfied; entries that lack the value (e.g. a missing map
+// key) don't match.  Every entry given to the filter must have a type that
+// the index can decode and that has every predicate's field (so e.g. a typo
+// in a field path is an error rather than an empty result); select only
+// the topics that the predicates apply to.  Not thread-safe.
+class FieldFilter final {
+public:
+  typedef std::shared_ptr<FieldFilter> Ptr;
+
+  static Result<Ptr> Create(
+    const std::vector<FieldPredicate> &predicates,
+    const BagIndex &index);
+
+  // Does the message in `entry` (which may be a packed or unpacked
+  // StampedMessage) satisfy all predicates?  Returns an error if the entry's
+  // type can't be decoded, lacks a predicate's field, or if a predicate is
+  // not applicable to its field's type (e.g. comparing a string to a number).
+  Result<bool> Matches(const Entry &entry);
+
+  // Like above, but evaluate the payload of an undecoded entry without
+  // unpacking it into an `Entry`
+  Result<bool> Matches(const EntryView &view);
+
+protected:
+  FieldFilter() = default;
+
+  std::vector<FieldPredicate> _predicates;
+  DynamicMsgFactory _factory;
+
+  struct CompiledType {
+    // Set if the type can't be decoded or lacks a predicate's field
+    std::string error;
+
+    std::vector<CompiledFieldPath> paths;
+    std::unique_ptr<::google::protobuf::Message> msg;
+  };
+  std::unordered_map<std::string, CompiledType> _type_url_to_compiled;
+
+  CompiledType &GetCompiled(const std::string &type_url);
+
+  Result<bool> MatchesPayload(
+    const std::string &entryname,
+    const std::string &type_url,
+    std::string_view payload);
+};
+
+} /* namespace protobag */
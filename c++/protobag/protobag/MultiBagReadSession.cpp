@@ -0,0 +1,230 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "protobag/MultiBagReadSession.hpp"
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <tuple>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "protobag/Utils/PBUtils.hpp"
+#include "protobag/Utils/TopicTime.hpp"
+
+namespace protobag {
+
+struct MultiBagReadSession::Impl {
+  Spec spec;
+  bool require_all = false;
+
+  struct Bag {
+    archive::Archive::Ptr archive;
+
+    // Selected entries in time order, and the next one to emit
+    std::vector<TopicTime> entries;
+    size_t next = 0;
+
+    // Entries are in time order, which is (typically) also archive order,
+    // so one forward pass over the archive reads them all
+    std::unique_ptr<archive::Archive::SequentialReader> reader;
+  };
+  std::vector<Bag> bags;
+
+  // The next entry of each bag with entries left, earliest on top
+  struct Head {
+    const TopicTime *tt;
+    size_t bag;
+
+    bool operator>(const Head &other) const {
+      return 
+        std::tie(tt->timestamp(), bag) > 
+        std::tie(other.tt->timestamp(), other.bag);
+    }
+  };
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+
+  size_t last_bag = 0;
+
+  void PushHead(size_t b) {
+    const Bag &bag = bags[b];
+    if (bag.next < bag.entries.size()) {
+      heads.push({.tt = &bag.entries[bag.next], .bag = b});
+    }
+  }
+};
+
+namespace {
+
+// Key for matching Events selections, which ignore archive entrynames
+std::string GetEventKey(TopicTime tt) {
+  tt.set_entryname("");
+  return tt.SerializeAsString();
+}
+
+} // anon namespace
+
+Result<MultiBagReadSession::Ptr> MultiBagReadSession::Create(
+    const MultiBagReadSession::Spec &s) {
+
+  if (s.archive_specs.empty()) {
+    return {.error = "No bags to read"};
+  }
+
+  const Selection &sel = s.selection;
+  if (!sel.has_window() && !sel.has_events()) {
+    return {.error = 
+      "Multi-bag reads only support time-ordered (Window or Events) selections"
+    };
+  }
+
+  MultiBagReadSession::Ptr r(new MultiBagReadSession());
+  r->_impl.reset(new Impl());
+  Impl &impl = *r->_impl;
+  impl.spec = s;
+  impl.require_all = sel.has_events() && sel.events().require_all();
+
+  std::set<std::string> events;
+  if (sel.has_events()) {
+    for (const TopicTime &tt : sel.events().events()) {
+      events.insert(GetEventKey(tt));
+    }
+  }
+  std::set<std::string> events_found;
+
+  impl.bags.resize(s.archive_specs.size());
+  for (size_t b = 0; b < s.archive_specs.size(); ++b) {
+    Impl::Bag &bag = impl.bags[b];
+    auto maybe_archive = archive::Archive::Open(s.archive_specs[b]);
+    if (!maybe_archive.IsOk()) {
+      return {.error = maybe_archive.error};
+    }
+    bag.archive = std::move(*maybe_archive.value);
+    bag.reader = bag.archive->OpenSequentialReader();
+
+    auto maybe_index = ReadSession::ReadLatestIndex(bag.archive);
+    if (!maybe_index.IsOk()) {
+      return {.error = fmt::format(
+        "Could not read index from {}: {}",
+        bag.archive->ToString(), maybe_index.error)
+      };
+    }
+
+    BagIndex &index = *maybe_index.value;
+    auto *tts = index.mutable_time_ordered_entries();
+    if (sel.has_window()) {
+      const WindowFilter filter(sel.window());
+      for (auto &tt : *tts) {
+        if (filter.Includes(tt)) {
+          bag.entries.push_back(std::move(tt));
+        }
+      }
+    } else {
+      for (auto &tt : *tts) {
+        auto key = GetEventKey(tt);
+        if (events.find(key) != events.end()) {
+          events_found.insert(std::move(key));
+          bag.entries.push_back(std::move(tt));
+        }
+      }
+    }
+
+    impl.PushHead(b);
+  }
+
+  if (impl.require_all && events_found.size() < events.size()) {
+    std::stringstream ss;
+    for (const TopicTime &tt : sel.events().events()) {
+      if (events_found.find(GetEventKey(tt)) == events_found.end()) {
+        auto maybe_txt = PBFactory::ToTextFormatString(tt);
+        if (!maybe_txt.IsOk()) {
+          return {.error = maybe_txt.error};
+        }
+        ss << *maybe_txt.value << "\n";
+      }
+    }
+    return {.error = fmt::format((
+      "Could not find all requested entries and all were required.  "
+      "Missing: \n{}"), ss.str())
+    };
+  }
+
+  return {.value = r};
+}
+
+MaybeEntry MultiBagReadSession::GetNext() {
+  if (!_impl) {
+    return MaybeEntry::Err("Programming error: impl not initialized");
+  }
+  Impl &impl = *_impl;
+
+  // NB: iterate (rather than recurse) past entries we may skip
+  while (!impl.heads.empty()) {
+    const size_t b = impl.heads.top().bag;
+    impl.heads.pop();
+    Impl::Bag &bag = impl.bags[b];
+
+    std::string entryname = bag.entries[bag.next].entryname();
+    archive::Archive::ReadStatus read = bag.reader->Read(entryname);
+    ++bag.next;
+    impl.PushHead(b);
+    impl.last_bag = b;
+
+    if (read.IsEntryNotFound()) {
+      if (impl.require_all) {
+        return MaybeEntry::NotFound(entryname);
+      }
+      continue;
+    } else if (!read.IsOk()) {
+      return MaybeEntry::Err(
+        fmt::format("Read error for {}: {}", entryname, read.error));
+    }
+
+    return ReadSession::DecodeEntry(
+      entryname,
+      std::move(*read.value),
+      /* raw_mode */ false,
+      impl.spec.unpack_stamped_messages);
+  }
+
+  return MaybeEntry::EndOfSequence();
+}
+
+size_t MultiBagReadSession::GetLastBag() const {
+  return _impl ? _impl->last_bag : 0;
+}
+
+ReadSession::Ptr MultiBagReadSession::AsReadSession() {
+  ReadSession::Ptr rs(new ReadSession());
+  if (_impl) {
+    rs->_spec = {
+      .archive_spec = _impl->spec.archive_specs.front(),
+      .selection = _impl->spec.selection,
+      .unpack_stamped_messages = _impl->spec.unpack_stamped_messages,
+    };
+  }
+
+  // NB: the ReadSession keeps this session alive
+  MultiBagReadSession::Ptr session(new MultiBagReadSession(*this));
+  rs->_feed = [session]() { return session->GetNext(); };
+  return rs;
+}
+
+} /* namespace protobag */
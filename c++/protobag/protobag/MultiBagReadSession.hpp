@@ -0,0 +1,85 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "protobag/Entry.hpp"
+#include "protobag/ReadSession.hpp"
+#include "protobag/archive/Archive.hpp"
+#include "protobag/Utils/Result.hpp"
+
+#include "protobag_msg/ProtobagMsg.pb.h"
+
+namespace protobag {
+
+// A MultiBagReadSession reads several protobags (e.g. one per sensor
+// process, or the segments of a rolling recording) as a single sequence of
+// entries in global time order.  The session k-way merges the
+// `time_ordered_entries` of each bag's index (using a heap with one head
+// per bag) and reads each entry from the bag that holds it.  Each bag is
+// read through its own `Archive::SequentialReader`, so e.g. a zip bag
+// whose entries are stored in time order (as `WriteSession` writes them)
+// costs one forward pass no matter how the bags interleave.
+//
+// NOTE: Only time-ordered selections (`Window` and `Events`) are supported,
+//   and are applied to every bag.  Entries with equal timestamps are
+//   emitted in the order of `Spec::archive_specs`.
+class MultiBagReadSession final {
+public:
+  typedef std::shared_ptr<MultiBagReadSession> Ptr;
+
+  struct Spec {
+    std::vector<archive::Archive::Spec> archive_specs;
+    Selection selection;
+    bool unpack_stamped_messages = true;
+
+    static Spec ReadAllFromPaths(const std::vector<std::string> &paths) {
+      Spec spec;
+      for (const auto &path : paths) {
+        spec.archive_specs.push_back({
+          .mode="read",
+          .path=path,
+        });
+      }
+      spec.selection.mutable_window(); // An empty window selects everything
+      spec.unpack_stamped_messages = true;
+      return spec;
+    }
+  };
+
+  static Result<Ptr> Create(const Spec &s);
+
+  MaybeEntry GetNext();
+
+  // The bag (an index into `Spec::archive_specs`) that holds the entry last
+  // emitted by `GetNext()`
+  size_t GetLastBag() const;
+
+  // Get a `ReadSession` that emits this session's entries, e.g. to hand to
+  // a `TimeSync`.  NB: pulling from the `ReadSession` advances this session.
+  ReadSession::Ptr AsReadSession();
+
+protected:
+  struct Impl;
+  std::shared_ptr<Impl> _impl;
+};
+
+} /* namespace protobag */
@@ -0,0 +1,269 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "protobag/ParallelForEach.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "protobag/EntryView.hpp"
+#include "protobag/FieldFilter.hpp"
+#include "protobag/archive/Archive.hpp"
+
+namespace protobag {
+
+size_t GetNumWorkers(const ParallelOptions &opts) {
+  if (opts.num_threads > 0) {
+    return opts.num_threads;
+  }
+  return std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+}
+
+// Reads a `ReadSession`'s plan on a pool of workers; a friend of
+// `ReadSession` so that we can re-use its planning and decoding
+class ParallelRead final {
+public:
+  static OkOrErr Run(
+    const ReadSession::Spec &spec,
+    const WorkerEntryFn &fn,
+    const ParallelOptions &opts);
+};
+
+namespace {
+
+// A worker's share of the chunks: chunks [next, end).  The owner takes
+// chunks from the front and thieves take them from the back, so the owner
+// reads its chunks in plan order.
+struct ChunkRange {
+  std::mutex mutex;
+  size_t next = 0;
+  size_t end = 0;
+
+  bool PopFront(size_t &chunk) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (next == end) { return false; }
+    chunk = next++;
+    return true;
+  }
+
+  bool PopBack(size_t &chunk) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (next == end) { return false; }
+    chunk = --end;
+    return true;
+  }
+};
+
+} /* anon namespace */
+
+OkOrErr ParallelRead::Run(
+    const ReadSession::Spec &spec,
+    const WorkerEntryFn &fn,
+    const ParallelOptions &opts) {
+
+  if (!fn) {
+    return {.error = "No function to run on entries"};
+  }
+  if (spec.shuffle.has_value()) {
+    return {.error = "Shuffled reads are not supported in parallel"};
+  }
+
+  // Plan the read just as a ReadSession would (including any sharding and
+  // resume cursor)
+  auto maybe_session = ReadSession::Create(spec);
+  if (!maybe_session.IsOk()) {
+    return {.error = maybe_session.error};
+  }
+  ReadSession &session = **maybe_session.value;
+  {
+    auto status = session.Start();
+    if (!status.IsOk()) {
+      return status;
+    }
+  }
+  const bool raw_mode = session._plan.raw_mode;
+  const bool require_all = session._plan.require_all;
+  std::vector<std::string> entrynames;
+  entrynames.reserve(session._plan.entries_to_read.size());
+  while (!session._plan.entries_to_read.empty()) {
+    entrynames.push_back(std::move(session._plan.entries_to_read.front()));
+    session._plan.entries_to_read.pop();
+  }
+
+  // FieldFilters are not thread-safe, so each worker creates its own
+  std::optional<BagIndex> index;
+  if (!spec.predicates.empty() && !raw_mode) {
+    auto maybe_index = ReadSession::ReadLatestIndex(session._archive);
+    if (!maybe_index.IsOk()) {
+      return {.error = fmt::format(
+        "Field predicates require an index: {}", maybe_index.error)
+      };
+    }
+    index = std::move(*maybe_index.value);
+  }
+
+  const size_t chunk_size = std::max(size_t(1), opts.chunk_size);
+  const size_t n_chunks = (entrynames.size() + chunk_size - 1) / chunk_size;
+  const size_t n_workers = std::max(
+    size_t(1), std::min(GetNumWorkers(opts), n_chunks));
+
+  std::vector<ChunkRange> ranges(n_workers);
+  for (size_t w = 0; w < n_workers; ++w) {
+    ranges[w].next = n_chunks * w / n_workers;
+    ranges[w].end = n_chunks * (w + 1) / n_workers;
+  }
+
+  std::atomic<bool> failed(false);
+  std::vector<OkOrErr> statuses(n_workers, kOK);
+
+  auto NextChunk = [&](size_t w, size_t &chunk) {
+    if (ranges[w].PopFront(chunk)) {
+      return true;
+    }
+    for (size_t v = 1; v < n_workers; ++v) {
+      if (ranges[(w + v) % n_workers].PopBack(chunk)) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  auto ReadChunks = [&](size_t w) -> OkOrErr {
+    // NB: the session's archive is only ever used by worker 0
+    archive::Archive::Ptr archive = session._archive;
+    if (w > 0) {
+      auto maybe_archive = archive::Archive::Open(spec.archive_spec);
+      if (!maybe_archive.IsOk()) {
+        return {.error = maybe_archive.error};
+      }
+      archive = *maybe_archive.value;
+    }
+
+    // The worker's own chunks are contiguous in the plan, so one forward
+    // pass over e.g. a zip archive reads them all; only a stolen chunk
+    // (which is behind the pass) starts another pass
+    auto reader = archive->OpenSequentialReader();
+
+    FieldFilter::Ptr filter;
+    if (index.has_value()) {
+      auto maybe_filter = FieldFilter::Create(spec.predicates, *index);
+      if (!maybe_filter.IsOk()) {
+        return {.error = maybe_filter.error};
+      }
+      filter = *maybe_filter.value;
+    }
+
+    size_t chunk = 0;
+    while (!failed && NextChunk(w, chunk)) {
+      const size_t begin = chunk * chunk_size;
+      const size_t end = std::min(entrynames.size(), begin + chunk_size);
+      for (size_t i = begin; i < end; ++i) {
+        const std::string &entryname = entrynames[i];
+        auto read = reader->Read(entryname);
+        if (read.IsEntryNotFound()) {
+          if (require_all) {
+            return {.error = MaybeEntry::NotFound(entryname).error};
+          }
+          continue;
+        } else if (!read.IsOk()) {
+          return {.error = fmt::format(
+            "Read error for {}: {}", entryname, read.error)
+          };
+        }
+
+        // Evaluate any predicates on the undecoded payload, and only unpack
+        // entries that match
+        MaybeEntry maybe_entry;
+        if (filter) {
+          EntryView view(entryname, std::move(*read.value));
+          auto maybe_match = filter->Matches(view);
+          if (!maybe_match.IsOk()) {
+            return {.error = maybe_match.error};
+          } else if (!*maybe_match.value) {
+            continue;
+          }
+          maybe_entry = view.ToEntry(spec.unpack_stamped_messages);
+        } else {
+          maybe_entry = ReadSession::DecodeEntry(
+            entryname, std::move(*read.value), raw_mode,
+            spec.unpack_stamped_messages);
+        }
+        if (!maybe_entry.IsOk()) {
+          return {.error = maybe_entry.error};
+        }
+
+        auto status = fn(w, *maybe_entry.value);
+        if (!status.IsOk()) {
+          return status;
+        }
+      }
+    }
+    return kOK;
+  };
+
+  auto Work = [&](size_t w) {
+    statuses[w] = ReadChunks(w);
+    if (!statuses[w].IsOk()) {
+      failed = true;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t w = 1; w < n_workers; ++w) {
+    workers.emplace_back(Work, w);
+  }
+  Work(0);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  for (const auto &status : statuses) {
+    if (!status.IsOk()) {
+      return status;
+    }
+  }
+  return kOK;
+}
+
+OkOrErr ParallelForEach(
+    const ReadSession::Spec &spec,
+    const EntryFn &fn,
+    const ParallelOptions &opts) {
+
+  if (!fn) {
+    return {.error = "No function to run on entries"};
+  }
+  return ParallelRead::Run(
+    spec,
+    [&](size_t worker, const Entry &entry) { return fn(entry); },
+    opts);
+}
+
+OkOrErr ParallelForEachWithWorker(
+    const ReadSession::Spec &spec,
+    const WorkerEntryFn &fn,
+    const ParallelOptions &opts) {
+
+  return ParallelRead::Run(spec, fn, opts);
+}
+
+} /* namespace protobag */
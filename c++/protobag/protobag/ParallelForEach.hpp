@@ -0,0 +1,101 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "protobag/Entry.hpp"
+#include "protobag/ReadSession.hpp"
+#include "protobag/Utils/Result.hpp"
+
+namespace protobag {
+
+// Options for `ParallelForEach()` and `MapReduce()`
+struct ParallelOptions {
+  // Number of worker threads; 0 means one per hardware thread
+  size_t num_threads = 0;
+
+  // Workers claim entries in chunks of this many entries.  Each worker
+  // owns a contiguous range of chunks in the read plan, which it reads in
+  // one forward pass over the archive; an idle worker steals chunks from
+  // the back of a busy worker's share (at the cost of a new pass)
+  size_t chunk_size = 64;
+};
+
+// The number of workers (and thus per-worker accumulators) that
+// `ParallelForEach()` may use for `opts`
+size_t GetNumWorkers(const ParallelOptions &opts);
+
+// Read the entries selected by `spec` (as a `ReadSession` would) on a pool
+// of worker threads, each with its own handle on the archive, and call
+// `fn` on each entry from whichever worker decoded it.  Entries are visited
+// exactly once but in no particular order, and `fn` must be safe to call
+// concurrently.  Stops at, and returns, the first error (including one
+// returned by `fn`).  NB: shuffled reads are not supported.  NB: For a
+// memory archive, every handle is the same `MemoryArchive`, which the
+// workers only read; don't write to it while this runs.
+typedef std::function<OkOrErr(const Entry &)> EntryFn;
+OkOrErr ParallelForEach(
+  const ReadSession::Spec &spec,
+  const EntryFn &fn,
+  const ParallelOptions &opts = {});
+
+// Like `ParallelForEach()`, but `fn` also gets the index of the calling
+// worker (in [0, GetNumWorkers(opts))), e.g. to update per-worker state
+// without locking
+typedef std::function<OkOrErr(size_t worker, const Entry &)> WorkerEntryFn;
+OkOrErr ParallelForEachWithWorker(
+  const ReadSession::Spec &spec,
+  const WorkerEntryFn &fn,
+  const ParallelOptions &opts = {});
+
+// Fold the entries selected by `spec` into an `AccT` in parallel: each
+// worker folds its entries into its own copy of `init` using
+// `map(AccT &acc, const Entry &entry) -> OkOrErr`, and at the end the
+// per-worker accumulators are merged (in worker order, on the calling
+// thread) using `reduce(AccT &acc, AccT &&other)`.  `init` should be an
+// identity for `reduce` (e.g. zero for a sum).
+template <typename AccT, typename MapFnT, typename ReduceFnT>
+Result<AccT> MapReduce(
+    const ReadSession::Spec &spec,
+    AccT init,
+    MapFnT map,
+    ReduceFnT reduce,
+    const ParallelOptions &opts = {}) {
+
+  std::vector<AccT> accs(GetNumWorkers(opts), init);
+  auto status = ParallelForEachWithWorker(
+    spec,
+    [&](size_t worker, const Entry &entry) -> OkOrErr {
+      return map(accs[worker], entry);
+    },
+    opts);
+  if (!status.IsOk()) {
+    return {.error = status.error};
+  }
+
+  AccT result = std::move(init);
+  for (auto &acc : accs) {
+    reduce(result, std::move(acc));
+  }
+  return {.value = std::move(result)};
+}
+
+} /* namespace protobag */
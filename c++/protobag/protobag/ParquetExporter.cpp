@@ -0,0 +1,667 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "protobag/ParquetExporter.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/util/config.h>
+#include <fmt/format.h>
+#include <google/protobuf/util/time_util.h>
+#include <parquet/arrow/writer.h>
+
+#include "protobag/Entry.hpp"
+#include "protobag/ReadSession.hpp"
+#include "protobag/Utils/PBUtils.hpp"
+
+namespace protobag {
+
+std::string ParquetExporter::GetOutputPath(
+    const std::string &output_dir,
+    const std::string &topic) {
+
+  std::string name = topic;
+  name.erase(0, name.find_first_not_of('/'));
+  std::replace(name.begin(), name.end(), '/', '.');
+  return (std::filesystem::path(output_dir) / (name + ".parquet")).string();
+}
+
+namespace {
+
+using ::google::protobuf::Descriptor;
+using ::google::protobuf::FieldDescriptor;
+using ::google::protobuf::Message;
+
+// Appends the value of one protobuf field of each given message to an Arrow
+// builder.  Message-typed fields append to a StructBuilder and use a child
+// FieldConverter for each of their own fields, except for fields of
+// recursive types, which are stored as serialized (binary) messages.
+class FieldConverter final {
+public:
+  typedef std::unique_ptr<FieldConverter> Ptr;
+
+  // Returns a null Ptr for fields that can't be represented in Parquet
+  // (i.e. messages with no fields)
+  static Result<Ptr> Create(
+    const FieldDescriptor *field,
+    arrow::MemoryPool *pool,
+    std::vector<const Descriptor *> ancestors = {});
+
+  std::shared_ptr<arrow::Field> GetArrowField() const {
+    return arrow::field(field->name(), type);
+  }
+  std::shared_ptr<arrow::ArrayBuilder> GetBuilder() const { return builder; }
+
+  // Append the value of our field in `parent`
+  arrow::Status Append(const Message &parent) const {
+    if (field->is_repeated()) {
+      ARROW_RETURN_NOT_OK(static_cast<arrow::ListBuilder &>(*builder).Append());
+      const int n = parent.GetReflection()->FieldSize(parent, field);
+      for (int i = 0; i < n; ++i) {
+        ARROW_RETURN_NOT_OK(AppendValue(parent, i));
+      }
+      return arrow::Status::OK();
+    } else {
+      return AppendValue(parent, -1);
+    }
+  }
+
+private:
+  FieldConverter() = default;
+
+  // Append the value of singular field (if `index` < 0) or element `index`
+  // of a repeated field
+  arrow::Status AppendValue(const Message &parent, int index) const;
+
+  const FieldDescriptor *field = nullptr;
+  std::shared_ptr<arrow::DataType> type;
+  std::shared_ptr<arrow::ArrayBuilder> builder;
+
+  // Same as `builder` unless `field` is repeated, in which case `builder`
+  // is a ListBuilder of `value_builder`s
+  std::shared_ptr<arrow::ArrayBuilder> value_builder;
+
+  // For message-typed fields
+  std::vector<Ptr> children;
+  bool serialize_messages = false;
+};
+
+Result<FieldConverter::Ptr> FieldConverter::Create(
+    const FieldDescriptor *field,
+    arrow::MemoryPool *pool,
+    std::vector<const Descriptor *> ancestors) {
+
+  Ptr conv(new FieldConverter());
+  conv->field = field;
+
+  std::shared_ptr<arrow::DataType> value_type;
+  switch (field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+      value_type = arrow::int32();
+      conv->value_builder = std::make_shared<arrow::Int32Builder>(pool);
+      break;
+    case FieldDescriptor::CPPTYPE_INT64:
+      value_type = arrow::int64();
+      conv->value_builder = std::make_shared<arrow::Int64Builder>(pool);
+      break;
+    case FieldDescriptor::CPPTYPE_UINT32:
+      value_type = arrow::uint32();
+      conv->value_builder = std::make_shared<arrow::UInt32Builder>(pool);
+      break;
+    case FieldDescriptor::CPPTYPE_UINT64:
+      value_type = arrow::uint64();
+      conv->value_builder = std::make_shared<arrow::UInt64Builder>(pool);
+      break;
+    case FieldDescriptor::CPPTYPE_FLOAT:
+      value_type = arrow::float32();
+      conv->value_builder = std::make_shared<arrow::FloatBuilder>(pool);
+      break;
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      value_type = arrow::float64();
+      conv->value_builder = std::make_shared<arrow::DoubleBuilder>(pool);
+      break;
+    case FieldDescriptor::CPPTYPE_BOOL:
+      value_type = arrow::boolean();
+      conv->value_builder = std::make_shared<arrow::BooleanBuilder>(pool);
+      break;
+    case FieldDescriptor::CPPTYPE_ENUM:
+      value_type = arrow::utf8();
+      conv->value_builder = std::make_shared<arrow::StringBuilder>(pool);
+      break;
+    case FieldDescriptor::CPPTYPE_STRING:
+      if (field->type() == FieldDescriptor::TYPE_BYTES) {
+        value_type = arrow::binary();
+        conv->value_builder = std::make_shared<arrow::BinaryBuilder>(pool);
+      } else {
+        value_type = arrow::utf8();
+        conv->value_builder = std::make_shared<arrow::StringBuilder>(pool);
+      }
+      break;
+    case FieldDescriptor::CPPTYPE_MESSAGE: {
+      const Descriptor *descriptor = field->message_type();
+      if (std::find(ancestors.begin(), ancestors.end(), descriptor) !=
+            ancestors.end()) {
+        // Arrow schemas can't be recursive
+        value_type = arrow::binary();
+        conv->value_builder = std::make_shared<arrow::BinaryBuilder>(pool);
+        conv->serialize_messages = true;
+        break;
+      }
+
+      ancestors.push_back(descriptor);
+      std::vector<std::shared_ptr<arrow::Field>> arrow_fields;
+      std::vector<std::shared_ptr<arrow::ArrayBuilder>> child_builders;
+      for (int i = 0; i < descriptor->field_count(); ++i) {
+        auto maybe_child = Create(descriptor->field(i), pool, ancestors);
+        if (!maybe_child.IsOk()) {
+          return maybe_child;
+        }
+        Ptr child = std::move(*maybe_child.value);
+        if (child) {
+          arrow_fields.push_back(child->GetArrowField());
+          child_builders.push_back(child->GetBuilder());
+          conv->children.push_back(std::move(child));
+        }
+      }
+      if (arrow_fields.empty()) {
+        // Parquet can't store empty structs
+        return {.value = Ptr()};
+      }
+
+      value_type = arrow::struct_(arrow_fields);
+      conv->value_builder = std::make_shared<arrow::StructBuilder>(
+        value_type, pool, child_builders);
+      break;
+    }
+    default:
+      return {.error = fmt::format(
+        "Field {} has unsupported type {}",
+        field->full_name(), field->type_name())
+      };
+  }
+
+  if (field->is_repeated()) {
+    // NB: map fields are repeated messages with `key` and `value` fields,
+    // so they become list<struct<key, value>>
+    conv->type = arrow::list(value_type);
+    conv->builder = std::make_shared<arrow::ListBuilder>(
+      pool, conv->value_builder, conv->type);
+  } else {
+    conv->type = value_type;
+    conv->builder = conv->value_builder;
+  }
+  return {.value = std::move(conv)};
+}
+
+arrow::Status FieldConverter::AppendValue(
+    const Message &parent, int index) const {
+
+  const auto *r = parent.GetReflection();
+  const bool repeated = index >= 0;
+
+  #define PROTOBAG_APPEND_SCALAR(BuilderT, ProtoT) \
+    return static_cast<arrow::BuilderT &>(*value_builder).Append( \
+      repeated ? \
+        r->GetRepeated##ProtoT(parent, field, index) : \
+        r->Get##ProtoT(parent, field));
+
+  switch (field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+      PROTOBAG_APPEND_SCALAR(Int32Builder, Int32)
+    case FieldDescriptor::CPPTYPE_INT64:
+      PROTOBAG_APPEND_SCALAR(Int64Builder, Int64)
+    case FieldDescriptor::CPPTYPE_UINT32:
+      PROTOBAG_APPEND_SCALAR(UInt32Builder, UInt32)
+    case FieldDescriptor::CPPTYPE_UINT64:
+      PROTOBAG_APPEND_SCALAR(UInt64Builder, UInt64)
+    case FieldDescriptor::CPPTYPE_FLOAT:
+      PROTOBAG_APPEND_SCALAR(FloatBuilder, Float)
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      PROTOBAG_APPEND_SCALAR(DoubleBuilder, Double)
+    case FieldDescriptor::CPPTYPE_BOOL:
+      PROTOBAG_APPEND_SCALAR(BooleanBuilder, Bool)
+    case FieldDescriptor::CPPTYPE_ENUM: {
+      const auto *value = 
+        repeated ?
+          r->GetRepeatedEnum(parent, field, index) :
+          r->GetEnum(parent, field);
+      const std::string &name = value->name();
+      return static_cast<arrow::StringBuilder &>(*value_builder).Append(
+        name.data(), static_cast<int32_t>(name.size()));
+    }
+    case FieldDescriptor::CPPTYPE_STRING: {
+      std::string scratch;
+      const std::string &s =
+        repeated ?
+          r->GetRepeatedStringReference(parent, field, index, &scratch) :
+          r->GetStringReference(parent, field, &scratch);
+      // NB: StringBuilder is a BinaryBuilder
+      return static_cast<arrow::BinaryBuilder &>(*value_builder).Append(
+        s.data(), static_cast<int32_t>(s.size()));
+    }
+    case FieldDescriptor::CPPTYPE_MESSAGE: {
+      const Message &value = 
+        repeated ?
+          r->GetRepeatedMessage(parent, field, index) :
+          r->GetMessage(parent, field);
+      if (serialize_messages) {
+        const std::string s = value.SerializeAsString();
+        return static_cast<arrow::BinaryBuilder &>(*value_builder).Append(
+          s.data(), static_cast<int32_t>(s.size()));
+      }
+      ARROW_RETURN_NOT_OK(
+        static_cast<arrow::StructBuilder &>(*value_builder).Append());
+      for (const auto &child : children) {
+        ARROW_RETURN_NOT_OK(child->Append(value));
+      }
+      return arrow::Status::OK();
+    }
+    default:
+      return arrow::Status::NotImplemented(field->type_name());
+  }
+
+  #undef PROTOBAG_APPEND_SCALAR
+}
+
+// Runs `f(i)` for each i in [0, n) using up to `num_threads` threads;
+// returns the first error
+OkOrErr ParallelFor(
+    size_t n,
+    size_t num_threads,
+    const std::function<OkOrErr(size_t)> &f) {
+
+  const size_t n_workers = std::max(size_t(1), std::min(num_threads, n));
+  std::vector<OkOrErr> statuses(n_workers, kOK);
+  auto Work = [&](size_t w) {
+    for (size_t i = w; i < n; i += n_workers) {
+      statuses[w] = f(i);
+      if (!statuses[w].IsOk()) { return; }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t w = 1; w < n_workers; ++w) {
+    workers.emplace_back(Work, w);
+  }
+  Work(0);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  for (const auto &status : statuses) {
+    if (!status.IsOk()) {
+      return status;
+    }
+  }
+  return kOK;
+}
+
+// Writes the messages of one topic to a Parquet file, one row group per
+// call to `WriteBatch()`
+class TopicWriter final {
+public:
+  static Result<std::unique_ptr<TopicWriter>> Create(
+    const std::string &path,
+    const Message *prototype) {
+
+    std::unique_ptr<TopicWriter> w(new TopicWriter());
+    w->prototype = prototype;
+    arrow::MemoryPool *pool = arrow::default_memory_pool();
+
+    std::vector<std::shared_ptr<arrow::Field>> arrow_fields = {
+      arrow::field("entryname", arrow::utf8()),
+      arrow::field("timestamp", arrow::timestamp(arrow::TimeUnit::NANO)),
+    };
+    w->entryname_builder = std::make_shared<arrow::StringBuilder>(pool);
+    w->timestamp_builder = std::make_shared<arrow::TimestampBuilder>(
+      arrow::timestamp(arrow::TimeUnit::NANO), pool);
+
+    // Convert each top-level field separately (and in parallel) and then
+    // wrap them in a `msg` struct column
+    const Descriptor *descriptor = prototype->GetDescriptor();
+    std::vector<std::shared_ptr<arrow::Field>> msg_fields;
+    for (int i = 0; i < descriptor->field_count(); ++i) {
+      auto maybe_conv = FieldConverter::Create(
+        descriptor->field(i), pool, {descriptor});
+      if (!maybe_conv.IsOk()) {
+        return {.error = maybe_conv.error};
+      }
+      if (*maybe_conv.value) {
+        msg_fields.push_back((*maybe_conv.value)->GetArrowField());
+        w->converters.push_back(std::move(*maybe_conv.value));
+      }
+    }
+    if (!msg_fields.empty()) {
+      arrow_fields.push_back(arrow::field("msg", arrow::struct_(msg_fields)));
+    }
+    w->msg_fields = msg_fields;
+    w->schema = arrow::schema(arrow_fields);
+
+    auto maybe_sink = arrow::io::FileOutputStream::Open(path);
+    if (!maybe_sink.ok()) {
+      return {.error = fmt::format(
+        "Failed to open {}: {}", path, maybe_sink.status().ToString())
+      };
+    }
+    std::shared_ptr<arrow::io::OutputStream> sink = *maybe_sink;
+
+#if ARROW_VERSION_MAJOR >= 10
+    auto maybe_writer = parquet::arrow::FileWriter::Open(
+      *w->schema, pool, sink, GetWriterProperties(),
+      GetArrowWriterProperties());
+    if (!maybe_writer.ok()) {
+      return {.error = fmt::format(
+        "Failed to create Parquet writer for {}: {}",
+        path, maybe_writer.status().ToString())
+      };
+    }
+    w->writer = maybe_writer.MoveValueUnsafe();
+#else
+    auto status = parquet::arrow::FileWriter::Open(
+      *w->schema, pool, sink, GetWriterProperties(),
+      GetArrowWriterProperties(), &w->writer);
+    if (!status.ok()) {
+      return {.error = fmt::format(
+        "Failed to create Parquet writer for {}: {}", path, status.ToString())
+      };
+    }
+#endif
+
+    return {.value = std::move(w)};
+  }
+
+  // Write `msgs[i]` (of `entries[i]`) for i in [0, n) as a row group,
+  // converting columns in parallel
+  OkOrErr WriteBatch(
+      const std::vector<Entry> &entries,
+      const std::vector<std::unique_ptr<Message>> &msgs,
+      size_t n,
+      size_t num_threads) {
+
+    std::vector<std::shared_ptr<arrow::Array>> msg_arrays(converters.size());
+    auto status = ParallelFor(
+      converters.size(),
+      num_threads,
+      [&](size_t c) -> OkOrErr {
+        const FieldConverter &conv = *converters[c];
+        for (size_t i = 0; i < n; ++i) {
+          auto st = conv.Append(*msgs[i]);
+          if (!st.ok()) {
+            return {.error = fmt::format(
+              "Failed to convert {}: {}", entries[i].entryname, st.ToString())
+            };
+          }
+        }
+        auto st = conv.GetBuilder()->Finish(&msg_arrays[c]);
+        if (!st.ok()) { return {.error = st.ToString()}; }
+        return kOK;
+      });
+    if (!status.IsOk()) {
+      return status;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      const Entry &entry = entries[i];
+      auto st = entryname_builder->Append(
+        entry.entryname.data(), static_cast<int32_t>(entry.entryname.size()));
+      if (st.ok()) {
+        st = timestamp_builder->Append(
+          ::google::protobuf::util::TimeUtil::TimestampToNanoseconds(
+            entry.ctx->stamp));
+      }
+      if (!st.ok()) { return {.error = st.ToString()}; }
+    }
+    std::vector<std::shared_ptr<arrow::Array>> arrays(2);
+    {
+      auto st = entryname_builder->Finish(&arrays[0]);
+      if (st.ok()) { st = timestamp_builder->Finish(&arrays[1]); }
+      if (!st.ok()) { return {.error = st.ToString()}; }
+    }
+    if (!msg_fields.empty()) {
+      auto maybe_msg_array = arrow::StructArray::Make(msg_arrays, msg_fields);
+      if (!maybe_msg_array.ok()) {
+        return {.error = maybe_msg_array.status().ToString()};
+      }
+      arrays.push_back(*maybe_msg_array);
+    }
+
+    auto table = arrow::Table::Make(schema, arrays, n);
+    auto st = writer->WriteTable(*table, n);
+    if (!st.ok()) {
+      return {.error = fmt::format("Failed to write row group: {}", st.ToString())};
+    }
+    return kOK;
+  }
+
+  OkOrErr Close() {
+    auto st = writer->Close();
+    if (!st.ok()) { return {.error = st.ToString()}; }
+    return kOK;
+  }
+
+  const Message *GetPrototype() const { return prototype; }
+
+private:
+  TopicWriter() = default;
+
+  static std::shared_ptr<parquet::WriterProperties> GetWriterProperties() {
+#if ARROW_VERSION_MAJOR >= 10
+    // Parquet 2.6 can store timestamp[ns] as is; older versions coerce it
+    // to microseconds
+    return parquet::WriterProperties::Builder()
+      .version(parquet::ParquetVersion::PARQUET_2_6)->build();
+#else
+    return parquet::default_writer_properties();
+#endif
+  }
+
+  static std::shared_ptr<parquet::ArrowWriterProperties> 
+  GetArrowWriterProperties() {
+    // Store the Arrow schema so that readers get back exactly our types
+    return parquet::ArrowWriterProperties::Builder().store_schema()->build();
+  }
+
+  const Message *prototype = nullptr;
+  std::shared_ptr<arrow::Schema> schema;
+  std::vector<std::shared_ptr<arrow::Field>> msg_fields;
+  std::shared_ptr<arrow::StringBuilder> entryname_builder;
+  std::shared_ptr<arrow::TimestampBuilder> timestamp_builder;
+  std::vector<FieldConverter::Ptr> converters;
+  std::unique_ptr<parquet::arrow::FileWriter> writer;
+};
+
+// Exports one topic; returns true if any messages were written
+Result<bool> ExportTopic(
+    const ParquetExporter::Spec &spec,
+    const std::string &topic,
+    const std::string &path,
+    DynamicMsgFactory &factory,
+    size_t num_threads) {
+
+  Selection sel;
+  sel.mutable_window()->add_topics(topic);
+  auto maybe_rs = ReadSession::Create({
+    .archive_spec = spec.archive_spec,
+    .selection = sel,
+    .unpack_stamped_messages = true,
+    .sequential_reads = true,
+  });
+  if (!maybe_rs.IsOk()) {
+    return {.error = maybe_rs.error};
+  }
+  ReadSession &rs = **maybe_rs.value;
+
+  std::unique_ptr<TopicWriter> writer;
+  std::string type_url;
+  std::vector<Entry> batch;
+  std::vector<std::unique_ptr<Message>> msgs;
+  bool reading = true;
+  while (reading) {
+    
+    // Read a batch
+    batch.clear();
+    while (reading && batch.size() < spec.row_group_size) {
+      auto maybe_entry = rs.GetNext();
+      if (maybe_entry.IsEndOfSequence()) {
+        reading = false;
+      } else if (!maybe_entry.IsOk()) {
+        return {.error = maybe_entry.error};
+      } else if (maybe_entry.value->ctx.has_value()) {
+        batch.push_back(std::move(*maybe_entry.value));
+      } // else ignore entries that lack a timestamp
+    }
+    if (batch.empty()) {
+      continue;
+    }
+
+    if (!writer) {
+      type_url = batch.front().msg.type_url();
+      auto maybe_prototype = factory.GetPrototype(type_url);
+      if (!maybe_prototype.IsOk()) {
+        return {.error = fmt::format(
+          "Can't decode messages on topic {}: {}",
+          topic, maybe_prototype.error)
+        };
+      }
+      auto maybe_writer = TopicWriter::Create(path, *maybe_prototype.value);
+      if (!maybe_writer.IsOk()) {
+        return {.error = maybe_writer.error};
+      }
+      writer = std::move(*maybe_writer.value);
+    }
+
+    // Decode the batch in parallel, re-using messages from prior batches
+    const size_t n = batch.size();
+    while (msgs.size() < n) {
+      msgs.emplace_back(writer->GetPrototype()->New());
+    }
+    auto status = ParallelFor(n, num_threads, [&](size_t i) -> OkOrErr {
+      const Entry &entry = batch[i];
+      if (entry.msg.type_url() != type_url) {
+        return {.error = fmt::format(
+          "Entry {} has type {} but expected {}; topics with mixed types "
+          "are not supported",
+          entry.entryname, entry.msg.type_url(), type_url)
+        };
+      }
+      if (entry.msg.value().empty()) {
+        // All default values
+        msgs[i]->Clear();
+        return kOK;
+      }
+      auto st = factory.LoadFromContainer(type_url, entry.msg.value(), msgs[i]);
+      if (!st.IsOk()) {
+        return {.error = fmt::format(
+          "Failed to decode {}: {}", entry.entryname, st.error)
+        };
+      }
+      return kOK;
+    });
+    if (!status.IsOk()) {
+      return {.error = status.error};
+    }
+
+    status = writer->WriteBatch(batch, msgs, n, num_threads);
+    if (!status.IsOk()) {
+      return {.error = fmt::format("Topic {}: {}", topic, status.error)};
+    }
+  }
+
+  if (!writer) {
+    return {.value = false};
+  }
+  auto status = writer->Close();
+  if (!status.IsOk()) {
+    return {.error = status.error};
+  }
+  return {.value = true};
+}
+
+} // anon namespace
+
+Result<std::vector<std::string>> ParquetExporter::Export(const Spec &spec) {
+  if (spec.row_group_size == 0) {
+    return {.error = "ParquetExporter needs a row_group_size of at least 1"};
+  }
+
+  // Read the index for message descriptors and (maybe) topics
+  Selection sel_all;
+  sel_all.mutable_window();
+  auto maybe_rs = ReadSession::Create({
+    .archive_spec = spec.archive_spec,
+    .selection = sel_all,
+  });
+  if (!maybe_rs.IsOk()) {
+    return {.error = maybe_rs.error};
+  }
+  auto maybe_index = (*maybe_rs.value)->ReadIndex();
+  if (!maybe_index.IsOk()) {
+    return {.error = fmt::format(
+      "ParquetExporter needs an index: {}", maybe_index.error)
+    };
+  }
+  const BagIndex &index = *maybe_index.value;
+
+  DynamicMsgFactory factory;
+  for (const auto &entry : index.descriptor_pool_data().type_url_to_descriptor()) {
+    factory.RegisterTypes(entry.second);
+  }
+
+  std::vector<std::string> topics = spec.topics;
+  if (topics.empty()) {
+    for (const auto &entry : index.topic_to_stats()) {
+      topics.push_back(entry.first);
+    }
+    std::sort(topics.begin(), topics.end());
+  }
+
+  size_t num_threads = spec.num_threads;
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  {
+    std::error_code err;
+    std::filesystem::create_directories(spec.output_dir, err);
+    if (err) {
+      return {.error = fmt::format(
+        "Could not create {}: {}", spec.output_dir, err.message())
+      };
+    }
+  }
+
+  std::vector<std::string> paths;
+  for (const auto &topic : topics) {
+    const std::string path = GetOutputPath(spec.output_dir, topic);
+    auto maybe_wrote = ExportTopic(spec, topic, path, factory, num_threads);
+    if (!maybe_wrote.IsOk()) {
+      return {.error = maybe_wrote.error};
+    }
+    if (*maybe_wrote.value) {
+      paths.push_back(path);
+    }
+  }
+  return {.value = paths};
+}
+
+} /* namespace protobag */
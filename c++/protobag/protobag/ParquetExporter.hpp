@@ -0,0 +1,71 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "protobag/archive/Archive.hpp"
+#include "protobag/Utils/Result.hpp"
+
+namespace protobag {
+
+// Exports the StampedMessage topics of a protobag to Parquet files, one
+// `<output_dir>/<topic>.parquet` file per topic (with '/' in topic names
+// replaced by '.').  Each file has columns:
+//  * entryname (utf8)
+//  * timestamp (timestamp[ns])
+//  * msg (struct), with one child per field of the topic's message type
+// The Arrow schema is derived from the descriptors in the protobag's index,
+// so generated code for the messages is not needed:
+//  * numeric and bool fields map to the matching Arrow primitive
+//  * string fields map to utf8, bytes fields to binary
+//  * enum fields map to utf8 (the value name)
+//  * message fields map to struct (or, for recursive types, to binary
+//    holding the serialized message)
+//  * repeated fields map to list; map fields to list<struct<key, value>>
+// Messages are read in batches of `row_group_size`; each batch is decoded
+// and converted in parallel using `num_threads` threads and written as one
+// Parquet row group, so memory use is bounded by the batch size.
+//
+// ParquetExporter is not part of libprotobag; it is built (as C++20) in
+// libprotobag_parquet, and only when CMake finds Arrow and Parquet.
+class ParquetExporter final {
+public:
+  struct Spec {
+    archive::Archive::Spec archive_spec;
+    
+    // Topics to export; leave empty to export all topics in the index
+    std::vector<std::string> topics;
+    
+    std::string output_dir;
+
+    size_t row_group_size = 16384;
+    size_t num_threads = 0; // 0 means use std::thread::hardware_concurrency()
+  };
+
+  // Returns the paths of the files written
+  static Result<std::vector<std::string>> Export(const Spec &spec);
+
+  // Path of the file that `Export()` writes for `topic`
+  static std::string GetOutputPath(
+    const std::string &output_dir,
+    const std::string &topic);
+};
+
+} /* namespace protobag */
@@ -16,9 +16,12 @@ limitations under the License.
 
 #include "protobag/ReadSession.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <list>
 #include <set>
 #include <sstream>
+#include <unordered_map>
 
 #include <fmt/format.h>
 #include <google/protobuf/util/time_util.h>
@@ -26,10 +29,44 @@ limitations under the License.
 #include "protobag/BagIndexBuilder.hpp"
 #include "protobag/Utils/PBUtils.hpp"
 #include "protobag/Utils/TopicTime.hpp"
+#include "protobag/Utils/WireScan.hpp"
 
 
 namespace protobag {
 
+namespace {
+
+// Cursor tokens are binary StdMsg_SSMaps with these keys
+static const std::string kCursorSelection = "selection";
+static const std::string kCursorShardIndex = "shard_index";
+static const std::string kCursorNumShards = "num_shards";
+static const std::string kCursorNConsumed = "n_consumed";
+static const std::string kCursorShuffleBlockSize = "shuffle.block_size";
+static const std::string kCursorShuffleBufferSize = "shuffle.buffer_size";
+static const std::string kCursorShuffleSeed = "shuffle.seed";
+static const std::string kCursorShuffleNextBlock = "shuffle.next_block";
+static const std::string kCursorShuffleRNG = "shuffle.rng";
+static const std::string kCursorShuffleBuffered = "shuffle.buffered";
+
+Result<uint64_t> GetCursorUInt(
+    const StdMsg_SSMap &token,
+    const std::string &key) {
+
+  auto it = token.value().find(key);
+  if (it == token.value().end()) {
+    return {.error = fmt::format("Cursor is missing {}", key)};
+  }
+  const std::string &s = it->second;
+  uint64_t value = 0;
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  if (ec != std::errc() || end != s.data() + s.size()) {
+    return {.error = fmt::format("Cursor has invalid {}: '{}'", key, s)};
+  }
+  return {.value = value};
+}
+
+} // anon namespace
+
 Result<ReadSession::Ptr> ReadSession::Create(const ReadSession::Spec &s) {
   auto maybe_archive = archive::Archive::Open(s.archive_spec);
   if (!maybe_archive.IsOk()) {
@@ -40,38 +77,229 @@ Result<ReadSession::Ptr> ReadSession::Create(const ReadSession::Spec &s) {
   r->_archive = std::move(*maybe_archive.value);
   r->_spec = s;
 
+  if (!s.resume_cursor.empty()) {
+    auto maybe_token = 
+      PBFactory::LoadFromContainer<StdMsg_SSMap>(s.resume_cursor);
+    if (!maybe_token.IsOk()) {
+      return {.error = fmt::format(
+        "Could not read cursor: {}", maybe_token.error)
+      };
+    }
+    const StdMsg_SSMap &token = *maybe_token.value;
+    const auto &values = token.value();
+
+    Spec &spec = r->_spec;
+    {
+      auto it = values.find(kCursorSelection);
+      if (it == values.end()) {
+        return {.error = "Cursor is missing a selection"};
+      }
+      auto maybe_sel = PBFactory::LoadFromContainer<Selection>(it->second);
+      if (!maybe_sel.IsOk()) {
+        return {.error = fmt::format(
+          "Could not read cursor selection: {}", maybe_sel.error)
+        };
+      }
+      spec.selection = std::move(*maybe_sel.value);
+    }
+
+    Cursor cursor;
+    {
+      auto maybe_shard_index = GetCursorUInt(token, kCursorShardIndex);
+      auto maybe_num_shards = GetCursorUInt(token, kCursorNumShards);
+      auto maybe_n_consumed = GetCursorUInt(token, kCursorNConsumed);
+      for (const auto *res : 
+            {&maybe_shard_index, &maybe_num_shards, &maybe_n_consumed}) {
+        if (!res->IsOk()) { return {.error = res->error}; }
+      }
+      spec.shard_index = *maybe_shard_index.value;
+      spec.num_shards = *maybe_num_shards.value;
+      cursor.n_consumed = *maybe_n_consumed.value;
+    }
+
+    if (values.find(kCursorShuffleSeed) == values.end()) {
+      spec.shuffle.reset();
+    } else {
+      auto maybe_block_size = GetCursorUInt(token, kCursorShuffleBlockSize);
+      auto maybe_buffer_size = GetCursorUInt(token, kCursorShuffleBufferSize);
+      auto maybe_seed = GetCursorUInt(token, kCursorShuffleSeed);
+      auto maybe_next_block = GetCursorUInt(token, kCursorShuffleNextBlock);
+      for (const auto *res : {
+            &maybe_block_size, &maybe_buffer_size,
+            &maybe_seed, &maybe_next_block}) {
+        if (!res->IsOk()) { return {.error = res->error}; }
+      }
+      spec.shuffle = ReadShuffleSpec{
+        .block_size = *maybe_block_size.value,
+        .buffer_size = *maybe_buffer_size.value,
+        .seed = *maybe_seed.value,
+      };
+      cursor.next_block = *maybe_next_block.value;
+
+      auto rng_it = values.find(kCursorShuffleRNG);
+      auto buffered_it = values.find(kCursorShuffleBuffered);
+      if (rng_it == values.end() || buffered_it == values.end()) {
+        return {.error = "Cursor is missing shuffle state"};
+      }
+      cursor.rng_state = rng_it->second;
+
+      auto maybe_buffered = 
+        PBFactory::LoadFromContainer<Selection_Entrynames>(
+          buffered_it->second);
+      if (!maybe_buffered.IsOk()) {
+        return {.error = fmt::format(
+          "Could not read cursor shuffle state: {}", maybe_buffered.error)
+        };
+      }
+      for (const auto &entryname : maybe_buffered.value->entrynames()) {
+        cursor.buffered.push_back(entryname);
+      }
+    }
+
+    r->_resume = std::move(cursor);
+  }
+
   return {.value = r};
 }
 
+Result<std::string> ReadSession::GetCursor() const {
+  if (_feed) {
+    return {.error = "Cursors are not supported for SharedScan sessions"};
+  }
+  if (!_started && !_spec.resume_cursor.empty()) {
+    // Nothing read since we resumed
+    return {.value = _spec.resume_cursor};
+  }
+
+  StdMsg_SSMap token;
+  auto &values = *token.mutable_value();
+  {
+    auto maybe_sel = PBFactory::ToBinaryString(_spec.selection);
+    if (!maybe_sel.IsOk()) {
+      return {.error = maybe_sel.error};
+    }
+    values[kCursorSelection] = std::move(*maybe_sel.value);
+  }
+  values[kCursorShardIndex] = std::to_string(_spec.shard_index);
+  values[kCursorNumShards] = std::to_string(_spec.num_shards);
+  values[kCursorNConsumed] = std::to_string(_n_consumed);
+
+  if (_spec.shuffle.has_value()) {
+    const ReadShuffleSpec &shuffle = *_spec.shuffle;
+    values[kCursorShuffleBlockSize] = std::to_string(shuffle.block_size);
+    values[kCursorShuffleBufferSize] = std::to_string(shuffle.buffer_size);
+    values[kCursorShuffleSeed] = std::to_string(shuffle.seed);
+
+    Selection_Entrynames buffered;
+    if (_shuffle) {
+      values[kCursorShuffleNextBlock] = std::to_string(_shuffle->next_block);
+      std::ostringstream rng_state;
+      rng_state << _shuffle->rng;
+      values[kCursorShuffleRNG] = rng_state.str();
+      for (const auto &name_data : _shuffle->buffer) {
+        buffered.add_entrynames(name_data.first);
+      }
+    } else {
+      values[kCursorShuffleNextBlock] = "0";
+      values[kCursorShuffleRNG] = "";
+    }
+    auto maybe_buffered = PBFactory::ToBinaryString(buffered);
+    if (!maybe_buffered.IsOk()) {
+      return {.error = maybe_buffered.error};
+    }
+    values[kCursorShuffleBuffered] = std::move(*maybe_buffered.value);
+  }
+
+  return PBFactory::ToBinaryString(token);
+}
+
 MaybeEntry ReadSession::ReadEntryFrom(
       archive::Archive::Ptr archive,
       const std::string &entryname,
       bool raw_mode,
-      bool unpack_stamped) {
+      bool unpack_stamped,
+      ::google::protobuf::Arena *arena) {
 
   if (!archive) {
     return MaybeEntry::Err("No archive to read");
   }
 
-  const auto maybe_bytes = archive->ReadAsStr(entryname);
-  if (maybe_bytes.IsEntryNotFound()) {
+  auto maybe_entry = DecodeRead(
+    entryname, archive->ReadAsStr(entryname), raw_mode, unpack_stamped, arena);
+  if (maybe_entry.IsNotFound()) {
     return MaybeEntry::NotFound(entryname);
-  } else if (!maybe_bytes.IsOk()) {
+  }
+  return maybe_entry;
+}
+
+MaybeEntry ReadSession::DecodeRead(
+      const std::string &entryname,
+      archive::Archive::ReadStatus &&read,
+      bool raw_mode,
+      bool unpack_stamped,
+      ::google::protobuf::Arena *arena) {
+
+  if (read.IsEntryNotFound()) {
+    // NB: skip formatting a message; callers that surface this add detail
+    return MaybeEntry::NotFound();
+  } else if (!read.IsOk()) {
     return MaybeEntry::Err(
-      fmt::format("Read error for {}: {}", entryname, maybe_bytes.error));
+      fmt::format("Read error for {}: {}", entryname, read.error));
   }
 
+  return DecodeEntry(
+    entryname, std::move(*read.value), raw_mode, unpack_stamped, arena);
+}
+
+MaybeEntry ReadSession::DecodeEntry(
+      const std::string &entryname,
+      std::string &&bytes,
+      bool raw_mode,
+      bool unpack_stamped,
+      ::google::protobuf::Arena *arena) {
+
+  AnyView any_view;
   if (raw_mode) {
     
     Entry entry;
     entry.entryname = entryname;
-    entry.msg.set_value(std::move(*maybe_bytes.value));
+    entry.msg.set_value(std::move(bytes));
+    return MaybeEntry::Ok(std::move(entry));
+
+  } else if (arena && ScanAny(bytes, any_view)) {
+
+    // Skip the outer Any and decode any StampedMessage directly into the
+    // arena, then move out the payload
+    Entry entry{.entryname = entryname};
+    static const std::string kStampedTypeURL = GetTypeURL<StampedMessage>();
+    if (unpack_stamped && any_view.type_url == kStampedTypeURL) {
+      auto *stamped = 
+        ::google::protobuf::Arena::CreateMessage<StampedMessage>(arena);
+      if (!stamped->ParseFromArray(
+            any_view.value.data(), int(any_view.value.size()))) {
+        arena->Reset();
+        return MaybeEntry::Err(fmt::format(
+          "Failed to decode StampedMessage from {}", entryname));
+      }
+      entry.msg.set_type_url(stamped->msg().type_url());
+      entry.msg.set_value(std::move(*stamped->mutable_msg()->mutable_value()));
+      entry.ctx = Entry::Context{
+        .topic = GetTopicFromEntryname(entryname),
+        .stamp = stamped->timestamp(),
+        .inner_type_url = entry.msg.type_url(),
+      };
+    } else {
+      entry.msg.set_type_url(
+        any_view.type_url.data(), any_view.type_url.size());
+      entry.msg.set_value(any_view.value.data(), any_view.value.size());
+    }
+    arena->Reset();
     return MaybeEntry::Ok(std::move(entry));
 
   } else {
 
     auto maybe_any = 
-      PBFactory::LoadFromContainer<google::protobuf::Any>(*maybe_bytes.value);
+      PBFactory::LoadFromContainer<google::protobuf::Any>(bytes);
         // TODO maybe handle text format separately ?
     if (!maybe_any.IsOk()) {
       return MaybeEntry::Err(fmt::format(
@@ -92,40 +320,333 @@ MaybeEntry ReadSession::ReadEntryFrom(
 }
 
 MaybeEntry ReadSession::GetNext() {
+  if (!_filter && !_spec.predicates.empty()) {
+    auto maybe_index = ReadLatestIndex(_archive);
+    if (!maybe_index.IsOk()) {
+      return MaybeEntry::Err(fmt::format(
+        "Field predicates require an index: {}", maybe_index.error));
+    }
+    auto maybe_filter = FieldFilter::Create(
+      _spec.predicates, *maybe_index.value);
+    if (!maybe_filter.IsOk()) {
+      return MaybeEntry::Err(maybe_filter.error);
+    }
+    _filter = *maybe_filter.value;
+  }
+
+  if (!_filter) {
+    return
+      _feed ? _feed() : GetNextFromPlan(_spec.unpack_stamped_messages);
+  }
+
+  if (_feed) {
+    // The scan has already decoded the entry
+    while (true) {
+      auto maybe_entry = _feed();
+      if (!maybe_entry.IsOk()) {
+        return maybe_entry;
+      }
+
+      auto maybe_match = _filter->Matches(*maybe_entry.value);
+      if (!maybe_match.IsOk()) {
+        return MaybeEntry::Err(maybe_match.error);
+      } else if (*maybe_match.value) {
+        return maybe_entry;
+      }
+    }
+  }
+
+  // Evaluate predicates on the payload of each undecoded entry, and only
+  // unpack entries that match
+  while (true) {
+    auto maybe_entry = GetNextFromPlan(
+      /* unpack_stamped */ false, /* undecoded */ true);
+    if (!maybe_entry.IsOk() || _plan.raw_mode) {
+      return maybe_entry;
+    }
+
+    Entry &undecoded = *maybe_entry.value;
+    EntryView view(
+      std::move(undecoded.entryname),
+      std::move(*undecoded.msg.mutable_value()));
+    auto maybe_match = _filter->Matches(view);
+    if (!maybe_match.IsOk()) {
+      return MaybeEntry::Err(maybe_match.error);
+    } else if (*maybe_match.value) {
+      return view.ToEntry(_spec.unpack_stamped_messages);
+    }
+  }
+}
+
+OkOrErr ReadSession::Start() {
+  auto maybe_entries_to_read = GetEntriesToRead(_archive, _spec.selection);
+  if (!maybe_entries_to_read.IsOk()) {
+    return {.error = 
+      fmt::format(
+        "Could not select entries to read: \n{}",
+        maybe_entries_to_read.error)
+    };
+  }
+  auto maybe_plan = GetShard(
+    std::move(*maybe_entries_to_read.value),
+    _spec.shard_index,
+    _spec.num_shards);
+  if (!maybe_plan.IsOk()) {
+    return {.error = maybe_plan.error};
+  }
+  _plan = std::move(*maybe_plan.value);
+  _started = true;
+
+  if (_spec.use_arena) {
+    static const size_t kArenaBlockSize = 4096;
+    _arena_block.resize(kArenaBlockSize);
+    ::google::protobuf::ArenaOptions options;
+    options.initial_block = _arena_block.data();
+    options.initial_block_size = _arena_block.size();
+    _arena.reset(new ::google::protobuf::Arena(options));
+  }
+
+  if (_spec.sequential_reads && !_spec.shuffle.has_value() && _archive) {
+    _reader = _archive->OpenSequentialReader();
+  }
+
+  if (_spec.shuffle.has_value()) {
+    auto status = StartShuffle();
+    if (!status.IsOk()) {
+      return status;
+    }
+  }
+
+  if (_resume.has_value()) {
+    auto status = ApplyCursor(std::move(*_resume));
+    _resume.reset();
+    if (!status.IsOk()) {
+      return {.error = fmt::format("Could not resume: {}", status.error)};
+    }
+  }
+  return kOK;
+}
+
+OkOrErr ReadSession::ApplyCursor(Cursor &&cursor) {
+  if (!_shuffle) {
+    if (cursor.n_consumed > _plan.entries_to_read.size()) {
+      return {.error = fmt::format(
+        "Cursor is at entry {} but only {} entries are selected",
+        cursor.n_consumed, _plan.entries_to_read.size())
+      };
+    }
+    // NB: just drops names from the plan; the entries are not read
+    for (size_t i = 0; i < cursor.n_consumed; ++i) {
+      _plan.entries_to_read.pop();
+    }
+    _n_consumed = cursor.n_consumed;
+    return kOK;
+  }
+
+  ShuffleState &state = *_shuffle;
+  if (cursor.next_block > state.blocks.size()) {
+    return {.error = fmt::format(
+      "Cursor is at block {} but only {} blocks are selected",
+      cursor.next_block, state.blocks.size())
+    };
+  }
+  state.next_block = cursor.next_block;
+  if (!cursor.rng_state.empty()) {
+    std::istringstream rng_state(cursor.rng_state);
+    rng_state >> state.rng;
+    if (rng_state.fail()) {
+      return {.error = "Cursor has invalid shuffle state"};
+    }
+  }
+
+  // Re-read what was buffered but not yet emitted
+  auto statuses = _archive->ReadMany(cursor.buffered);
+  for (size_t i = 0; i < cursor.buffered.size(); ++i) {
+    auto &status = statuses[i];
+    if (!status.IsOk()) {
+      return {.error = fmt::format(
+        "Read error for {}: {}", cursor.buffered[i], status.error)
+      };
+    }
+    state.buffer.emplace_back(
+      std::move(cursor.buffered[i]), std::move(*status.value));
+  }
+  return kOK;
+}
+
+MaybeEntryView ReadSession::GetNextView() {
+  if (_feed) {
+    return MaybeEntryView::FromStatus(MaybeEntry::Err(
+      "Entry views are not supported for SharedScan sessions"));
+  }
+  if (!_spec.predicates.empty()) {
+    return MaybeEntryView::FromStatus(MaybeEntry::Err(
+      "Entry views do not support field predicates"));
+  }
+
+  auto maybe_entry = GetNextFromPlan(
+    /* unpack_stamped */ false, /* undecoded */ true);
+  if (!maybe_entry.IsOk()) {
+    return MaybeEntryView::FromStatus(maybe_entry);
+  }
+
+  Entry &entry = *maybe_entry.value;
+  return MaybeEntryView::Ok(EntryView(
+    std::move(entry.entryname),
+    std::move(*entry.msg.mutable_value()),
+    _plan.raw_mode));
+}
+
+MaybeEntry ReadSession::GetNextFromPlan(
+    bool unpack_stamped, bool undecoded) {
+
   if (!_started) {
-    auto maybe_entries_to_read = GetEntriesToRead(_archive, _spec.selection);
-    if (!maybe_entries_to_read.IsOk()) {
-      return MaybeEntry::Err(
-        fmt::format(
-          "Could not select entries to read: \n{}",
-          maybe_entries_to_read.error));
+    auto status = Start();
+    if (!status.IsOk()) {
+      return MaybeEntry::Err(status.error);
     }
-    _plan = *maybe_entries_to_read.value;
-    _started = true;
   }
 
-  if (_plan.entries_to_read.empty()) {
-    return MaybeEntry::EndOfSequence();
+  if (_shuffle) {
+    return GetNextShuffled(unpack_stamped, undecoded);
   }
 
-  std::string entryname = _plan.entries_to_read.front();
-  _plan.entries_to_read.pop();
+  // NB: iterate (rather than recurse) past entries we may skip
+  while (!_plan.entries_to_read.empty()) {
+    std::string entryname = std::move(_plan.entries_to_read.front());
+    _plan.entries_to_read.pop();
+    ++_n_consumed;
+
+    if (!_archive) {
+      return MaybeEntry::Err("Programming Error: no archive open for writing");
+    }
 
+    // NB: DecodeRead() emits a cheap NotFound (without the entry name),
+    // which we only name below if we surface it
+    auto maybe_entry = DecodeRead(
+      entryname,
+      _reader ? _reader->Read(entryname) : _archive->ReadAsStr(entryname),
+      _plan.raw_mode || undecoded,
+      unpack_stamped,
+      _arena.get());
+    if (!maybe_entry.IsNotFound()) {
+      return maybe_entry;
+    } else if (_plan.require_all) {
+      return MaybeEntry::NotFound(entryname);
+    }
+  }
+
+  return MaybeEntry::EndOfSequence();
+}
+
+OkOrErr ReadSession::StartShuffle() {
+  const ReadShuffleSpec &spec = *_spec.shuffle;
+  if (spec.block_size == 0) {
+    return {.error = "Shuffled reads need a block_size of at least 1"};
+  }
   if (!_archive) {
-    return MaybeEntry::Err("Programming Error: no archive open for writing");
+    return {.error = "Programming Error: no archive open for reading"};
   }
 
-  auto maybe_entry = ReadEntryFrom(
-    _archive, entryname, _plan.raw_mode, _spec.unpack_stamped_messages);
-  if (maybe_entry.IsNotFound()) {
-    if (_plan.require_all) {
-      return MaybeEntry::NotFound(entryname);
-    } else {
-      return GetNext();
+  _shuffle.reset(new ShuffleState());
+  _shuffle->rng.seed(spec.seed);
+
+  // Put the plan in archive order so that blocks are contiguous
+  std::vector<std::string> entrynames;
+  entrynames.reserve(_plan.entries_to_read.size());
+  while (!_plan.entries_to_read.empty()) {
+    entrynames.push_back(std::move(_plan.entries_to_read.front()));
+    _plan.entries_to_read.pop();
+  }
+  {
+    std::unordered_map<std::string, size_t> name_to_pos;
+    const auto namelist = _archive->GetNamelist();
+    for (size_t i = 0; i < namelist.size(); ++i) {
+      name_to_pos.emplace(namelist[i], i);
+    }
+    auto GetPos = [&](const std::string &entryname) {
+      auto it = name_to_pos.find(entryname);
+      return it == name_to_pos.end() ? namelist.size() : it->second;
+    };
+    std::stable_sort(
+      entrynames.begin(), entrynames.end(),
+      [&](const std::string &a, const std::string &b) {
+        return GetPos(a) < GetPos(b);
+      });
+  }
+
+  for (size_t i = 0; i < entrynames.size(); i += spec.block_size) {
+    const size_t end = std::min(entrynames.size(), i + spec.block_size);
+    _shuffle->blocks.emplace_back(
+      std::make_move_iterator(entrynames.begin() + i),
+      std::make_move_iterator(entrynames.begin() + end));
+  }
+
+  // NB: We use our own Fisher-Yates shuffle (rather than std::shuffle) so
+  // that the order for a given seed is the same for all standard libraries
+  auto &blocks = _shuffle->blocks;
+  for (size_t i = blocks.size(); i > 1; --i) {
+    std::swap(blocks[i - 1], blocks[_shuffle->rng() % i]);
+  }
+  return kOK;
+}
+
+MaybeEntry ReadSession::GetNextShuffled(
+    bool unpack_stamped, bool undecoded) {
+
+  ShuffleState &state = *_shuffle;
+  const size_t buffer_size = std::max(size_t(1), _spec.shuffle->buffer_size);
+
+  // Fill the buffer, a whole block at a time
+  while (
+      state.buffer.size() < buffer_size &&
+      state.next_block < state.blocks.size()) {
+
+    const auto &block = state.blocks[state.next_block++];
+    auto statuses = _archive->ReadMany(block);
+    for (size_t i = 0; i < block.size(); ++i) {
+      auto &status = statuses[i];
+      if (status.IsEntryNotFound()) {
+        if (_plan.require_all) {
+          return MaybeEntry::NotFound(block[i]);
+        }
+      } else if (!status.IsOk()) {
+        return MaybeEntry::Err(
+          fmt::format("Read error for {}: {}", block[i], status.error));
+      } else {
+        state.buffer.emplace_back(block[i], std::move(*status.value));
+      }
     }
-  } else {
-    return maybe_entry;
   }
+
+  if (state.buffer.empty()) {
+    return MaybeEntry::EndOfSequence();
+  }
+
+  // Emit a random entry from the buffer
+  std::swap(
+    state.buffer[state.rng() % state.buffer.size()],
+    state.buffer.back());
+  auto [entryname, data] = std::move(state.buffer.back());
+  state.buffer.pop_back();
+  return DecodeEntry(
+    entryname,
+    std::move(data),
+    _plan.raw_mode || undecoded,
+    unpack_stamped,
+    _arena.get());
+}
+
+MaybeEntry ReadSession::ReadEntry(const std::string &entryname) {
+  return ReadEntryFrom(
+    _archive,
+    entryname,
+    /* raw_mode */ false,
+    _spec.unpack_stamped_messages);
+}
+
+Result<BagIndex> ReadSession::ReadIndex() {
+  return ReadLatestIndex(_archive);
 }
 
 Result<BagIndex> ReadSession::GetIndex(const std::string &path) {
@@ -157,9 +678,9 @@ Result<std::vector<std::string>> ReadSession::GetAllTopics(const std::string &pa
   return {.value = topics};
 }
 
-Result<BagIndex> ReadSession::ReadLatestIndex(archive::Archive::Ptr archive) {
+MaybeEntry ReadSession::ReadLatestIndexEntry(archive::Archive::Ptr archive) {
   if (!archive) {
-    return {.error = "No archive to read"};
+    return MaybeEntry::Err("No archive to read");
   }
 
   std::optional<Entry> index_entry;
@@ -177,7 +698,8 @@ Result<BagIndex> ReadSession::ReadLatestIndex(archive::Archive::Ptr archive) {
             index_entry = std::move(*maybe_entry.value);
           } else {
             const Entry::Context &current = *maybe_entry.value->ctx;
-            if (current.stamp < index_entry->ctx->stamp) {
+            // NB: appending to a bag writes a newer (merged) index
+            if (index_entry->ctx->stamp < current.stamp) {
               index_entry = std::move(*maybe_entry.value);
             }
           }
@@ -187,11 +709,49 @@ Result<BagIndex> ReadSession::ReadLatestIndex(archive::Archive::Ptr archive) {
   }
 
   if (index_entry.has_value()) {
-    return PBFactory::UnpackFromAny<BagIndex>(index_entry->msg);
+    return MaybeEntry::Ok(std::move(*index_entry));
   } else {
+    return MaybeEntry::NotFound();
+  }
+}
+
+Result<BagIndex> ReadSession::ReadLatestIndex(archive::Archive::Ptr archive) {
+  auto maybe_entry = ReadLatestIndexEntry(archive);
+  if (maybe_entry.IsNotFound()) {
     return {.error = "Could not find an index"};
+  } else if (!maybe_entry.IsOk()) {
+    return {.error = maybe_entry.error};
+  }
+  return PBFactory::UnpackFromAny<BagIndex>(maybe_entry.value->msg);
+}
+
+Result<ReadSession::ReadPlan> ReadSession::GetShard(
+    ReadPlan plan,
+    size_t shard_index,
+    size_t num_shards) {
+
+  if (num_shards <= 1) {
+    return {.value = std::move(plan)};
+  }
+  if (shard_index >= num_shards) {
+    return {.error = fmt::format(
+      "Invalid shard {} of {} shards", shard_index, num_shards)
+    };
   }
 
+  const size_t n = plan.entries_to_read.size();
+  const size_t begin = (n * shard_index) / num_shards;
+  const size_t end = (n * (shard_index + 1)) / num_shards;
+  for (size_t i = 0; i < begin; ++i) {
+    plan.entries_to_read.pop();
+  }
+  std::queue<std::string> shard;
+  for (size_t i = begin; i < end; ++i) {
+    shard.push(std::move(plan.entries_to_read.front()));
+    plan.entries_to_read.pop();
+  }
+  plan.entries_to_read = std::move(shard);
+  return {.value = std::move(plan)};
 }
 
 Result<ReadSession::ReadPlan> ReadSession::GetEntriesToRead(
@@ -219,7 +779,17 @@ Result<ReadSession::ReadPlan> ReadSession::GetEntriesToRead(
     };
   }
 
-  const BagIndex &index = *maybe_index.value;
+  return GetEntriesToRead(archive, sel, *maybe_index.value);
+}
+
+Result<ReadSession::ReadPlan> ReadSession::GetEntriesToRead(
+    archive::Archive::Ptr archive,
+    const Selection &sel,
+    const BagIndex &index) {
+
+  if (!archive) {
+    return {.error = "No archive to read"};
+  }
 
   if (sel.has_select_all()) {
 
@@ -291,36 +861,10 @@ Result<ReadSession::ReadPlan> ReadSession::GetEntriesToRead(
 
   } else if (sel.has_window()) {
 
-    const Selection_Window &window = sel.window();
-    
-    std::set<std::string> exclude_topics;
-    for (const auto &topic : window.exclude_topics()) {
-      exclude_topics.insert(topic);
-    }
-
-    std::set<std::string> include_topics;
-    for (const auto &topic : window.topics()) {
-      include_topics.insert(topic);
-    }
-
+    const WindowFilter filter(sel.window());
     std::queue<std::string> entries_to_read;
     for (const TopicTime &tt : index.time_ordered_entries()) {
-      
-      if (!exclude_topics.empty() &&
-            (exclude_topics.find(tt.topic()) != exclude_topics.end())) {
-        continue;
-      }
-
-      if (!include_topics.empty() &&
-            (include_topics.find(tt.topic()) == include_topics.end())) {
-        continue;
-      }
-
-      if (window.has_start() && (tt.timestamp() < window.start())) {
-        continue;
-      }
-
-      if (window.has_end() && (window.end() < tt.timestamp())) {
+      if (!filter.Includes(tt)) {
         continue;
       }
 
@@ -16,18 +16,45 @@ limitations under the License.
 
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <optional>
 #include <queue>
+#include <random>
 #include <string>
+#include <vector>
 
 #include "protobag/Entry.hpp"
+#include "protobag/EntryView.hpp"
+#include "protobag/FieldFilter.hpp"
 #include "protobag/archive/Archive.hpp"
 #include "protobag/Utils/Result.hpp"
 
+#include <google/protobuf/arena.h>
+
 #include "protobag_msg/ProtobagMsg.pb.h"
 
 namespace protobag {
 
+template <typename MT>
+class TypedReader;
+class ParallelRead;
+class MultiBagReadSession;
+class WriteSession;
+
+// Options for reading entries in a (reproducible) pseudo-random order, e.g.
+// for ML training.  The selected entries are split into blocks of
+// `block_size` entries that are contiguous in the archive; blocks are read
+// in shuffled order (each in one sequential pass), and entries are emitted
+// at random from a buffer of (up to) `buffer_size` entries.
+struct ReadShuffleSpec {
+  size_t block_size = 64;
+  size_t buffer_size = 1024;
+  uint64_t seed = 0;
+};
+
 class ReadSession final {
 public:
   typedef std::shared_ptr<ReadSession> Ptr;
@@ -40,6 +67,44 @@ public:
     // NB: for now we *only* support time-ordered reads for stamped entries. 
     // Non-stamped are not ordered.
 
+    // Optionally only emit entries whose messages satisfy all of these
+    // predicates; requires an index with message descriptors, and every
+    // selected entry must have the predicates' fields (see `FieldFilter`).
+    // Entries that don't match are dropped before they are unpacked.
+    // Ignored for raw entries.
+    std::vector<FieldPredicate> predicates;
+
+    // Optionally read only shard `shard_index` of `num_shards` (e.g. one per
+    // data loader worker).  Shards are contiguous, near-equal ranges of the
+    // entries selected, in read order (i.e. time order for time-ordered
+    // selections), so each shard reads only its own entries and the shards
+    // together read each entry exactly once.  A `num_shards` of 0 or 1 means
+    // read everything.
+    size_t shard_index = 0;
+    size_t num_shards = 0;
+
+    // Optionally read entries in shuffled order; see `ReadShuffleSpec`.
+    // NB: not compatible with time synchronization.
+    std::optional<ReadShuffleSpec> shuffle;
+
+    // Optionally resume reading from a cursor obtained from `GetCursor()`
+    // (e.g. after a restart).  The cursor's selection, sharding and shuffle
+    // options replace those of this Spec.
+    std::string resume_cursor;
+
+    // Optionally decode entries using a protobuf Arena owned by the session
+    // (and reset after each entry) for intermediate messages (e.g. the
+    // StampedMessage that wraps each entry), which saves heap allocations
+    // in long-running readers.
+    bool use_arena = false;
+
+    // Optionally read entries through one `Archive::SequentialReader` that
+    // the session keeps open, so that e.g. a zip archive that stores the
+    // selected entries in read order (as `WriteSession` stores time series)
+    // costs one forward pass rather than a pass per entry.  Ignored for
+    // shuffled reads.
+    bool sequential_reads = false;
+
     static Spec ReadAllFromPath(const std::string &path) {
       Selection sel;
       sel.mutable_select_all(); // Creating an ALL means "SELECT *"
@@ -54,10 +119,88 @@ public:
     }
   };
 
-  static Result<Ptr> Create(const Spec &s={});
+  static Result<Ptr> Create(const Spec &s);
+  static Result<Ptr> Create() { return Create(Spec()); }
+    // NB: not a default argument, which can't use Spec's member initializers
+    // inside this class
 
   MaybeEntry GetNext();
 
+  // Like `GetNext()`, but emit an `EntryView` that decodes only what is
+  // asked of it.  NB: field predicates are not supported.
+  MaybeEntryView GetNextView();
+
+
+  // Iteration
+
+  // An input iterator over the entries of a session (as emitted by
+  // `GetNext()`); supports `for (const Entry &entry : *session) { ... }`.
+  // The iterator holds one entry slot, and references are valid until the
+  // iterator is incremented.  Iteration stops at the end of the sequence or
+  // on an error; check `GetIterationStatus()` afterwards to tell which.
+  class Iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Entry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Entry *;
+    using reference = const Entry &;
+
+    Iterator() = default; // The end
+    explicit Iterator(ReadSession *session) : _session(session) { ++*this; }
+
+    reference operator*() const { return *_current.value; }
+    pointer operator->() const { return &*_current.value; }
+
+    Iterator &operator++() {
+      _current = _session->GetNext();
+      if (!_current.IsOk()) {
+        if (!_current.IsEndOfSequence()) {
+          _session->_iteration_status = {.error = _current.error};
+        }
+        _session = nullptr;
+      }
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    bool operator==(const Iterator &other) const {
+      return _session == other._session;
+    }
+    bool operator!=(const Iterator &other) const { return !(*this == other); }
+
+  private:
+    ReadSession *_session = nullptr;
+    MaybeEntry _current;
+  };
+
+  Iterator begin() {
+    _iteration_status = kOK;
+    return Iterator(this);
+  }
+  Iterator end() { return Iterator(); }
+
+  // An error if the last iteration over this session stopped on an error
+  // rather than the end of the sequence
+  const OkOrErr &GetIterationStatus() const { return _iteration_status; }
+
+  // Read the entry `entryname` directly from this session's archive, ignoring
+  // the session's Selection.  Useful for readers that plan their reads using
+  // the index (see e.g. `IndexedMaxSlopTimeSync`).
+  MaybeEntry ReadEntry(const std::string &entryname);
+
+  // Read the (latest) index of this session's archive
+  Result<BagIndex> ReadIndex();
+
+  const Spec &GetSpec() const { return _spec; }
+
+  // Get an opaque token for the position of this session, i.e. the selection
+  // being read and what has been emitted so far.  Save the token and pass it
+  // as `Spec::resume_cursor` to continue reading from the next entry that has
+  // not yet been emitted; earlier entries are not re-read.  Not supported for
+  // sessions fed by a `SharedScan`.
+  Result<std::string> GetCursor() const;
+
 
   // Utilities
   
@@ -69,9 +212,22 @@ public:
   static Result<std::vector<std::string>> GetAllTopics(const std::string &path);
 
 protected:
+  friend class SharedScan;
+  template <typename MT> friend class TypedReader;
+  friend class ParallelRead;
+  friend class MultiBagReadSession;
+  friend class WriteSession;
+
   Spec _spec;
   archive::Archive::Ptr _archive;
 
+  // If set, GetNext() pulls entries from here instead of `_plan`; used for
+  // sessions fed by a `SharedScan`
+  std::function<MaybeEntry()> _feed;
+
+  // Created at start if the Spec has predicates
+  FieldFilter::Ptr _filter;
+
   bool _started = false;
   struct ReadPlan {
     std::queue<std::string> entries_to_read;
@@ -80,17 +236,97 @@ protected:
   };
   ReadPlan _plan;
 
+  OkOrErr _iteration_status = kOK;
+
+  // Number of entries taken from `_plan` so far
+  size_t _n_consumed = 0;
+
+  // Position parsed from `Spec::resume_cursor`, applied at start
+  struct Cursor {
+    size_t n_consumed = 0;
+
+    // For shuffled reads
+    size_t next_block = 0;
+    std::string rng_state;
+    std::vector<std::string> buffered;
+  };
+  std::optional<Cursor> _resume;
+
+  OkOrErr Start();
+  OkOrErr ApplyCursor(Cursor &&cursor);
+
+  // If `undecoded`, emit every entry as if it were raw, i.e. with its
+  // undecoded archive data (see e.g. `TypedReader`)
+  MaybeEntry GetNextFromPlan(bool unpack_stamped, bool undecoded = false);
+
+  // State for shuffled reads
+  struct ShuffleState {
+    std::mt19937_64 rng;
+    std::vector<std::vector<std::string>> blocks;
+    size_t next_block = 0;
+
+    // Entry names and (undecoded) data
+    std::vector<std::pair<std::string, std::string>> buffer;
+  };
+  std::unique_ptr<ShuffleState> _shuffle;
+
+  // Created at start if the Spec asks for an arena; the arena's first block
+  // is `_arena_block`, which it reuses after each reset
+  std::vector<char> _arena_block;
+  std::unique_ptr<::google::protobuf::Arena> _arena;
+
+  // Created at start if the Spec asks for sequential reads.  NB: declared
+  // after `_archive`, which it must not outlive
+  std::unique_ptr<archive::Archive::SequentialReader> _reader;
+
+  OkOrErr StartShuffle();
+  MaybeEntry GetNextShuffled(bool unpack_stamped, bool undecoded);
+
   static MaybeEntry ReadEntryFrom(
     archive::Archive::Ptr archive,
     const std::string &entryname,
     bool raw_mode = false,
-    bool unpack_stamped = true);
+    bool unpack_stamped = true,
+    ::google::protobuf::Arena *arena = nullptr);
+
+  // Decode the result of reading entry `entryname` from an archive.  NB: a
+  // missing entry gives a NotFound without the entry name (which is cheap
+  // for plan loops that skip missing entries); `ReadEntryFrom()` names it.
+  static MaybeEntry DecodeRead(
+    const std::string &entryname,
+    archive::Archive::ReadStatus &&read,
+    bool raw_mode = false,
+    bool unpack_stamped = true,
+    ::google::protobuf::Arena *arena = nullptr);
+
+  // Decode `bytes` read from entry `entryname`; if `arena` is given, use
+  // it for (and reset it after) intermediate messages
+  static MaybeEntry DecodeEntry(
+    const std::string &entryname,
+    std::string &&bytes,
+    bool raw_mode = false,
+    bool unpack_stamped = true,
+    ::google::protobuf::Arena *arena = nullptr);
   
   static Result<BagIndex> ReadLatestIndex(archive::Archive::Ptr archive);
 
+  // The (unpacked) entry of the latest index in `archive`, if any
+  static MaybeEntry ReadLatestIndexEntry(archive::Archive::Ptr archive);
+
   static Result<ReadPlan> GetEntriesToRead(
     archive::Archive::Ptr archive,
     const Selection &sel);
+
+  // Keep only shard `shard_index` of `num_shards` of `plan`
+  static Result<ReadPlan> GetShard(
+    ReadPlan plan,
+    size_t shard_index,
+    size_t num_shards);
+
+  static Result<ReadPlan> GetEntriesToRead(
+    archive::Archive::Ptr archive,
+    const Selection &sel,
+    const BagIndex &index);
 };
 
 } /* namespace protobag */
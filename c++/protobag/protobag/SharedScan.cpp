@@ -0,0 +1,313 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "protobag/SharedScan.hpp"
+
+#include <deque>
+#include <map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace protobag {
+
+struct SharedScan::Impl {
+  struct Consumer {
+    std::unordered_set<std::string> entrynames;
+    bool require_all = false;
+    bool raw_mode = false;
+
+    // Either a callback consumer ...
+    Callback callback;
+
+    // ... or a session consumer
+    std::deque<MaybeEntry> queue;
+  };
+
+  Spec spec;
+  archive::Archive::Ptr archive;
+  std::unique_ptr<archive::Archive::SequentialReader> reader;
+
+  // Sessions own their consumers (so a dropped session stops buffering);
+  // the scan owns callback consumers
+  std::vector<std::weak_ptr<Consumer>> consumers;
+  std::vector<std::shared_ptr<Consumer>> callback_consumers;
+
+  bool started = false;
+  std::vector<std::string> scan_order;
+  size_t next_entry = 0;
+
+  Result<std::shared_ptr<Consumer>> AddConsumer(const Selection &sel) {
+    if (started) {
+      return {.error = "Can't add consumers to a SharedScan that has started"};
+    }
+
+    auto maybe_plan = ReadSession::GetEntriesToRead(archive, sel);
+    if (!maybe_plan.IsOk()) {
+      return {.error = fmt::format(
+        "Could not select entries to read: \n{}", maybe_plan.error)
+      };
+    }
+    
+    ReadSession::ReadPlan &plan = *maybe_plan.value;
+    std::shared_ptr<Consumer> c(new Consumer());
+    c->require_all = plan.require_all;
+    c->raw_mode = plan.raw_mode;
+    while (!plan.entries_to_read.empty()) {
+      c->entrynames.insert(std::move(plan.entries_to_read.front()));
+      plan.entries_to_read.pop();
+    }
+    
+    consumers.push_back(c);
+    return {.value = c};
+  }
+
+  std::vector<std::shared_ptr<Consumer>> LiveConsumers() const {
+    std::vector<std::shared_ptr<Consumer>> live;
+    for (const auto &weak : consumers) {
+      if (auto c = weak.lock()) {
+        live.push_back(std::move(c));
+      }
+    }
+    return live;
+  }
+
+  OkOrErr Start() {
+    started = true;
+
+    std::vector<std::shared_ptr<Consumer>> live = LiveConsumers();
+    std::unordered_set<std::string> selected;
+    for (const auto &c : live) {
+      selected.insert(c->entrynames.begin(), c->entrynames.end());
+    }
+
+    // Time series entries in time order, then everything else
+    std::unordered_set<std::string> seen;
+    auto MaybeAdd = [&](const std::string &entryname) {
+      if (selected.count(entryname) && !seen.count(entryname)) {
+        scan_order.push_back(entryname);
+        seen.insert(entryname);
+      }
+    };
+
+    auto maybe_index = ReadSession::ReadLatestIndex(archive);
+    if (maybe_index.IsOk()) {
+      for (const auto &tt : maybe_index.value->time_ordered_entries()) {
+        MaybeAdd(tt.entryname());
+      }
+    }
+    for (const auto &entryname : archive->GetNamelist()) {
+      MaybeAdd(entryname);
+    }
+    for (const auto &c : live) {
+      // E.g. required entries that are missing from the archive
+      for (const auto &entryname : c->entrynames) {
+        MaybeAdd(entryname);
+      }
+    }
+
+    reader = archive->OpenSequentialReader();
+    return kOK;
+  }
+
+  // Read the next entry in the scan and dispatch it to consumers; returns
+  // false once the scan is complete
+  Result<bool> Step() {
+    if (!started) {
+      auto status = Start();
+      if (!status.IsOk()) {
+        return status;
+      }
+    }
+
+    if (next_entry >= scan_order.size()) {
+      return {.value = false};
+    }
+    const std::string &entryname = scan_order[next_entry];
+
+    // Check every target has room before consuming the entry, so that a
+    // queue overflow leaves the scan where it was and a later pull (after
+    // the full session drains) resumes with this same entry
+    std::vector<std::shared_ptr<Consumer>> targets;
+    for (auto &c : LiveConsumers()) {
+      if (c->entrynames.count(entryname)) {
+        if (!c->callback && c->queue.size() >= spec.max_queue_size) {
+          return {.error = fmt::format(
+            "SharedScan session queue full (max_queue_size {}) reading {}; "
+            "read sessions in lockstep or increase max_queue_size",
+            spec.max_queue_size, entryname)
+          };
+        }
+        targets.push_back(std::move(c));
+      }
+    }
+
+    ++next_entry;
+    if (targets.empty()) {
+      // Only selected by dropped sessions
+      return {.value = true};
+    }
+
+    // Read (once!) ...
+    auto maybe_bytes = reader->Read(entryname);
+
+    // ... and decode at most once per decoding mode.  The last decode takes
+    // the bytes and the last target in each mode takes the decoded entry.
+    std::map<bool, size_t> raw_mode_to_uses;
+    for (const auto &c : targets) {
+      ++raw_mode_to_uses[c->raw_mode];
+    }
+    size_t decodes_left = raw_mode_to_uses.size();
+    std::map<bool, MaybeEntry> raw_mode_to_entry;
+    auto GetDecoded = [&](bool raw_mode) -> MaybeEntry & {
+      auto it = raw_mode_to_entry.find(raw_mode);
+      if (it == raw_mode_to_entry.end()) {
+        --decodes_left;
+        MaybeEntry decoded;
+        if (maybe_bytes.IsEntryNotFound()) {
+          decoded = MaybeEntry::NotFound(entryname);
+        } else if (!maybe_bytes.IsOk()) {
+          decoded = MaybeEntry::Err(fmt::format(
+            "Read error for {}: {}", entryname, maybe_bytes.error));
+        } else {
+          decoded = ReadSession::DecodeEntry(
+            entryname,
+            decodes_left == 0 ?
+              std::move(*maybe_bytes.value) :
+              std::string(*maybe_bytes.value),
+            raw_mode,
+            spec.unpack_stamped_messages);
+        }
+        it = raw_mode_to_entry.emplace(raw_mode, std::move(decoded)).first;
+      }
+      return it->second;
+    };
+
+    for (const auto &c : targets) {
+      MaybeEntry &maybe_entry = GetDecoded(c->raw_mode);
+      const bool last_use = --raw_mode_to_uses[c->raw_mode] == 0;
+      if (maybe_entry.IsNotFound() && !c->require_all) {
+        continue;
+      }
+
+      if (c->callback) {
+        if (!maybe_entry.IsOk()) {
+          return {.error = maybe_entry.error};
+        }
+        c->callback(*maybe_entry.value);
+      } else if (last_use) {
+        c->queue.push_back(std::move(maybe_entry));
+      } else {
+        c->queue.push_back(maybe_entry);
+      }
+    }
+
+    return {.value = true};
+  }
+
+  MaybeEntry GetNext(Consumer &c) {
+    while (c.queue.empty()) {
+      auto maybe_stepped = Step();
+      if (!maybe_stepped.IsOk()) {
+        return MaybeEntry::Err(maybe_stepped.error);
+      } else if (!*maybe_stepped.value) {
+        return MaybeEntry::EndOfSequence();
+      }
+    }
+
+    MaybeEntry next = std::move(c.queue.front());
+    c.queue.pop_front();
+    return next;
+  }
+};
+
+Result<SharedScan::Ptr> SharedScan::Create(const SharedScan::Spec &s) {
+  if (s.max_queue_size == 0) {
+    return {.error = "SharedScan needs a max_queue_size of at least 1"};
+  }
+
+  auto maybe_archive = archive::Archive::Open(s.archive_spec);
+  if (!maybe_archive.IsOk()) {
+    return {.error = maybe_archive.error};
+  }
+
+  SharedScan::Ptr scan(new SharedScan());
+  scan->_impl.reset(new Impl());
+  scan->_impl->spec = s;
+  scan->_impl->archive = std::move(*maybe_archive.value);
+  return {.value = scan};
+}
+
+Result<ReadSession::Ptr> SharedScan::AddSession(const Selection &sel) {
+  if (!_impl) {
+    return {.error = "Programming error: impl not initialized"};
+  }
+
+  auto maybe_consumer = _impl->AddConsumer(sel);
+  if (!maybe_consumer.IsOk()) {
+    return {.error = maybe_consumer.error};
+  }
+
+  ReadSession::Ptr rs(new ReadSession());
+  rs->_spec = {
+    .archive_spec = _impl->spec.archive_spec,
+    .selection = sel,
+    .unpack_stamped_messages = _impl->spec.unpack_stamped_messages,
+  };
+  rs->_archive = _impl->archive;
+  
+  std::shared_ptr<Impl> impl = _impl;
+  std::shared_ptr<Impl::Consumer> consumer = *maybe_consumer.value;
+  rs->_feed = [impl, consumer]() { return impl->GetNext(*consumer); };
+  return {.value = rs};
+}
+
+OkOrErr SharedScan::AddCallback(const Selection &sel, Callback callback) {
+  if (!_impl) {
+    return {.error = "Programming error: impl not initialized"};
+  }
+  if (!callback) {
+    return {.error = "Null callback"};
+  }
+
+  auto maybe_consumer = _impl->AddConsumer(sel);
+  if (!maybe_consumer.IsOk()) {
+    return {.error = maybe_consumer.error};
+  }
+  (*maybe_consumer.value)->callback = std::move(callback);
+  _impl->callback_consumers.push_back(*maybe_consumer.value);
+  return kOK;
+}
+
+OkOrErr SharedScan::Run() {
+  if (!_impl) {
+    return {.error = "Programming error: impl not initialized"};
+  }
+
+  bool scanning = true;
+  while (scanning) {
+    auto maybe_stepped = _impl->Step();
+    if (!maybe_stepped.IsOk()) {
+      return maybe_stepped;
+    }
+    scanning = *maybe_stepped.value;
+  }
+  return kOK;
+}
+
+} /* namespace protobag */
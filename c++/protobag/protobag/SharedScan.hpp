@@ -0,0 +1,86 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "protobag/Entry.hpp"
+#include "protobag/ReadSession.hpp"
+#include "protobag/archive/Archive.hpp"
+#include "protobag/Utils/Result.hpp"
+
+#include "protobag_msg/ProtobagMsg.pb.h"
+
+namespace protobag {
+
+// A SharedScan reads a protobag in a single pass and fans out entries to
+// several consumers, each with its own `Selection`:
+//  * Sessions: `ReadSession`s whose GetNext() pulls from the shared scan.
+//      These sessions can be handed to a `TimeSync` (e.g. `MaxSlopTimeSync`)
+//      just like any other `ReadSession`.
+//  * Callbacks: invoked for every selected entry as the scan passes it.
+// Each entry is read from the archive (and decoded) once no matter how many
+// consumers select it.
+//
+// The scan is single-threaded and pull-driven: pulling from any session 
+// advances the scan until that session has an entry, and meanwhile buffers
+// entries for all other sessions.  Each session buffers at most
+// `max_queue_size` entries; if the scan would exceed that limit, the pull
+// fails with an error.  Consume sessions in (rough) lockstep, or raise
+// `max_queue_size`, to avoid overflow.  Dropping a session detaches it from
+// the scan, so it no longer buffers (or overflows).
+//
+// NOTE: The scan visits time-series entries in time order (per the index)
+//   and then all other entries.  Consumers see entries in that order, which
+//   for Window and Events selections matches a standalone `ReadSession`.
+//   Entries are read through a single `Archive::SequentialReader`, so when
+//   the archive stores time-series entries in time order (as `WriteSession`
+//   writes them), the scan makes one forward pass over e.g. a zip or tar
+//   archive.  Entries stored out of time order cost an extra pass each.
+//   All consumers must be added before the first pull (or `Run()`).
+class SharedScan final {
+public:
+  typedef std::shared_ptr<SharedScan> Ptr;
+
+  struct Spec {
+    archive::Archive::Spec archive_spec;
+    bool unpack_stamped_messages = true;
+    size_t max_queue_size = 1024; // Recall: max queue size *per session*
+  };
+
+  static Result<Ptr> Create(const Spec &s);
+
+  // Add a consumer that reads entries matching `sel` through a
+  // `ReadSession`
+  Result<ReadSession::Ptr> AddSession(const Selection &sel);
+
+  // Add a consumer that receives entries matching `sel` through `callback`
+  typedef std::function<void(const Entry &)> Callback;
+  OkOrErr AddCallback(const Selection &sel, Callback callback);
+
+  // Run the scan to completion, e.g. to drive callbacks.  Entries for any
+  // sessions are buffered (so sessions that are not read may overflow).
+  OkOrErr Run();
+
+protected:
+  struct Impl;
+  std::shared_ptr<Impl> _impl;
+};
+
+} /* namespace protobag */
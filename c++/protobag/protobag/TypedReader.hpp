@@ -0,0 +1,132 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <fmt/format.h>
+#include <google/protobuf/timestamp.pb.h>
+
+#include "protobag/ReadSession.hpp"
+#include "protobag/Utils/PBUtils.hpp"
+#include "protobag/Utils/Result.hpp"
+#include "protobag/Utils/WireScan.hpp"
+
+namespace protobag {
+
+// Reads entries that are all messages of type `MT` (e.g. a single topic),
+// parsing each payload straight from the bytes read from the archive into
+// one `MT` instance that is reused for every entry.  Skips the intermediate
+// `Any`s and `Entry` (and their allocations) of `ReadSession::GetNext()`.
+template <typename MT>
+class TypedReader final {
+public:
+  typedef std::shared_ptr<TypedReader<MT>> Ptr;
+
+  // NB: field predicates are not supported; test the decoded message instead
+  static Result<Ptr> Create(const ReadSession::Spec &s) {
+    if (!s.predicates.empty()) {
+      return {.error = "TypedReader does not support field predicates"};
+    }
+
+    auto maybe_session = ReadSession::Create(s);
+    if (!maybe_session.IsOk()) {
+      return {.error = maybe_session.error};
+    }
+
+    Ptr r(new TypedReader<MT>());
+    r->_session = *maybe_session.value;
+    return {.value = r};
+  }
+
+  // Read the next entry and parse it into `GetMsg()`, returning a pointer to
+  // that message (valid until the next call), or nullptr at the end of the
+  // sequence.  Entries that are not `MT`s are errors.
+  Result<const MT *> GetNext() {
+    auto maybe_entry = _session->GetNextFromPlan(
+      /* unpack_stamped */ false, /* undecoded */ true);
+    if (maybe_entry.IsEndOfSequence()) {
+      return {.value = nullptr};
+    } else if (!maybe_entry.IsOk()) {
+      return {.error = maybe_entry.error};
+    }
+
+    Entry &entry = *maybe_entry.value;
+    _entryname = std::move(entry.entryname);
+
+    // NB: `entry` holds the undecoded archive data, which is always a
+    // serialized `Any` (even for raw entries)
+    AnyView any;
+    if (!ScanAny(entry.msg.value(), any)) {
+      return {.error = fmt::format(
+        "Could not read protobuf from {}", _entryname)
+      };
+    }
+
+    if (any.type_url == _stamped_type_url) {
+      StampedMessageView stamped;
+      if (!ScanStampedMessage(any.value, stamped) ||
+          !_stamp.ParseFromArray(
+            stamped.timestamp.data(), int(stamped.timestamp.size()))) {
+        return {.error = fmt::format(
+          "Failed to decode StampedMessage from {}", _entryname)
+        };
+      }
+      any = stamped.msg;
+    } else {
+      _stamp.Clear();
+    }
+
+    // Raw entries have no type to check; trust the user
+    if (!any.type_url.empty() && any.type_url != _type_url) {
+      return {.error = fmt::format(
+        "Tried to read a {} but entry {} is a {}",
+        _type_url, _entryname, any.type_url)
+      };
+    }
+    const std::string_view payload = any.value;
+
+    // NB: Parse*() clears the message first but keeps its allocations
+    if (!_msg.ParseFromArray(payload.data(), int(payload.size()))) {
+      return {.error = fmt::format(
+        "Failed to decode a {} from {}", _type_url, _entryname)
+      };
+    }
+    return {.value = &_msg};
+  }
+
+  // The most recently read message, entryname and (if stamped) timestamp
+  const MT &GetMsg() const { return _msg; }
+  const std::string &GetEntryname() const { return _entryname; }
+  const ::google::protobuf::Timestamp &GetStamp() const { return _stamp; }
+
+  const ReadSession &GetSession() const { return *_session; }
+
+protected:
+  ReadSession::Ptr _session;
+
+  const std::string _type_url = GetTypeURL<MT>();
+  const std::string _stamped_type_url = GetTypeURL<StampedMessage>();
+
+  MT _msg;
+  std::string _entryname;
+  ::google::protobuf::Timestamp _stamp;
+};
+
+} /* namespace protobag */
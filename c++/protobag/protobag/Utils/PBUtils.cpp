@@ -17,8 +17,12 @@ limitations under the License.
 #include "protobag/Utils/PBUtils.hpp"
 
 #include <algorithm>
+#include <cstdlib>
 #include <list>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -374,6 +378,464 @@ Result<std::string> GetDeep_string(
 }
 
 
+////
+//// CompiledFieldPath Impl
+////
+
+Result<CompiledFieldPath> CompiledFieldPath::Compile(
+    const ::google::protobuf::Descriptor *descriptor,
+    const std::string &field_path) {
+
+  using namespace ::google::protobuf;
+
+  if (!descriptor) {
+    return {.error = "Programming error: null descriptor"};
+  }
+
+  CompiledFieldPath cfp;
+  cfp._descriptor = descriptor;
+  cfp._path = field_path;
+
+  const Descriptor *current = descriptor;
+  size_t pos = 0;
+  bool compiling = true;
+  while (compiling) {
+    size_t end = field_path.find_first_of(".[", pos);
+    const std::string name = field_path.substr(pos, end - pos);
+    const FieldDescriptor *field = current->FindFieldByName(name);
+    if (!field) {
+      return {.error = fmt::format(
+        "Msg {} has no field {}", current->full_name(), name)
+      };
+    }
+
+    Step step;
+    step.field = field;
+    const FieldDescriptor *value_field = field;
+    if (end != std::string::npos && field_path[end] == '[') {
+      size_t close = field_path.find(']', end);
+      if (close == std::string::npos) {
+        return {.error = fmt::format(
+          "Unterminated [ in field path {}", field_path)
+        };
+      }
+      const std::string token = field_path.substr(end + 1, close - end - 1);
+
+      if (field->is_map()) {
+
+        step.is_map_lookup = true;
+        step.map_key_field = field->message_type()->FindFieldByNumber(1);
+        step.map_value_field = field->message_type()->FindFieldByNumber(2);
+        if (!step.map_key_field || !step.map_value_field) {
+          return {.error = fmt::format(
+            "Map field {} of {} has bad entry type {}",
+            name, current->full_name(), field->message_type()->full_name())
+          };
+        }
+        step.key_str = token;
+
+        char *parse_end = nullptr;
+        switch (step.map_key_field->cpp_type()) {
+          case FieldDescriptor::CPPTYPE_INT32:
+          case FieldDescriptor::CPPTYPE_INT64:
+            step.key_int = std::strtoll(token.c_str(), &parse_end, 10);
+            break;
+          case FieldDescriptor::CPPTYPE_UINT32:
+          case FieldDescriptor::CPPTYPE_UINT64:
+            step.key_uint = std::strtoull(token.c_str(), &parse_end, 10);
+            break;
+          case FieldDescriptor::CPPTYPE_BOOL:
+            if (token == "true" || token == "1") {
+              step.key_int = 1;
+            } else if (token == "false" || token == "0") {
+              step.key_int = 0;
+            } else {
+              return {.error = fmt::format(
+                "Bad bool key {} for map field {} of {}",
+                token, name, current->full_name())
+              };
+            }
+            break;
+          default: // Strings
+            break;
+        }
+        if (parse_end && (token.empty() || *parse_end != '\0')) {
+          return {.error = fmt::format(
+            "Bad integer key {} for map field {} of {}",
+            token, name, current->full_name())
+          };
+        }
+
+        value_field = step.map_value_field;
+
+      } else if (field->is_repeated()) {
+
+        char *parse_end = nullptr;
+        long index = std::strtol(token.c_str(), &parse_end, 10);
+        if (token.empty() || *parse_end != '\0' || index < 0) {
+          return {.error = fmt::format(
+            "Bad index {} for repeated field {} of {}",
+            token, name, current->full_name())
+          };
+        }
+        step.index = int(index);
+
+      } else {
+        return {.error = fmt::format(
+          "Field {} of {} is not repeated or a map; can't index it with [{}]",
+          name, current->full_name(), token)
+        };
+      }
+
+      end = close + 1;
+      if (end == field_path.size()) {
+        end = std::string::npos;
+      } else if (field_path[end] != '.') {
+        return {.error = fmt::format(
+          "Expected . after ] in field path {}", field_path)
+        };
+      }
+
+    } else if (field->is_repeated()) {
+      return {.error = fmt::format(
+        "Field {} of {} is repeated; select an element with [index] "
+        "(or [key] for maps)",
+        name, current->full_name())
+      };
+    }
+
+    cfp._steps.push_back(step);
+    
+    if (end == std::string::npos) {
+      compiling = false;
+    } else {
+      if (value_field->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE) {
+        return {.error = fmt::format(
+          "Field {} of {} is not a message; can't get {}",
+          name, current->full_name(), field_path.substr(end + 1))
+        };
+      }
+      current = value_field->message_type();
+      pos = end + 1;
+    }
+  }
+
+  return {.value = cfp};
+}
+
+const ::google::protobuf::FieldDescriptor *
+CompiledFieldPath::GetLeafField() const {
+  if (_steps.empty()) {
+    return nullptr;
+  }
+  const Step &last = _steps.back();
+  return last.is_map_lookup ? last.map_value_field : last.field;
+}
+
+static bool MapKeyMatches(
+    const ::google::protobuf::Message &map_entry,
+    const CompiledFieldPath::Step &step) {
+  
+  using namespace ::google::protobuf;
+  const Reflection *reflection = map_entry.GetReflection();
+  const FieldDescriptor *key_field = step.map_key_field;
+  switch (key_field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+      return reflection->GetInt32(map_entry, key_field) == step.key_int;
+    case FieldDescriptor::CPPTYPE_INT64:
+      return reflection->GetInt64(map_entry, key_field) == step.key_int;
+    case FieldDescriptor::CPPTYPE_UINT32:
+      return reflection->GetUInt32(map_entry, key_field) == step.key_uint;
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return reflection->GetUInt64(map_entry, key_field) == step.key_uint;
+    case FieldDescriptor::CPPTYPE_BOOL:
+      return reflection->GetBool(map_entry, key_field) == bool(step.key_int);
+    case FieldDescriptor::CPPTYPE_STRING:
+      return reflection->GetString(map_entry, key_field) == step.key_str;
+    default:
+      return false;
+  }
+}
+
+Result<CompiledFieldPath::Location> CompiledFieldPath::Resolve(
+    const ::google::protobuf::Message *message) const {
+
+  if (!message) {
+    return {.error = "Programming error: null message"};
+  }
+  if (message->GetDescriptor() != _descriptor) {
+    return {.error = fmt::format(
+      "Field path {} is for msg {}, not {}",
+      _path,
+      _descriptor ? _descriptor->full_name() : "(none)",
+      message->GetTypeName())
+    };
+  }
+
+  Location loc;
+  const ::google::protobuf::Message *m = message;
+  for (size_t i = 0; i < _steps.size(); ++i) {
+    const Step &step = _steps[i];
+    const ::google::protobuf::Reflection *reflection = m->GetReflection();
+
+    if (step.is_map_lookup) {
+
+      // NB: Like protobuf, the last entry for a key wins
+      const ::google::protobuf::Message *map_entry = nullptr;
+      for (int j = reflection->FieldSize(*m, step.field) - 1; j >= 0; --j) {
+        const auto &entry = reflection->GetRepeatedMessage(*m, step.field, j);
+        if (MapKeyMatches(entry, step)) {
+          map_entry = &entry;
+          break;
+        }
+      }
+      if (!map_entry) {
+        return {.error = fmt::format(
+          "Map {} of {} has no key {}",
+          step.field->name(), m->GetTypeName(), step.key_str)
+        };
+      }
+      loc = {.message = map_entry, .field = step.map_value_field};
+
+    } else if (step.index >= 0) {
+      
+      const int size = reflection->FieldSize(*m, step.field);
+      if (step.index >= size) {
+        return {.error = fmt::format(
+          "Index {} out of range for field {} of {} (size {})",
+          step.index, step.field->name(), m->GetTypeName(), size)
+        };
+      }
+      loc = {.message = m, .field = step.field, .index = step.index};
+
+    } else {
+      loc = {.message = m, .field = step.field};
+    }
+
+    if (i + 1 < _steps.size()) {
+      const ::google::protobuf::Reflection *r = loc.message->GetReflection();
+      m = (loc.index >= 0) ?
+        &r->GetRepeatedMessage(*loc.message, loc.field, loc.index) :
+        &r->GetMessage(*loc.message, loc.field);
+    }
+  }
+  return {.value = loc};
+}
+
+// Resolve `cfp` on `message` after checking the type of the value at the
+// end of the path
+static Result<CompiledFieldPath::Location> ResolveAs(
+    const CompiledFieldPath &cfp,
+    const ::google::protobuf::Message *message,
+    ::google::protobuf::FieldDescriptor::CppType pb_cpp_type) {
+
+  using namespace ::google::protobuf;
+  const FieldDescriptor *leaf = cfp.GetLeafField();
+  if (!leaf) {
+    return {.error = "Programming error: empty CompiledFieldPath"};
+  }
+  if (leaf->cpp_type() != pb_cpp_type) {
+    return {.error = fmt::format(
+      "Wanted field path {} on msg {} to be type {}, but it is of type {}",
+      cfp.GetPath(),
+      cfp.GetDescriptor()->full_name(),
+      FieldDescriptor::CppTypeName(pb_cpp_type),
+      FieldDescriptor::CppTypeName(leaf->cpp_type()))
+    };
+  }
+  return cfp.Resolve(message);
+}
+
+Result<int32_t> CompiledFieldPath::Get_int32(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  const FieldDescriptor *leaf = GetLeafField();
+  if (leaf && leaf->cpp_type() == FieldDescriptor::CPPTYPE_ENUM) {
+    auto maybe_loc = Resolve(message);
+    if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+    const Location &loc = *maybe_loc.value;
+    const Reflection *r = loc.message->GetReflection();
+    return {.value = (loc.index >= 0) ?
+      r->GetRepeatedEnumValue(*loc.message, loc.field, loc.index) :
+      r->GetEnumValue(*loc.message, loc.field)
+    };
+  }
+
+  auto maybe_loc = ResolveAs(*this, message, FieldDescriptor::CPPTYPE_INT32);
+  if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+  const Location &loc = *maybe_loc.value;
+  const Reflection *r = loc.message->GetReflection();
+  return {.value = (loc.index >= 0) ?
+    r->GetRepeatedInt32(*loc.message, loc.field, loc.index) :
+    r->GetInt32(*loc.message, loc.field)
+  };
+}
+
+Result<int64_t> CompiledFieldPath::Get_int64(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  auto maybe_loc = ResolveAs(*this, message, FieldDescriptor::CPPTYPE_INT64);
+  if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+  const Location &loc = *maybe_loc.value;
+  const Reflection *r = loc.message->GetReflection();
+  return {.value = (loc.index >= 0) ?
+    r->GetRepeatedInt64(*loc.message, loc.field, loc.index) :
+    r->GetInt64(*loc.message, loc.field)
+  };
+}
+
+Result<uint32_t> CompiledFieldPath::Get_uint32(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  auto maybe_loc = ResolveAs(*this, message, FieldDescriptor::CPPTYPE_UINT32);
+  if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+  const Location &loc = *maybe_loc.value;
+  const Reflection *r = loc.message->GetReflection();
+  return {.value = (loc.index >= 0) ?
+    r->GetRepeatedUInt32(*loc.message, loc.field, loc.index) :
+    r->GetUInt32(*loc.message, loc.field)
+  };
+}
+
+Result<uint64_t> CompiledFieldPath::Get_uint64(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  auto maybe_loc = ResolveAs(*this, message, FieldDescriptor::CPPTYPE_UINT64);
+  if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+  const Location &loc = *maybe_loc.value;
+  const Reflection *r = loc.message->GetReflection();
+  return {.value = (loc.index >= 0) ?
+    r->GetRepeatedUInt64(*loc.message, loc.field, loc.index) :
+    r->GetUInt64(*loc.message, loc.field)
+  };
+}
+
+Result<float> CompiledFieldPath::Get_float(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  auto maybe_loc = ResolveAs(*this, message, FieldDescriptor::CPPTYPE_FLOAT);
+  if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+  const Location &loc = *maybe_loc.value;
+  const Reflection *r = loc.message->GetReflection();
+  return {.value = (loc.index >= 0) ?
+    r->GetRepeatedFloat(*loc.message, loc.field, loc.index) :
+    r->GetFloat(*loc.message, loc.field)
+  };
+}
+
+Result<double> CompiledFieldPath::Get_double(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  auto maybe_loc = ResolveAs(*this, message, FieldDescriptor::CPPTYPE_DOUBLE);
+  if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+  const Location &loc = *maybe_loc.value;
+  const Reflection *r = loc.message->GetReflection();
+  return {.value = (loc.index >= 0) ?
+    r->GetRepeatedDouble(*loc.message, loc.field, loc.index) :
+    r->GetDouble(*loc.message, loc.field)
+  };
+}
+
+Result<bool> CompiledFieldPath::Get_bool(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  auto maybe_loc = ResolveAs(*this, message, FieldDescriptor::CPPTYPE_BOOL);
+  if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+  const Location &loc = *maybe_loc.value;
+  const Reflection *r = loc.message->GetReflection();
+  return {.value = (loc.index >= 0) ?
+    r->GetRepeatedBool(*loc.message, loc.field, loc.index) :
+    r->GetBool(*loc.message, loc.field)
+  };
+}
+
+Result<std::string> CompiledFieldPath::Get_string(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  const FieldDescriptor *leaf = GetLeafField();
+  if (leaf && leaf->cpp_type() == FieldDescriptor::CPPTYPE_ENUM) {
+    auto maybe_loc = Resolve(message);
+    if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+    const Location &loc = *maybe_loc.value;
+    const Reflection *r = loc.message->GetReflection();
+    const EnumValueDescriptor *value = (loc.index >= 0) ?
+      r->GetRepeatedEnum(*loc.message, loc.field, loc.index) :
+      r->GetEnum(*loc.message, loc.field);
+    return {.value = value->name()};
+  }
+
+  auto maybe_loc = ResolveAs(*this, message, FieldDescriptor::CPPTYPE_STRING);
+  if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+  const Location &loc = *maybe_loc.value;
+  const Reflection *r = loc.message->GetReflection();
+  return {.value = (loc.index >= 0) ?
+    r->GetRepeatedString(*loc.message, loc.field, loc.index) :
+    r->GetString(*loc.message, loc.field)
+  };
+}
+
+Result<const ::google::protobuf::Message *> CompiledFieldPath::Get_msg(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  auto maybe_loc = ResolveAs(*this, message, FieldDescriptor::CPPTYPE_MESSAGE);
+  if (!maybe_loc.IsOk()) { return {.error = maybe_loc.error}; }
+  const Location &loc = *maybe_loc.value;
+  const Reflection *r = loc.message->GetReflection();
+  return {.value = (loc.index >= 0) ?
+    &r->GetRepeatedMessage(*loc.message, loc.field, loc.index) :
+    &r->GetMessage(*loc.message, loc.field)
+  };
+}
+
+Result<double> CompiledFieldPath::Get_as_double(
+    const ::google::protobuf::Message *message) const {
+
+  using namespace ::google::protobuf;
+  const FieldDescriptor *leaf = GetLeafField();
+  if (!leaf) {
+    return {.error = "Programming error: empty CompiledFieldPath"};
+  }
+
+  auto AsDouble = [](auto maybe_v) -> Result<double> {
+    if (!maybe_v.IsOk()) { return {.error = maybe_v.error}; }
+    return {.value = double(*maybe_v.value)};
+  };
+
+  switch (leaf->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+    case FieldDescriptor::CPPTYPE_ENUM:
+      return AsDouble(Get_int32(message));
+    case FieldDescriptor::CPPTYPE_INT64:
+      return AsDouble(Get_int64(message));
+    case FieldDescriptor::CPPTYPE_UINT32:
+      return AsDouble(Get_uint32(message));
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return AsDouble(Get_uint64(message));
+    case FieldDescriptor::CPPTYPE_FLOAT:
+      return AsDouble(Get_float(message));
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      return AsDouble(Get_double(message));
+    case FieldDescriptor::CPPTYPE_BOOL:
+      return AsDouble(Get_bool(message));
+    default:
+      return {.error = fmt::format(
+        "Field path {} on msg {} is of non-numeric type {}",
+        _path, _descriptor->full_name(),
+        FieldDescriptor::CppTypeName(leaf->cpp_type()))
+      };
+  }
+}
+
+
 
 
 
@@ -382,12 +844,18 @@ Result<std::string> GetDeep_string(
 // ============================================================================
 
 struct DynamicMsgFactory::Impl {
+  // Guards all members below
+  std::shared_mutex mutex;
+
   ::google::protobuf::SimpleDescriptorDatabase db;
   std::shared_ptr<::google::protobuf::DescriptorPool> pool;
   ::google::protobuf::DynamicMessageFactory factory;
 
   std::list<std::string> known_descriptor_names;
 
+  std::unordered_map<std::string, const ::google::protobuf::Message *>
+    type_url_to_prototype;
+
   Impl() {
     pool.reset(new ::google::protobuf::DescriptorPool(&db));
       // NB: we need to call *this* DescriptorPool ctor because 
@@ -395,11 +863,7 @@ struct DynamicMsgFactory::Impl {
   }
 };
 
-void DynamicMsgFactory::LazyInitImpl() {
-  if (!_impl) {
-    _impl.reset(new Impl());
-  }
-}
+DynamicMsgFactory::DynamicMsgFactory() : _impl(new Impl()) { }
 
 void DynamicMsgFactory::RegisterTypes(
   const ::google::protobuf::FileDescriptorSet &fds) {
@@ -409,7 +873,16 @@ void DynamicMsgFactory::RegisterTypes(
 
 void DynamicMsgFactory::RegisterType(
         const ::google::protobuf::FileDescriptorProto &fd) {
-  LazyInitImpl();
+  std::unique_lock<std::shared_mutex> lock(_impl->mutex);
+
+  // Callers typically register the full FileDescriptorSet of every type
+  // they see, so shared dependencies (e.g. google/protobuf/any.proto) come
+  // up many times; the database would reject (and log) each duplicate.
+  ::google::protobuf::FileDescriptorProto existing;
+  if (_impl->db.FindFileByName(fd.name(), &existing)) {
+    return;
+  }
+
   _impl->db.Add(fd);
 
   for (const ::google::protobuf::DescriptorProto &d : fd.message_type()) {
@@ -426,13 +899,64 @@ DynamicMsgFactory::MsgPtrOrErr DynamicMsgFactory::LoadFromArray(
     return {.error = "Bad array"};
   }
 
-  if (!_impl) {
-    return {.error = 
-      "This factory has no known types. Use RegisterType() or RegisterTypes()"
-    };
+  auto maybe_prototype = GetPrototype(type_url);
+  if (!maybe_prototype.IsOk()) {
+    return {.error = maybe_prototype.error};
+  }
+
+  const ::google::protobuf::Message *prototype = *maybe_prototype.value;
+  std::unique_ptr<::google::protobuf::Message> mp(prototype->New());
+  auto res = PBFactory::LoadFromArray(data, size, mp.get());
+  if (!res.IsOk()) {
+    return {.error = res.error};
   }
+
+  return {.value = std::move(mp)};
+}
+
+OkOrErr DynamicMsgFactory::LoadFromArray(
+                const std::string &type_url,
+                const std::byte *data,
+                size_t size,
+                std::unique_ptr<::google::protobuf::Message> &msg) {
+
+  if ((data == nullptr) || (size == 0)) {
+    return {.error = "Bad array"};
+  }
+
+  auto maybe_prototype = GetPrototype(type_url);
+  if (!maybe_prototype.IsOk()) {
+    return {.error = maybe_prototype.error};
+  }
+
+  const ::google::protobuf::Message *prototype = *maybe_prototype.value;
+  if (!msg || msg->GetDescriptor() != prototype->GetDescriptor()) {
+    msg.reset(prototype->New());
+  }
+  return PBFactory::LoadFromArray(data, size, msg.get());
+}
+
+Result<const ::google::protobuf::Message *> DynamicMsgFactory::GetPrototype(
+                const std::string &type_url) {
+
   Impl &impl = *_impl;
 
+  // Fast path: prototype is cached
+  {
+    std::shared_lock<std::shared_mutex> lock(impl.mutex);
+    auto it = impl.type_url_to_prototype.find(type_url);
+    if (it != impl.type_url_to_prototype.end()) {
+      return {.value = it->second};
+    } else if (impl.known_descriptor_names.empty()) {
+      return {.error = 
+        "This factory has no known types. "
+        "Use RegisterType() or RegisterTypes()"
+      };
+    }
+  }
+
+  // Slow path: find and cache the prototype
+  std::unique_lock<std::shared_mutex> lock(impl.mutex);
   const ::google::protobuf::Descriptor *mt = nullptr;
   mt = impl.pool->FindMessageTypeByName(GetMessageTypeName(type_url));
   if (!mt) {
@@ -447,21 +971,17 @@ DynamicMsgFactory::MsgPtrOrErr DynamicMsgFactory::LoadFromArray(
     };
   }
 
-  std::unique_ptr<::google::protobuf::Message> mp(prototype->New());
-  auto res = PBFactory::LoadFromArray(data, size, mp.get());
-  if (!res.IsOk()) {
-    return {.error = res.error};
-  }
-
-  return {.value = std::move(mp)};
+  impl.type_url_to_prototype[type_url] = prototype;
+  return {.value = prototype};
 }
 
 std::string DynamicMsgFactory::ToString() const {
   std::stringstream ss;
   ss << "DynamicMsgFactory" << std::endl;
 
-  if (_impl) {
-    Impl &impl = *_impl;
+  Impl &impl = *_impl;
+  std::shared_lock<std::shared_mutex> lock(impl.mutex);
+  if (!impl.known_descriptor_names.empty()) {
 
     // message types
     {
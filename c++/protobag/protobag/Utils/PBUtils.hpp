@@ -22,6 +22,7 @@ limitations under the License.
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <fmt/format.h>
 
@@ -65,6 +66,14 @@ inline std::string GetTypeURL() {
       // https://github.com/protocolbuffers/protobuf/blob/39d730dd96c81196893734ee1e075c34567e59ae/src/google/protobuf/any.cc#L44
 }
 
+// Get the type URL for a message with the given `descriptor`; see above
+inline std::string GetTypeURL(
+    const ::google::protobuf::Descriptor *descriptor) {
+  return ::google::protobuf::internal::GetTypeUrl(
+    descriptor->full_name(),
+    ::google::protobuf::internal::kTypeGoogleApisComPrefix);
+}
+
 // Similar to protobuf interal ParseTypeUrl(), except that we ignore the 
 // leading url prefix, if any, because it's usually "type.googleapis.com/"
 // (kTypeGoogleApisComPrefix).  The token returned is equivalent to the
@@ -435,7 +444,9 @@ Result<const ::google::protobuf::Message *> GetAttr_msg(
 // Given a `message`, get the attribute at `field_path`.  If `field_path` is
 // a field on `message`, get that field.  Otherwise if `field_path` is a
 // period (.) delimited string to a nested attribute, recursively descend
-// into children of `message` to find the field.
+// into children of `message` to find the field.  NB: these utils look up
+// fields by name on every call; to extract values from many messages of the
+// same type, use `CompiledFieldPath` below.
 Result<int32_t> GetDeep_int32(
     const ::google::protobuf::Message *message,
     const std::string &field_path);
@@ -465,7 +476,76 @@ Result<const ::google::protobuf::Message *> GetDeep_msg(
     const ::google::protobuf::Message *message,
     const std::string &field_path);
 
-// TODO: support repeated, maps, enums, etc
+// A field path (as in GetDeep_*() above) resolved once against a message
+// `Descriptor`, so that values can be extracted from many messages of that
+// type via cached `FieldDescriptor`s (i.e. without any string work).  Beyond
+// what GetDeep_*() supports, path components may also index into repeated
+// fields and maps:
+//  * "points[3].x" -- field `x` of element 3 of repeated field `points`
+//  * "labels[car]" -- the value for key "car" of map field `labels` (keys
+//                       may be strings, integers, or bools)
+// Enum fields can be read as their number (`Get_int32()`) or as their value
+// name (`Get_string()`).
+class CompiledFieldPath final {
+public:
+  static Result<CompiledFieldPath> Compile(
+    const ::google::protobuf::Descriptor *descriptor,
+    const std::string &field_path);
+
+  Result<int32_t> Get_int32(const ::google::protobuf::Message *message) const;
+  Result<int64_t> Get_int64(const ::google::protobuf::Message *message) const;
+  Result<uint32_t> Get_uint32(const ::google::protobuf::Message *message) const;
+  Result<uint64_t> Get_uint64(const ::google::protobuf::Message *message) const;
+  Result<float> Get_float(const ::google::protobuf::Message *message) const;
+  Result<double> Get_double(const ::google::protobuf::Message *message) const;
+  Result<bool> Get_bool(const ::google::protobuf::Message *message) const;
+  Result<std::string> Get_string(
+    const ::google::protobuf::Message *message) const;
+  Result<const ::google::protobuf::Message *> Get_msg(
+    const ::google::protobuf::Message *message) const;
+
+  // Get any numeric (or bool or enum) value converted to a double
+  Result<double> Get_as_double(
+    const ::google::protobuf::Message *message) const;
+
+  const std::string &GetPath() const { return _path; }
+  const ::google::protobuf::Descriptor *GetDescriptor() const {
+    return _descriptor;
+  }
+  
+  // The field at the end of the path, or for a map lookup, the map
+  // value field
+  const ::google::protobuf::FieldDescriptor *GetLeafField() const;
+
+  struct Step {
+    const ::google::protobuf::FieldDescriptor *field = nullptr;
+
+    // For repeated fields
+    int index = -1;
+
+    // For maps
+    bool is_map_lookup = false;
+    const ::google::protobuf::FieldDescriptor *map_key_field = nullptr;
+    const ::google::protobuf::FieldDescriptor *map_value_field = nullptr;
+    std::string key_str;
+    int64_t key_int = 0;
+    uint64_t key_uint = 0;
+  };
+
+  // The value at the end of the path: `field` on `message`, or element
+  // `index` of `field` if `index` >= 0
+  struct Location {
+    const ::google::protobuf::Message *message = nullptr;
+    const ::google::protobuf::FieldDescriptor *field = nullptr;
+    int index = -1;
+  };
+  Result<Location> Resolve(const ::google::protobuf::Message *message) const;
+
+protected:
+  const ::google::protobuf::Descriptor *_descriptor = nullptr;
+  std::string _path;
+  std::vector<Step> _steps;
+};
 
 const char * const GetPBCPPTypeName(
   ::google::protobuf::FieldDescriptor::CppType type_id);
@@ -485,10 +565,18 @@ const char * const GetPBCPPTypeName(
 // https://developers.google.com/protocol-buffers/docs/techniques#self-description
 // Protobuf has all the tools but only really puts them together in their 
 // `util.json_util` module.
+//
+// Thread safety: a single `DynamicMsgFactory` may be shared across threads.
+// Decoding (`LoadFromArray()` etc.) may run concurrently from many threads
+// and only takes a shared (reader) lock once a type's prototype is cached;
+// `RegisterType()` takes an exclusive (writer) lock.  Note that copies of a
+// `DynamicMsgFactory` share the same underlying descriptor pool.
 class DynamicMsgFactory {
 public:
   typedef std::shared_ptr<DynamicMsgFactory> Ptr;
 
+  DynamicMsgFactory();
+
   typedef Result<std::unique_ptr<::google::protobuf::Message>> MsgPtrOrErr;
 
   // Create and return a Message (actually a DynamicMessage) of type `type_url`
@@ -517,8 +605,33 @@ public:
     return LoadFromArray(type_url, (const std::byte *) c.data(), c.size());
   }
 
+  // Like above, but parse into `msg`, re-using `msg` (and its allocated 
+  // memory) if it is already of type `type_url`.  Otherwise, `msg` is
+  // replaced with a new instance of type `type_url`.  Use this to decode
+  // a stream of messages while minimizing allocation.
+  OkOrErr LoadFromArray(
+                const std::string &type_url,
+                const std::byte *data,
+                size_t size,
+                std::unique_ptr<::google::protobuf::Message> &msg);
+
+  template <typename ContainerT>
+  OkOrErr LoadFromContainer(
+                  const std::string &type_url,
+                  const ContainerT &c,
+                  std::unique_ptr<::google::protobuf::Message> &msg) {
+    return LoadFromArray(type_url, (const std::byte *) c.data(), c.size(), msg);
+  }
+
+  // Get the (cached) prototype message for `type_url`; the prototype has the
+  // same lifetime as this factory.  After the first lookup for a type, 
+  // subsequent lookups skip the DescriptorPool and DynamicMessageFactory.
+  Result<const ::google::protobuf::Message *> GetPrototype(
+                const std::string &type_url);
+
   // Register the given Protobuf type(s) with this factory by providing their
-  // (serializable) message definition FileDescriptor(s)
+  // (serializable) message definition FileDescriptor(s).  Files already
+  // registered (by name) are skipped.
   void RegisterTypes(const ::google::protobuf::FileDescriptorSet &fds);
   void RegisterType(const ::google::protobuf::FileDescriptorProto &fd);
 
@@ -527,7 +640,6 @@ public:
 protected:
   struct Impl;
   std::shared_ptr<Impl> _impl;
-  void LazyInitImpl();
 };
 
 
@@ -16,27 +16,46 @@ limitations under the License.
 
 #pragma once
 
+#include <cstdint>
 #include <optional>
 #include <string>
 
 namespace protobag {
 
+// What kind of failure a Result is.  Conditions that callers test for on
+// every read (and often accept, e.g. end-of-sequence) get their own codes so
+// that testing for them is an integer comparison rather than a string
+// comparison.  Results with these codes carry only a short constant message
+// (which fits in std::string's small buffer, so no heap allocation) unless
+// the code that surfaces them adds detail.
+enum class ResultCode : uint8_t {
+  kError = 0,
+  kEndOfSequence,
+  kNotFound,
+};
+
 // A hacky std::expected<> while the committee seeks consensus
 template <typename T>
 struct Result {
   std::optional<T> value;
   std::string error;
+  ResultCode code = ResultCode::kError;
+    // Only meaningful if not OK
 
   bool IsOk() const { return value.has_value(); }
 
+  // Is this a failure of kind `c`?
+  bool Is(ResultCode c) const { return !IsOk() && code == c; }
+
   // Or use "{.value = v}"
   static Result<T> Ok(T &&v) {
     return {.value = std::move(v)};
   }
 
   // Or use "{.error = s}"
-  static Result<T> Err(const std::string &s) {
-    return {.error = s};
+  static Result<T> Err(
+      const std::string &s, ResultCode c = ResultCode::kError) {
+    return {.error = s, .code = c};
   }
 };
 
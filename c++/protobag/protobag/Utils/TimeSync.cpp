@@ -34,14 +34,11 @@ using Timestamp = ::google::protobuf::Timestamp;
 
 namespace protobag {
 
-bool MaybeBundle::IsNotFound() const {
-  return error == archive::Archive::ReadStatus::EntryNotFound().error;
-}
-
 
 
+template <typename ValueT>
 struct TopicQ {
-  std::map<Timestamp, Entry> q;
+  std::map<Timestamp, ValueT> q;
 
   void PopMostStale() {
     Timestamp t = MaxTimestamp();
@@ -51,19 +48,19 @@ struct TopicQ {
     Pop(t);
   }
   
-  std::optional<Entry> Pop(const Timestamp &t) {
+  std::optional<ValueT> Pop(const Timestamp &t) {
     auto it = q.find(t);
     if (it == q.end()) {
       return std::nullopt;
     } else {
-      Entry entry = std::move(it->second);
+      ValueT v = std::move(it->second);
       q.erase(it);
-      return std::move(entry);
+      return std::move(v);
     }
   }
 
-  void Push(const Timestamp &t, Entry &&entry) {
-    q.insert({t, entry});
+  void Push(const Timestamp &t, ValueT &&v) {
+    q.insert({t, std::move(v)});
   }
   
   size_t Size() const { return q.size(); }
@@ -143,12 +140,18 @@ std::vector<Timestamp> FindMinCostBundle(
 }
 
 
-struct MaxSlopTimeSync::Impl {
+// The queueing and bundling core of the Max Slop algorithm.  Queues hold
+// values of type `ValueT` (e.g. `Entry`s, or just `TopicTime`s when planning
+// from an index).
+template <typename ValueT>
+struct MaxSlopQueues {
+  typedef std::list<ValueT> Bundle;
+
   MaxSlopTimeSync::Spec spec;
-  std::unordered_map<std::string, TopicQ> topic_to_q;
+  std::unordered_map<std::string, TopicQ<ValueT>> topic_to_q;
   std::vector<std::string> topics_ordered;
 
-  explicit Impl(const MaxSlopTimeSync::Spec &s) {
+  explicit MaxSlopQueues(const MaxSlopTimeSync::Spec &s) {
     spec = s;
     for (const auto &topic : s.topics) {
       topic_to_q[topic] = {};
@@ -157,38 +160,35 @@ struct MaxSlopTimeSync::Impl {
     std::sort(topics_ordered.begin(), topics_ordered.end());
   }
 
-  void Enqueue(Entry &&entry) {
-    const auto &maybeTT = entry.GetTopicTime();
-    if (!maybeTT.has_value()) {
-      return;
-    }
-    const TopicTime &tt = *maybeTT;
-    if (topic_to_q.find(tt.topic()) != topic_to_q.end()) {
+  bool HasTopic(const std::string &topic) const {
+    return topic_to_q.find(topic) != topic_to_q.end();
+  }
+
+  void Enqueue(const TopicTime &tt, ValueT &&v) {
+    if (HasTopic(tt.topic())) {
       auto &topic_q = topic_to_q[tt.topic()];
       if (topic_q.Size() >= spec.max_queue_size) {
         topic_q.PopMostStale();
       }
-      topic_q.Push(tt.timestamp(), std::move(entry));
+      topic_q.Push(tt.timestamp(), std::move(v));
     }
   }
 
-  MaybeBundle TryGetNext() {
-    static const MaybeBundle kNoBundle = MaybeBundle::EndOfSequence();
-    if (topic_to_q.empty()) { return kNoBundle; }
+  // Returns the next bundle, or the empty bundle if there is no bundle yet
+  Result<Bundle> TryGetNext() {
+    if (topic_to_q.empty()) { return {.value = Bundle()}; }
 
     // To create a bundle, each queue must have at least one entry
     for (const auto &tq : topic_to_q) {
       if (tq.second.IsEmpty()) {
-        return kNoBundle;
+        return {.value = Bundle()};
       }
     }
     
     return TryCreateBundle();
   }
 
-  MaybeBundle TryCreateBundle() {
-    static const MaybeBundle kNoBundle = MaybeBundle::EndOfSequence();
-    
+  Result<Bundle> TryCreateBundle() {
     std::vector<std::vector<Timestamp>> all_q_stamps;
     all_q_stamps.reserve(topic_to_q.size());
     for (const auto &topic : topics_ordered) {
@@ -196,27 +196,56 @@ struct MaxSlopTimeSync::Impl {
     }
     auto maybe_bundle_ts = FindMinCostBundle(all_q_stamps, spec.max_slop);
     if (maybe_bundle_ts.empty()) {
-      return kNoBundle;
+      return {.value = Bundle()};
     } else {
 
-      EntryBundle bundle;
+      Bundle bundle;
       for (size_t qid = 0; qid < maybe_bundle_ts.size(); ++qid) {
         const auto &topic = topics_ordered[qid];
         auto &q = topic_to_q[topic];
         const Timestamp &q_t = maybe_bundle_ts[qid];
 
-        auto maybe_entry = q.Pop(q_t);
-        if (!maybe_entry.has_value()) {
-          return MaybeBundle::Err(fmt::format(
+        auto maybe_v = q.Pop(q_t);
+        if (!maybe_v.has_value()) {
+          return {.error = fmt::format(
             ("Programming error: tried to find entry at time {} for "
               "queue {} but entry was missing"),
             ::google::protobuf::util::TimeUtil::ToString(q_t),
-            topic));
+            topic)
+          };
         }
-        bundle.push_back(std::move(*maybe_entry));
+        bundle.push_back(std::move(*maybe_v));
       }
-      return MaybeBundle::Ok(std::move(bundle));
+      return {.value = std::move(bundle)};
+
+    }
+  }
+};
 
+
+struct MaxSlopTimeSync::Impl {
+  MaxSlopQueues<Entry> queues;
+
+  explicit Impl(const MaxSlopTimeSync::Spec &s) : queues(s) { }
+
+  void Enqueue(Entry &&entry) {
+    const auto &maybeTT = entry.GetTopicTime();
+    if (!maybeTT.has_value()) {
+      return;
+    }
+    queues.Enqueue(*maybeTT, std::move(entry));
+  }
+
+  MaybeBundle TryGetNext() {
+    static const MaybeBundle kNoBundle = MaybeBundle::EndOfSequence();
+    
+    auto maybe_bundle = queues.TryGetNext();
+    if (!maybe_bundle.IsOk()) {
+      return MaybeBundle::Err(maybe_bundle.error, maybe_bundle.code);
+    } else if (maybe_bundle.value->empty()) {
+      return kNoBundle;
+    } else {
+      return MaybeBundle::Ok(std::move(*maybe_bundle.value));
     }
   }
 };
@@ -259,7 +288,8 @@ MaybeBundle MaxSlopTimeSync::GetNext() {
       auto maybe_next_entry = rs.GetNext();
       if (!maybe_next_entry.IsOk()) { 
         reading = false;
-        return MaybeBundle::Err(maybe_next_entry.error);
+        return MaybeBundle::Err(
+          maybe_next_entry.error, maybe_next_entry.code);
       }
 
       _impl->Enqueue(std::move(*maybe_next_entry.value));
@@ -273,4 +303,334 @@ MaybeBundle MaxSlopTimeSync::GetNext() {
   }
 }
 
+
+
+struct IndexedMaxSlopTimeSync::Impl {
+  BagIndex index;
+  int next_index_entry = 0;
+  std::optional<WindowFilter> window_filter;
+  MaxSlopQueues<TopicTime> queues;
+
+  explicit Impl(const MaxSlopTimeSync::Spec &s) : queues(s) { }
+
+  // Advance through the index until we can plan the next bundle; return the
+  // `TopicTime`s for that bundle, or an empty bundle if the index has
+  // been exhausted.
+  Result<std::list<TopicTime>> PlanNext() {
+    while (next_index_entry < index.time_ordered_entries_size()) {
+      const TopicTime &tt = index.time_ordered_entries(next_index_entry);
+      ++next_index_entry;
+
+      if (!queues.HasTopic(tt.topic())) {
+        continue;
+      }
+      if (window_filter.has_value() && !window_filter->Includes(tt)) {
+        continue;
+      }
+
+      queues.Enqueue(tt, TopicTime(tt));
+      auto maybe_bundle = queues.TryGetNext();
+      if (!maybe_bundle.IsOk() || !maybe_bundle.value->empty()) {
+        return maybe_bundle;
+      } // else continue planning; maybe we'll get a bundle next time
+    }
+
+    return {.value = std::list<TopicTime>()};
+  }
+};
+
+namespace {
+
+// Syncs that plan from the index use only the Selection of `rs`, so they
+// must reject any other read options rather than silently ignore them
+OkOrErr CheckOnlySelection(const ReadSession &rs, const std::string &sync) {
+  const ReadSession::Spec &rs_spec = rs.GetSpec();
+  if (!rs_spec.predicates.empty()) {
+    return {.error = fmt::format("{} does not support field predicates", sync)};
+  } else if (rs_spec.num_shards > 1) {
+    return {.error = fmt::format("{} does not support sharded reads", sync)};
+  } else if (rs_spec.shuffle.has_value()) {
+    return {.error = fmt::format("{} does not support shuffled reads", sync)};
+  } else if (!rs_spec.resume_cursor.empty()) {
+    return {.error = fmt::format("{} does not support read cursors", sync)};
+  }
+  return kOK;
+}
+
+} // anon namespace
+
+Result<TimeSync::Ptr> IndexedMaxSlopTimeSync::Create(
+    const ReadSession::Ptr &rs,
+    const Spec &spec) {
+
+  if (!rs) {
+    return {.error = "Null read session; nothing to read"};
+  }
+  {
+    auto status = CheckOnlySelection(*rs, "IndexedMaxSlopTimeSync");
+    if (!status.IsOk()) {
+      return {.error = status.error};
+    }
+  }
+
+  const Selection &sel = rs->GetSpec().selection;
+  if (!(sel.has_window() || sel.has_select_all())) {
+    return {.error = 
+      "IndexedMaxSlopTimeSync only supports Window or All selections"
+    };
+  }
+
+  std::shared_ptr<Impl> impl(new Impl(spec));
+  {
+    auto maybe_index = rs->ReadIndex();
+    if (!maybe_index.IsOk()) {
+      return {.error = fmt::format(
+        "IndexedMaxSlopTimeSync needs an index: {}", maybe_index.error)
+      };
+    }
+    impl->index = std::move(*maybe_index.value);
+  }
+  if (sel.has_window()) {
+    impl->window_filter.emplace(sel.window());
+  }
+
+  auto *sync = new IndexedMaxSlopTimeSync();
+  TimeSync::Ptr p(sync);
+
+  sync->_read_sess = rs;
+  sync->_spec = spec;
+  sync->_impl = impl;
+
+  return {.value = p};
+}
+
+MaybeBundle IndexedMaxSlopTimeSync::GetNext() {
+  if (!_impl) {
+    return MaybeBundle::Err("Programming error: impl not initialized");
+  }
+  if (!_read_sess) {
+    return MaybeBundle::Err("Programming error: null read session");
+  }
+
+  auto maybe_plan = _impl->PlanNext();
+  if (!maybe_plan.IsOk()) {
+    return MaybeBundle::Err(maybe_plan.error);
+  } else if (maybe_plan.value->empty()) {
+    return MaybeBundle::EndOfSequence();
+  }
+
+  // Now read just the entries in the bundle
+  EntryBundle bundle;
+  for (const TopicTime &tt : *maybe_plan.value) {
+    auto maybe_entry = _read_sess->ReadEntry(tt.entryname());
+    if (!maybe_entry.IsOk()) {
+      return MaybeBundle::Err(fmt::format(
+        "Failed to read planned entry {}: {}",
+        tt.entryname(), maybe_entry.error));
+    }
+    bundle.push_back(std::move(*maybe_entry.value));
+  }
+  return MaybeBundle::Ok(std::move(bundle));
+}
+
+
+
+struct FixedRateTimeSync::Impl {
+  // All indexed messages for a single topic, in time order
+  struct Track {
+    std::vector<TopicTime> tts;
+    
+    // Index of the first message strictly after the current tick
+    size_t cursor = 0;
+
+    // Entries read for recent ticks, keyed by index into `tts`
+    std::map<size_t, Entry> cache;
+  };
+
+  std::vector<Track> tracks;
+  Timestamp next_tick;
+  Timestamp last_tick;
+  Duration period;
+
+  // Get entry `i` of `track`; copy it if we'll `keep` it cached for a later
+  // tick, else move it out
+  MaybeEntry GetEntry(Track &track, size_t i, ReadSession &rs, bool keep) {
+    auto it = track.cache.find(i);
+    if (it == track.cache.end()) {
+      const TopicTime &tt = track.tts[i];
+      auto maybe_entry = rs.ReadEntry(tt.entryname());
+      if (!maybe_entry.IsOk()) {
+        return MaybeEntry::Err(fmt::format(
+          "Failed to read entry {}: {}", tt.entryname(), maybe_entry.error));
+      }
+      if (!keep) {
+        return maybe_entry;
+      }
+      it = track.cache.emplace(i, std::move(*maybe_entry.value)).first;
+    }
+
+    if (keep) {
+      return MaybeEntry::Ok(Entry(it->second));
+    }
+    auto maybe_entry = MaybeEntry::Ok(std::move(it->second));
+    track.cache.erase(it);
+    return maybe_entry;
+  }
+};
+
+Result<TimeSync::Ptr> FixedRateTimeSync::Create(
+    const ReadSession::Ptr &rs,
+    const Spec &spec) {
+
+  if (!rs) {
+    return {.error = "Null read session; nothing to read"};
+  }
+  {
+    auto status = CheckOnlySelection(*rs, "FixedRateTimeSync");
+    if (!status.IsOk()) {
+      return {.error = status.error};
+    }
+  }
+  if (spec.topics.empty()) {
+    return {.error = "FixedRateTimeSync needs at least one topic"};
+  }
+  if (spec.period <= Duration()) {
+    return {.error = fmt::format(
+      "FixedRateTimeSync needs a positive period, got {}",
+      ::google::protobuf::util::TimeUtil::ToString(spec.period))
+    };
+  }
+
+  const Selection &sel = rs->GetSpec().selection;
+  if (!(sel.has_window() || sel.has_select_all())) {
+    return {.error = 
+      "FixedRateTimeSync only supports Window or All selections"
+    };
+  }
+
+  auto maybe_index = rs->ReadIndex();
+  if (!maybe_index.IsOk()) {
+    return {.error = fmt::format(
+      "FixedRateTimeSync needs an index: {}", maybe_index.error)
+    };
+  }
+  const BagIndex &index = *maybe_index.value;
+
+  std::optional<WindowFilter> window_filter;
+  if (sel.has_window()) {
+    window_filter.emplace(sel.window());
+  }
+
+  std::shared_ptr<Impl> impl(new Impl());
+  impl->period = spec.period;
+  impl->tracks.resize(spec.topics.size());
+  {
+    std::unordered_map<std::string, size_t> topic_to_track;
+    for (size_t i = 0; i < spec.topics.size(); ++i) {
+      if (!topic_to_track.emplace(spec.topics[i], i).second) {
+        return {.error = fmt::format(
+          "FixedRateTimeSync got topic {} more than once", spec.topics[i])
+        };
+      }
+    }
+
+    for (const TopicTime &tt : index.time_ordered_entries()) {
+      auto it = topic_to_track.find(tt.topic());
+      if (it == topic_to_track.end()) {
+        continue;
+      }
+      if (window_filter.has_value() && !window_filter->Includes(tt)) {
+        continue;
+      }
+      impl->tracks[it->second].tts.push_back(tt);
+    }
+  }
+
+  // Only emit ticks where every topic has a message before and after
+  impl->next_tick = MinTimestamp();
+  impl->last_tick = MaxTimestamp();
+  for (const auto &track : impl->tracks) {
+    if (track.tts.empty()) {
+      // No bundles possible
+      impl->next_tick = MaxTimestamp();
+      impl->last_tick = MinTimestamp();
+      break;
+    }
+    impl->next_tick = std::max(impl->next_tick, track.tts.front().timestamp());
+    impl->last_tick = std::min(impl->last_tick, track.tts.back().timestamp());
+  }
+
+  auto *sync = new FixedRateTimeSync();
+  TimeSync::Ptr p(sync);
+
+  sync->_read_sess = rs;
+  sync->_spec = spec;
+  sync->_impl = impl;
+
+  return {.value = p};
+}
+
+MaybeBundle FixedRateTimeSync::GetNext() {
+  if (!_impl) {
+    return MaybeBundle::Err("Programming error: impl not initialized");
+  }
+  if (!_read_sess) {
+    return MaybeBundle::Err("Programming error: null read session");
+  }
+
+  Impl &impl = *_impl;
+  if (impl.last_tick < impl.next_tick) {
+    return MaybeBundle::EndOfSequence();
+  }
+
+  const Timestamp tick = impl.next_tick;
+  EntryBundle bundle;
+  for (auto &track : impl.tracks) {
+    while (
+        track.cursor < track.tts.size() &&
+        track.tts[track.cursor].timestamp() <= tick) {
+      ++track.cursor;
+    }
+
+    // Ticks are bounded by the first and last message of every topic, so
+    // both neighbors exist
+    const size_t before = track.cursor - 1;
+    const size_t after = 
+      (track.tts[before].timestamp() == tick) ? before : track.cursor;
+
+    // Evict cached entries that can't bracket any future tick
+    track.cache.erase(track.cache.begin(), track.cache.lower_bound(before));
+
+    // Find the entries that bracket the next tick; we only need to keep
+    // those cached (later ticks only bracket later entries)
+    const Timestamp next_tick = tick + impl.period;
+    size_t next_cursor = track.cursor;
+    while (
+        next_cursor < track.tts.size() &&
+        track.tts[next_cursor].timestamp() <= next_tick) {
+      ++next_cursor;
+    }
+    const size_t next_before = next_cursor - 1;
+    const size_t next_after = 
+      (track.tts[next_before].timestamp() == next_tick) ?
+        next_before : next_cursor;
+
+    const size_t bracket[] = {before, after};
+    for (size_t j = 0; j < 2; ++j) {
+      const size_t i = bracket[j];
+      const bool keep = 
+        (j == 0 && before == after) || // Exact hit needs entry `i` twice
+        i == next_before || i == next_after;
+      auto maybe_entry = impl.GetEntry(track, i, *_read_sess, keep);
+      if (!maybe_entry.IsOk()) {
+        return MaybeBundle::Err(maybe_entry.error, maybe_entry.code);
+      }
+      bundle.push_back(std::move(*maybe_entry.value));
+    }
+  }
+
+  impl.next_tick = tick + impl.period;
+  return MaybeBundle::Ok(std::move(bundle));
+}
+
 } /* namespace protobag */
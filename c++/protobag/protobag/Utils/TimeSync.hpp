@@ -33,14 +33,17 @@ typedef std::list<Entry> EntryBundle;
 // one message per topic for a list of distinct topics requested from a 
 // `TimeSync` below.
 struct MaybeBundle : Result<EntryBundle> {
-  static MaybeBundle EndOfSequence() { return Err("EndOfSequence"); }
-  bool IsEndOfSequence() const { return error == "EndOfSequence"; }
+  static MaybeBundle EndOfSequence() {
+    return Err("EndOfSequence", ResultCode::kEndOfSequence);
+  }
+  bool IsEndOfSequence() const { return Is(ResultCode::kEndOfSequence); }
 
   // See Archive::ReadStatus
-  bool IsNotFound() const;
+  bool IsNotFound() const { return Is(ResultCode::kNotFound); }
 
-  static MaybeBundle Err(const std::string &s) {
-    MaybeBundle m; m.error = s; return m;
+  static MaybeBundle Err(
+      const std::string &s, ResultCode c = ResultCode::kError) {
+    MaybeBundle m; m.error = s; m.code = c; return m;
   }
 
   static MaybeBundle Ok(EntryBundle &&v) {
@@ -124,4 +127,71 @@ protected:
 };
 
 
+// Emits the same bundles as `MaxSlopTimeSync`, but plans each bundle using
+// only the topics and timestamps in the protobag's index
+// (`BagIndex.time_ordered_entries`) and then reads only the entries that are
+// actually emitted.  When synchronizing high-rate topics to a low-rate one,
+// this utility skips reading (and decoding) most messages.
+//
+// NOTE: requires an indexed protobag and a ReadSession with a Window (or All)
+//   Selection; the session is only used for its Selection and to read the
+//   planned entries.  Sessions with field predicates, sharding, shuffling
+//   or a resume cursor are rejected.
+class IndexedMaxSlopTimeSync final : public TimeSync {
+public:
+  typedef MaxSlopTimeSync::Spec Spec;
+
+  static Result<TimeSync::Ptr> Create(
+    const ReadSession::Ptr &rs,
+    const Spec &spec);
+  
+  MaybeBundle GetNext() override;
+
+protected:
+  Spec _spec;
+
+  struct Impl;
+  std::shared_ptr<Impl> _impl;
+};
+
+
+// Emits bundles at a fixed output rate: starting with the first time at
+// which every topic has a message, and then every `period` thereafter
+// (until some topic runs out of messages), emits a bundle containing, for
+// each topic in `topics` (and in that order), the nearest message at or
+// before the tick followed by the nearest message at or after the tick.
+// If a message lands exactly on a tick, it is both the "before" and "after"
+// message for that topic.  Useful for resampling topics (e.g. for
+// interpolation) to a single fixed rate.
+//
+// Like `IndexedMaxSlopTimeSync`, uses only the protobag's index to find the
+// messages that bracket each tick and reads only those messages.  Messages
+// shared between consecutive ticks (e.g. for topics slower than `period`)
+// are cached and read only once.
+//
+// NOTE: requires an indexed protobag and a ReadSession with a Window (or All)
+//   Selection; the session is only used for its Selection and to read the
+//   bracketing entries.  Sessions with field predicates, sharding, shuffling
+//   or a resume cursor are rejected.
+class FixedRateTimeSync final : public TimeSync {
+public:
+  struct Spec {
+    std::vector<std::string> topics;
+    ::google::protobuf::Duration period;
+  };
+
+  static Result<TimeSync::Ptr> Create(
+    const ReadSession::Ptr &rs,
+    const Spec &spec);
+  
+  MaybeBundle GetNext() override;
+
+protected:
+  Spec _spec;
+
+  struct Impl;
+  std::shared_ptr<Impl> _impl;
+};
+
+
 } /* namespace protobag */
@@ -17,6 +17,7 @@ limitations under the License.
 #pragma once
 
 #include <string>
+#include <unordered_set>
 
 #include <tuple> 
 #include <google/protobuf/util/time_util.h>
@@ -64,4 +65,42 @@ inline ::google::protobuf::Timestamp MaxTimestamp() {
   return t;
 }
 
+// Tests `TopicTime`s against the criteria of a Selection::Window (topics
+// included / excluded and an inclusive time range)
+class WindowFilter final {
+public:
+  explicit WindowFilter(const Selection_Window &window) : _window(window) {
+    _include_topics.insert(window.topics().begin(), window.topics().end());
+    _exclude_topics.insert(
+      window.exclude_topics().begin(), window.exclude_topics().end());
+  }
+
+  bool Includes(const TopicTime &tt) const {
+    if (!_exclude_topics.empty() &&
+          (_exclude_topics.find(tt.topic()) != _exclude_topics.end())) {
+      return false;
+    }
+
+    if (!_include_topics.empty() &&
+          (_include_topics.find(tt.topic()) == _include_topics.end())) {
+      return false;
+    }
+
+    if (_window.has_start() && (tt.timestamp() < _window.start())) {
+      return false;
+    }
+
+    if (_window.has_end() && (_window.end() < tt.timestamp())) {
+      return false;
+    }
+
+    return true;
+  }
+
+protected:
+  Selection_Window _window;
+  std::unordered_set<std::string> _include_topics;
+  std::unordered_set<std::string> _exclude_topics;
+};
+
 } /* namespace protobag */
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+// Utils for picking apart serialized protobuf messages without decoding
+// (or copying) them, e.g. to find the payload of a serialized `Any`.
+
+namespace protobag {
+
+// Call `OnField(field_number, data)` for each length-delimited field
+// (strings, bytes, and sub-messages) in the serialized message `bytes`;
+// `data` is a view into `bytes`.  Other fields are skipped.  Returns false
+// if `bytes` is not a valid serialized message.
+template <typename OnFieldT>
+inline bool ScanLengthDelimitedFields(std::string_view bytes, OnFieldT OnField) {
+  using ::google::protobuf::internal::WireFormatLite;
+  ::google::protobuf::io::CodedInputStream in(
+    reinterpret_cast<const uint8_t *>(bytes.data()), int(bytes.size()));
+  while (true) {
+    const uint32_t tag = in.ReadTag();
+    if (tag == 0) {
+      // End of input, or an invalid tag
+      return size_t(in.CurrentPosition()) == bytes.size();
+    }
+
+    if (WireFormatLite::GetTagWireType(tag) == 
+          WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      uint32_t size = 0;
+      if (!in.ReadVarint32(&size)) { return false; }
+      const size_t start = size_t(in.CurrentPosition());
+      if (size > bytes.size() - start) { return false; }
+      OnField(
+        WireFormatLite::GetTagFieldNumber(tag), bytes.substr(start, size));
+      if (!in.Skip(int(size))) { return false; }
+    } else if (!WireFormatLite::SkipField(&in, tag)) {
+      return false;
+    }
+  }
+}
+
+// A view of a serialized `google.protobuf.Any`
+struct AnyView {
+  std::string_view type_url;
+  std::string_view value;
+};
+
+// Fill `out` with views into the `Any` serialized in `bytes`; returns false
+// if `bytes` is invalid.
+inline bool ScanAny(std::string_view bytes, AnyView &out) {
+  out = AnyView();
+  return ScanLengthDelimitedFields(bytes,
+    [&](int field, std::string_view data) {
+      if (field == 1) {
+        out.type_url = data;
+      } else if (field == 2) {
+        out.value = data;
+      }
+    });
+}
+
+// A view of a serialized `StampedMessage`
+struct StampedMessageView {
+  std::string_view timestamp; // A serialized google.protobuf.Timestamp
+  AnyView msg;
+};
+
+// Fill `out` with views into the `StampedMessage` serialized in `bytes`;
+// returns false if `bytes` is invalid.
+inline bool ScanStampedMessage(
+    std::string_view bytes, StampedMessageView &out) {
+
+  out = StampedMessageView();
+  std::string_view msg;
+  bool success = ScanLengthDelimitedFields(bytes,
+    [&](int field, std::string_view data) {
+      if (field == 1) {
+        out.timestamp = data;
+      } else if (field == 2) {
+        msg = data;
+      }
+    });
+  return success && ScanAny(msg, out.msg);
+}
+
+} /* namespace protobag */
@@ -16,17 +16,196 @@ limitations under the License.
 
 #include "protobag/WriteSession.hpp"
 
+#include <filesystem>
+#include <limits>
+
 #include <fmt/format.h>
 
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/util/time_util.h>
+#include <google/protobuf/wire_format_lite.h>
 
+#include "protobag/ReadSession.hpp"
 #include "protobag/Utils/PBUtils.hpp"
 
 
 namespace protobag {
 
+namespace {
+
+using ::google::protobuf::io::CodedOutputStream;
+using ::google::protobuf::internal::WireFormatLite;
+
+std::string GetStampedEntryname(
+    const std::string &topic,
+    const ::google::protobuf::Timestamp &t,
+    bool use_text_format) {
+
+  return fmt::format(
+    "{}/{}.{}.stampedmsg.{}",
+    topic,
+    t.seconds(),
+    t.nanos(),
+    use_text_format ? "prototxt" : "protobin");
+}
+
+// Size of the length prefix and `size` bytes of data of a length-delimited
+// field (i.e. excluding the tag)
+inline size_t LengthDelimitedSize(size_t size) {
+  return CodedOutputStream::VarintSize32(uint32_t(size)) + size;
+}
+
+// Size of a length-delimited field (including the tag), or zero for an empty
+// proto3 string / bytes field, which is not written
+inline size_t StringFieldSize(size_t size) {
+  return size == 0 ? 0 : 1 + LengthDelimitedSize(size);
+}
+
+inline void WriteStringField(
+    int field, std::string_view data, CodedOutputStream &out) {
+
+  if (!data.empty()) {
+    WireFormatLite::WriteTag(
+      field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, &out);
+    out.WriteVarint32(uint32_t(data.size()));
+    out.WriteRaw(data.data(), int(data.size()));
+  }
+}
+
+// Serialize the `Any` that wraps a `StampedMessage` for time `t` whose own
+// `Any` holds a `msg_size`-byte `type_url` message that `WriteMsg` writes.
+// The result is byte-for-byte what `PBFactory::ToBinaryString()` gives for
+// an `Entry::CreateStamped()` entry, but the message is serialized only once
+// and nothing is copied between nested buffers.
+template <typename WriteMsgT>
+std::string EncodeStamped(
+    const ::google::protobuf::Timestamp &t,
+    const std::string &type_url,
+    size_t msg_size,
+    WriteMsgT WriteMsg) {
+
+  // NB: protobuf fields are all 1-byte tags here, and `Any` (field 1
+  // `type_url`, field 2 `value`) and `StampedMessage` (field 1 `timestamp`,
+  // field 2 `msg`) fields are written in field number order, as protobuf
+  // does.
+  const size_t inner_any_size = 
+    StringFieldSize(type_url.size()) + StringFieldSize(msg_size);
+  const size_t t_size = t.ByteSizeLong();
+  const size_t stamped_size = 
+    1 + LengthDelimitedSize(t_size) + 1 + LengthDelimitedSize(inner_any_size);
+  static const std::string kStampedTypeURL = GetTypeURL<StampedMessage>();
+  const size_t outer_any_size = 
+    StringFieldSize(kStampedTypeURL.size()) + StringFieldSize(stamped_size);
+
+  std::string buf;
+  buf.resize(outer_any_size);
+  {
+    ::google::protobuf::io::ArrayOutputStream zero_copy_out(
+      buf.data(), int(buf.size()));
+    CodedOutputStream out(&zero_copy_out);
+
+    // Outer Any
+    WriteStringField(1, kStampedTypeURL, out);
+    WireFormatLite::WriteTag(2, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, &out);
+    out.WriteVarint32(uint32_t(stamped_size));
+
+    // StampedMessage
+    WireFormatLite::WriteTag(1, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, &out);
+    out.WriteVarint32(uint32_t(t_size));
+    t.SerializeWithCachedSizes(&out);
+    WireFormatLite::WriteTag(2, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, &out);
+    out.WriteVarint32(uint32_t(inner_any_size));
+
+    // Inner Any
+    WriteStringField(1, type_url, out);
+    if (msg_size > 0) {
+      WireFormatLite::WriteTag(
+        2, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, &out);
+      out.WriteVarint32(uint32_t(msg_size));
+      WriteMsg(out);
+    }
+  }
+  return buf;
+}
+
+BagIndexBuilder::UPtr CreateIndexer(const WriteSession::Spec &s) {
+  BagIndexBuilder::UPtr indexer;
+  if (s.ShouldDoIndexing()) {
+    indexer.reset(new BagIndexBuilder());
+    indexer->DoTimeseriesIndexing(s.save_timeseries_index);
+    indexer->DoDescriptorIndexing(s.save_descriptor_index);
+  }
+  return indexer;
+}
+
+// Complete the index from `indexer` and write it to `archive`, stamped
+// later than `after` (if given) so that readers pick it over an older index
+OkOrErr WriteIndex(
+    archive::Archive &archive,
+    BagIndexBuilder::UPtr indexer,
+    const std::optional<::google::protobuf::Timestamp> &after = std::nullopt) {
+
+  using ::google::protobuf::util::TimeUtil;
+  BagIndex index = BagIndexBuilder::Complete(std::move(indexer));
+  auto t = TimeUtil::GetCurrentTime();
+  if (after.has_value() && !(*after < t)) {
+    t = *after + TimeUtil::NanosecondsToDuration(1);
+  }
+  const std::string framed = EncodeStamped(
+    t, GetTypeURL<BagIndex>(), index.ByteSizeLong(),
+    [&](CodedOutputStream &out) { index.SerializeWithCachedSizes(&out); });
+  return archive.Write(
+    GetStampedEntryname(
+      "/_protobag_index/bag_index", t, /* use_text_format */ false),
+    framed);
+}
+
+} // anon namespace
+
 Result<WriteSession::Ptr> WriteSession::Create(const Spec &s) {
-  auto maybe_archive = archive::Archive::Open(s.archive_spec);
+  // When appending, the new index must also cover the existing entries
+  const bool appending = s.archive_spec.mode == "append";
+  std::optional<BagIndex> existing_index;
+  std::optional<::google::protobuf::Timestamp> existing_index_stamp;
+  if (appending && s.ShouldSplit()) {
+    return {.error = "Splitting output is not supported when appending"};
+  } else if (appending && s.ShouldDoIndexing()) {
+    archive::Archive::Spec read_spec = s.archive_spec;
+    read_spec.mode = "read";
+    auto maybe_reader = archive::Archive::Open(read_spec);
+    if (!maybe_reader.IsOk()) {
+      return {.error = maybe_reader.error};
+    }
+    auto maybe_entry = 
+      ReadSession::ReadLatestIndexEntry(*maybe_reader.value);
+    if (!maybe_entry.IsOk()) {
+      return {.error = fmt::format(
+        "Can't append to {} without an index: {}",
+        s.archive_spec.path,
+        maybe_entry.IsNotFound() ? "no index found" : maybe_entry.error)
+      };
+    }
+    auto maybe_index = 
+      PBFactory::UnpackFromAny<BagIndex>(maybe_entry.value->msg);
+    if (!maybe_index.IsOk()) {
+      return {.error = maybe_index.error};
+    }
+    existing_index = std::move(*maybe_index.value);
+    existing_index_stamp = maybe_entry.value->ctx->stamp;
+  }
+
+  archive::Archive::Spec archive_spec = s.archive_spec;
+  if (s.ShouldSplit()) {
+    if (archive_spec.format == "memory" || 
+          archive_spec.path.empty() ||
+          archive_spec.path == "<tempfile>") {
+      return {.error = "Splitting output requires an archive path"};
+    }
+    archive_spec.path = GetSplitPath(s.archive_spec.path, 0);
+  }
+
+  auto maybe_archive = archive::Archive::Open(archive_spec);
   if (!maybe_archive.IsOk()) {
     return {.error = maybe_archive.error};
   }
@@ -34,16 +213,109 @@ Result<WriteSession::Ptr> WriteSession::Create(const Spec &s) {
   WriteSession::Ptr w(new WriteSession());
   w->_spec = s;
   w->_archive = *maybe_archive.value;
-  if (s.ShouldDoIndexing()) {
-    w->_indexer.reset(new BagIndexBuilder());
-    if (!w->_indexer) { return {.error = "Could not allocate indexer"}; }
-    w->_indexer->DoTimeseriesIndexing(s.save_timeseries_index);
-    w->_indexer->DoDescriptorIndexing(s.save_descriptor_index);
+  w->_indexer = CreateIndexer(s);
+  if (w->_indexer && existing_index.has_value()) {
+    w->_indexer->ObserveIndex(std::move(*existing_index));
+  }
+  w->_existing_index_stamp = existing_index_stamp;
+  w->_bag_paths.push_back(w->_archive->GetSpec().path);
+  if (s.ShouldSplit()) {
+    w->OpenNextInBackground();
   }
 
   return {.value = w};
 }
 
+std::string WriteSession::GetSplitPath(const std::string &path, size_t bag) {
+  const std::filesystem::path p(path);
+  return (p.parent_path() / fmt::format(
+    "{}.{:04d}{}", p.stem().string(), bag, p.extension().string())).string();
+}
+
+void WriteSession::OpenNextInBackground() {
+  archive::Archive::Spec spec = _spec.archive_spec;
+  spec.path = GetSplitPath(_spec.archive_spec.path, _bag_paths.size());
+  _next_archive = std::async(
+    std::launch::async,
+    [spec]() { return archive::Archive::Open(spec); });
+}
+
+OkOrErr WriteSession::Split() {
+  // Make sure the previous bag is done before we start finishing this one
+  if (_finishing.valid()) {
+    OkOrErr res = _finishing.get();
+    if (!res.IsOk()) {
+      return res;
+    }
+  }
+
+  // Check the next bag before handing off the current one, which (on
+  // failure) stays open for `Close()` to finish
+  auto maybe_archive = _next_archive.get();
+  if (!maybe_archive.IsOk()) {
+    return {.error = fmt::format(
+      "Could not open bag {}: {}", _bag_paths.size(), maybe_archive.error)
+    };
+  }
+
+  _finishing = std::async(
+    std::launch::async,
+    [archive = std::move(_archive), indexer = std::move(_indexer)]() mutable {
+      OkOrErr res = kOK;
+      if (indexer) {
+        res = WriteIndex(*archive, std::move(indexer));
+      }
+      OkOrErr closed = archive->Close();
+      archive.reset();
+      return res.IsOk() ? closed : res;
+    });
+
+  _archive = *maybe_archive.value;
+  _indexer = CreateIndexer(_spec);
+  _bag_paths.push_back(_archive->GetSpec().path);
+  _bag_bytes = 0;
+  _bag_start.reset();
+  OpenNextInBackground();
+  return kOK;
+}
+
+OkOrErr WriteSession::WriteToBag(
+    const std::string &entryname,
+    const std::string &data,
+    const ::google::protobuf::Timestamp *t) {
+
+  if (!_archive) {
+    return OkOrErr::Err("Programming Error: no archive open for writing");
+  } else if (!_split_status.IsOk()) {
+    return _split_status;
+  }
+
+  if (_spec.ShouldSplit()) {
+    const bool full = 
+      _spec.split_bytes > 0 && _bag_bytes >= _spec.split_bytes;
+    const bool past_duration = 
+      t && _bag_start.has_value() &&
+      (_spec.split_duration.seconds() > 0 || 
+        _spec.split_duration.nanos() > 0) &&
+      (*t - *_bag_start) >= _spec.split_duration;
+    if (full || past_duration) {
+      _split_status = Split();
+      if (!_split_status.IsOk()) {
+        return _split_status;
+      }
+    }
+  }
+
+  OkOrErr res = _archive->Write(entryname, data);
+  if (res.IsOk()) {
+    _bag_bytes += data.size();
+    if (t && !_bag_start.has_value()) {
+      _bag_start = *t;
+    }
+  }
+  return res;
+}
+
 OkOrErr WriteSession::WriteEntry(const Entry &entry, bool use_text_format) {
   if (!_archive) {
     return OkOrErr::Err("Programming Error: no archive open for writing");
@@ -68,17 +340,9 @@ OkOrErr WriteSession::WriteEntry(const Entry &entry, bool use_text_format) {
       };
     }
 
-    entryname = fmt::format(
-        "{}/{}.{}.stampedmsg",
-        tt.topic(),
-        tt.timestamp().seconds(),
-        tt.timestamp().nanos());
-
     // TODO: add extension for normal entries?
     entryname = 
-      use_text_format ? 
-        fmt::format("{}.prototxt", entryname) : 
-        fmt::format("{}.protobin", entryname);
+      GetStampedEntryname(tt.topic(), tt.timestamp(), use_text_format);
   }
 
   auto maybe_m_bytes = 
@@ -89,23 +353,128 @@ OkOrErr WriteSession::WriteEntry(const Entry &entry, bool use_text_format) {
     return {.error = maybe_m_bytes.error};
   }
 
-  OkOrErr res = _archive->Write(entryname, *maybe_m_bytes.value);
+  const auto &ctx = entry.ctx;
+  OkOrErr res = WriteToBag(
+    entryname,
+    *maybe_m_bytes.value,
+    ctx.has_value() ? &ctx->stamp : nullptr);
+  if (res.IsOk() && _indexer) {
+    _indexer->Observe(entry, entryname);
+  }
+  return res;
+}
+
+OkOrErr WriteSession::WriteStamped(
+    const std::string &topic,
+    const ::google::protobuf::Timestamp &t,
+    const ::google::protobuf::Message &msg) {
+
+  const size_t msg_size = msg.ByteSizeLong();
+  if (msg_size > size_t(std::numeric_limits<int>::max())) {
+    return {.error = fmt::format(
+      "Message of {} bytes is too large for protobuf", msg_size)
+    };
+  }
+
+  const std::string type_url = GetTypeURL(msg.GetDescriptor());
+  const std::string framed = EncodeStamped(
+    t, type_url, msg_size,
+    [&](CodedOutputStream &out) { msg.SerializeWithCachedSizes(&out); });
+  return WriteStampedFramed(
+    framed, topic, t, type_url, nullptr, msg.GetDescriptor());
+}
+
+OkOrErr WriteSession::WriteStampedUnchecked(
+    const std::string &topic,
+    const ::google::protobuf::Timestamp &t,
+    const std::string &type_url,
+    std::string_view msg_bytes,
+    const ::google::protobuf::FileDescriptorSet *fds,
+    const ::google::protobuf::Descriptor *descriptor) {
+
+  if (msg_bytes.size() > size_t(std::numeric_limits<int>::max())) {
+    return {.error = fmt::format(
+      "Message of {} bytes is too large for protobuf", msg_bytes.size())
+    };
+  }
+
+  const std::string framed = EncodeStamped(
+    t, type_url, msg_bytes.size(),
+    [&](CodedOutputStream &out) {
+      out.WriteRaw(msg_bytes.data(), int(msg_bytes.size()));
+    });
+  return WriteStampedFramed(framed, topic, t, type_url, fds, descriptor);
+}
+
+OkOrErr WriteSession::WriteStampedFramed(
+    const std::string &framed,
+    const std::string &topic,
+    const ::google::protobuf::Timestamp &t,
+    const std::string &type_url,
+    const ::google::protobuf::FileDescriptorSet *fds,
+    const ::google::protobuf::Descriptor *descriptor) {
+
+  if (topic.empty()) {
+    return {.error = "Stamped entries must have a topic"};
+  }
+
+  const std::string entryname = 
+    GetStampedEntryname(topic, t, /* use_text_format */ false);
+  OkOrErr res = WriteToBag(entryname, framed, &t);
   if (res.IsOk() && _indexer) {
+    // The indexer only needs the entry's context
+    Entry entry = {
+      .entryname = entryname,
+      .ctx = Entry::Context{
+        .topic = topic,
+        .stamp = t,
+        .inner_type_url = type_url,
+        .descriptor = descriptor,
+        .fds = fds,
+      },
+    };
     _indexer->Observe(entry, entryname);
   }
   return res;
 }
 
-void WriteSession::Close() {
-  if (_indexer) {
-    BagIndex index = BagIndexBuilder::Complete(std::move(_indexer));
-    WriteEntry(
-      Entry::CreateStamped(
-        "/_protobag_index/bag_index",
-        ::google::protobuf::util::TimeUtil::GetCurrentTime(),
-        index));
-    _indexer = nullptr;
+OkOrErr WriteSession::Close() {
+  // Keep the first error, but finish everything regardless
+  OkOrErr result = kOK;
+  auto Check = [&](OkOrErr status) {
+    if (result.IsOk() && !status.IsOk()) {
+      result = status;
+    }
+  };
+  Check(_split_status);
+
+  if (_indexer && _archive) {
+    Check(WriteIndex(*_archive, std::move(_indexer), _existing_index_stamp));
+  }
+  _indexer = nullptr;
+
+  if (_archive) {
+    Check(_archive->Close());
+    _archive = nullptr;
   }
+
+  if (_finishing.valid()) {
+    Check(_finishing.get());
+  }
+
+  // Discard the next bag, which we opened but never used
+  if (_next_archive.valid()) {
+    auto maybe_archive = _next_archive.get();
+    if (maybe_archive.IsOk()) {
+      const std::string path = (*maybe_archive.value)->GetSpec().path;
+      (*maybe_archive.value)->Close();
+      maybe_archive.value.reset();
+      std::error_code ec;
+      std::filesystem::remove(path, ec);
+    }
+  }
+
+  return result;
 }
 
 
@@ -16,7 +16,14 @@ limitations under the License.
 
 #pragma once
 
+#include <future>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <google/protobuf/duration.pb.h>
 
 #include "protobag/BagIndexBuilder.hpp"
 #include "protobag/Entry.hpp"
@@ -36,6 +43,15 @@ public:
     bool save_timeseries_index = true;
     bool save_descriptor_index = true;
 
+    // Optionally split the output into a sequence of numbered bags (each
+    // with its own complete index): start a new bag once the current one
+    // holds `split_bytes` of entry data, or once a stamped entry is at
+    // least `split_duration` later than the first stamped entry in the
+    // current bag.  Bag `i` is written to `GetSplitPath(archive_spec.path,
+    // i)`.  Zero (the default) means never split.
+    size_t split_bytes = 0;
+    ::google::protobuf::Duration split_duration;
+
     static Spec WriteToTempdir() {
       return {
         .archive_spec = archive::Archive::Spec::WriteToTempdir()
@@ -45,20 +61,94 @@ public:
     bool ShouldDoIndexing() const {
       return save_timeseries_index || save_descriptor_index;
     }
+
+    bool ShouldSplit() const {
+      return 
+        split_bytes > 0 ||
+        split_duration.seconds() > 0 || split_duration.nanos() > 0;
+    }
   };
 
+  // NB: If `archive_spec.mode` is "append", write new entries to an existing
+  // bag (zip or directory); the index written on `Close()` covers both the
+  // existing and the new entries.  NB: A zip being appended to has no valid
+  // central directory until `Close()`, so an interrupted append can lose
+  // the whole zip (see `LibArchiveArchive::Close()`).
   static Result<Ptr> Create(const Spec &s=Spec::WriteToTempdir());
 
   OkOrErr WriteEntry(const Entry &entry, bool use_text_format=false);
 
+  // Write `msg` as a StampedMessage entry for `topic` at time `t`; equivalent
+  // to `WriteEntry(Entry::CreateStamped(topic, t, msg))` except that `msg`
+  // is serialized exactly once, directly into the buffer handed to the
+  // archive (along with its StampedMessage and Any framing) rather than
+  // being serialized into nested `Any`s and copied at each level.
+  OkOrErr WriteStamped(
+    const std::string &topic,
+    const ::google::protobuf::Timestamp &t,
+    const ::google::protobuf::Message &msg);
+
+  // Like `WriteStamped()` but for a message already serialized to
+  // `msg_bytes`, which we trust to be a `type_url` message (see also
+  // `Entry::CreateStampedUnchecked()`).
+  OkOrErr WriteStampedUnchecked(
+    const std::string &topic,
+    const ::google::protobuf::Timestamp &t,
+    const std::string &type_url,
+    std::string_view msg_bytes,
+    const ::google::protobuf::FileDescriptorSet *fds=nullptr,
+    const ::google::protobuf::Descriptor *descriptor=nullptr);
+
   // Explicitly close this session, which writes an index, flushes all data,
-  // to disk, and invalidates this WriteSession.
-  void Close();
+  // to disk, and invalidates this WriteSession.  Returns the first error
+  // from starting a new bag, writing the index or finishing any bag; the
+  // destructor also closes the session but can't report errors.
+  OkOrErr Close();
+
+  // Paths of the bags this session has written so far, including the
+  // current one (more than one only if splitting)
+  const std::vector<std::string> &GetBagPaths() const { return _bag_paths; }
+
+  // Path of bag number `bag` of a split session writing to `path`, e.g.
+  // "drive.zip" -> "drive.0002.zip"
+  static std::string GetSplitPath(const std::string &path, size_t bag);
 
 protected:
   Spec _spec;
   archive::Archive::Ptr _archive;
   BagIndexBuilder::UPtr _indexer;
+
+  // When appending, the stamp of the bag's existing index
+  std::optional<::google::protobuf::Timestamp> _existing_index_stamp;
+
+  // State for split output.  The next bag's archive is opened in the
+  // background while we write the current one, and finished bags have
+  // their index written and get closed in the background.
+  std::vector<std::string> _bag_paths;
+  size_t _bag_bytes = 0;
+  std::optional<::google::protobuf::Timestamp> _bag_start;
+  std::future<Result<archive::Archive::Ptr>> _next_archive;
+  std::future<OkOrErr> _finishing;
+  OkOrErr _split_status = kOK; // A failed split fails all later writes
+
+  void OpenNextInBackground();
+  OkOrErr Split();
+
+  // Write `data` to `entryname` in the current bag (after starting a new
+  // bag, if due); `t` is the entry's stamp, if any
+  OkOrErr WriteToBag(
+    const std::string &entryname,
+    const std::string &data,
+    const ::google::protobuf::Timestamp *t);
+
+  // Write `framed` (a serialized Any) and index it as a StampedMessage
+  OkOrErr WriteStampedFramed(
+    const std::string &framed,
+    const std::string &topic,
+    const ::google::protobuf::Timestamp &t,
+    const std::string &type_url,
+    const ::google::protobuf::FileDescriptorSet *fds,
+    const ::google::protobuf::Descriptor *descriptor);
 };
 
 } /* namespace protobag */
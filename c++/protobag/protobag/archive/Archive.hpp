@@ -36,13 +36,15 @@ std::string InferFormat(const std::string &path);
 class Archive {
 public:
   typedef std::shared_ptr<Archive> Ptr;
-  virtual ~Archive() { Close(); }
+  virtual ~Archive() { }
   
   // Opening an archive for reading / writing
   struct Spec {
     // clang-format off
     std::string mode;
-      // Choices: "read", "write" ("append" not yet tested / supported)
+      // Choices: "read", "write", "append" (write new entries after those
+      //   of an existing "zip", "directory" or "memory" archive.  NB: Don't
+      //   read a zip while appending to it.)
     std::string path;
       // A local path for the archive
       // Special values:
@@ -69,7 +71,12 @@ public:
     }
   };
   static Result<Ptr> Open(const Spec &s=Spec::WriteToTempdir());
-  virtual void Close() { }
+  
+  // Flush and finish writing (e.g. write a zip's central directory); further
+  // writes fail.  Implementations also finish writing in their destructors
+  // (e.g. the LibArchiveArchive writer and appender), but only an explicit
+  // `Close()` reports errors.
+  virtual OkOrErr Close() { return kOK; }
 
   // Reading ------------------------------------------------------------------
   virtual std::vector<std::string> GetNamelist() { return {}; }
@@ -79,11 +86,14 @@ public:
   // sometimes is an acceptable error) as well as "end of archive."  The
   // string value is the payload data read.
   struct ReadStatus : public Result<std::string> {
-    static ReadStatus EntryNotFound() { return Err("EntryNotFound"); }
-    bool IsEntryNotFound() const { return error == "EntryNotFound"; }
+    static ReadStatus EntryNotFound() {
+      return Err("EntryNotFound", ResultCode::kNotFound);
+    }
+    bool IsEntryNotFound() const { return Is(ResultCode::kNotFound); }
 
-    static ReadStatus Err(const std::string &s) {
-      ReadStatus st; st.error = s; return st;
+    static ReadStatus Err(
+        const std::string &s, ResultCode c = ResultCode::kError) {
+      ReadStatus st; st.error = s; st.code = c; return st;
     }
 
     static ReadStatus OK(std::string &&s) {
@@ -91,7 +101,8 @@ public:
     }
 
     bool operator==(const ReadStatus &other) const {
-      return error == other.error && value == other.value;
+      return 
+        code == other.code && error == other.error && value == other.value;
     }
   };
 
@@ -99,7 +110,35 @@ public:
     return ReadStatus::Err("Reading unsupported in base");
   }
 
-  // TODO: bulk reads of several entries, probably be faster
+  // Read several entries at once; returns a ReadStatus for each of
+  // `entrynames` (in the same order).  Archives that must scan to find an
+  // entry (e.g. LibArchiveArchive) read all entries in a single pass, so
+  // this is much faster than calling ReadAsStr() for each.
+  virtual std::vector<ReadStatus> ReadMany(
+      const std::vector<std::string> &entrynames) {
+    std::vector<ReadStatus> results;
+    results.reserve(entrynames.size());
+    for (const auto &entryname : entrynames) {
+      results.push_back(ReadAsStr(entryname));
+    }
+    return results;
+  }
+
+  // Reads entries one at a time, e.g. for a scan that must not hold all of
+  // its entries in memory.  Archives that must scan to find an entry (e.g.
+  // LibArchiveArchive) keep a single forward pass open across reads and
+  // only start a new pass when asked for an entry behind the current one,
+  // so reading entries in archive order costs one pass in total.  Other
+  // archives simply read each entry directly.  NB: A SequentialReader must
+  // not outlive its Archive.
+  class SequentialReader {
+  public:
+    virtual ~SequentialReader() { }
+    virtual ReadStatus Read(const std::string &entryname) = 0;
+  };
+  virtual std::unique_ptr<SequentialReader> OpenSequentialReader() {
+    return std::unique_ptr<SequentialReader>(new DirectReader(*this));
+  }
 
 
   // Writing ------------------------------------------------------------------
@@ -113,6 +152,16 @@ public:
   virtual std::string ToString() const { return "Base"; }
 
 protected:
+  class DirectReader final : public SequentialReader {
+  public:
+    explicit DirectReader(Archive &archive) : _archive(archive) { }
+    ReadStatus Read(const std::string &entryname) override {
+      return _archive.ReadAsStr(entryname);
+    }
+  private:
+    Archive &_archive;
+  };
+
   Archive() { }
   Archive(const Archive&) = delete;
   Archive& operator=(const Archive&) = delete;
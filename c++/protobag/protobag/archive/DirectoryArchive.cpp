@@ -48,6 +48,11 @@ Result<Archive::Ptr> DirectoryArchive::Open(Archive::Spec s) {
 
     return {.error = fmt::format("Can't find directory to read {}", s.path)};
   
+  } else if (s.mode == "append" && !fs::is_directory(s.path)) {
+
+    return {.error = 
+      fmt::format("Can't find directory to append to {}", s.path)};
+
   } else if (s.mode == "write" && s.path == "<tempfile>") {
 
     auto maybe_path = CreateTempdir(/*suffix=*/"_DirectoryArchive");
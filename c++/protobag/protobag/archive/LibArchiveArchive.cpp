@@ -16,10 +16,14 @@ limitations under the License.
 
 #include "protobag/archive/LibArchiveArchive.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <filesystem>
 #include <fstream>
+#include <optional>
 #include <stdexcept>
+#include <unordered_map>
 
 #include <archive.h>
 #include <archive_entry.h>
@@ -88,6 +92,14 @@ protected:
 };
 
 
+namespace {
+std::atomic<size_t> g_num_read_passes(0);
+} // anon namespace
+
+size_t LibArchiveArchive::GetNumReadPasses() {
+  return g_num_read_passes;
+}
+
 class Reader : public LibArchiveArchive::ImplBase {
 public:
 
@@ -97,6 +109,7 @@ public:
     }
 
     _is_reading = true;
+    ++g_num_read_passes;
 
     try {
     
@@ -170,6 +183,54 @@ public:
     return result;
   }
 
+  std::vector<Archive::ReadStatus> ReadMany(
+      const std::vector<std::string> &entrynames) {
+
+    std::vector<Archive::ReadStatus> results(
+      entrynames.size(), Archive::ReadStatus::EntryNotFound());
+    if (!_archive) {
+      std::fill(
+        results.begin(), results.end(),
+        Archive::ReadStatus::Err("Archive not open for reading"));
+      return results;
+    }
+
+    std::unordered_map<std::string, std::vector<size_t>> name_to_indices;
+    for (size_t i = 0; i < entrynames.size(); ++i) {
+      name_to_indices[entrynames[i]].push_back(i);
+    }
+
+    // Read everything in a single forward pass
+    archive_entry *entry = nullptr;
+    size_t n_remaining = name_to_indices.size();
+    while (
+        n_remaining > 0 &&
+        archive_read_next_header(_archive, &entry) == ARCHIVE_OK) {
+
+      auto it = name_to_indices.find(archive_entry_pathname_utf8(entry));
+      if (it != name_to_indices.end()) {
+        Archive::ReadStatus status = ReadEntry(entry);
+        for (size_t i : it->second) {
+          results[i] = status;
+        }
+        name_to_indices.erase(it);
+        --n_remaining;
+      } else {
+        std::string maybe_err = CheckOrError(archive_read_data_skip(_archive));
+        if (!maybe_err.empty()) {
+          for (const auto &name_indices : name_to_indices) {
+            for (size_t i : name_indices.second) {
+              results[i] = Archive::ReadStatus::Err(maybe_err);
+            }
+          }
+          break;
+        }
+      }
+    }
+
+    return results;
+  }
+
   OkOrErr StreamingUnpackEntryTo(
             const std::string &entryname,
             const std::string &dest_dir) {
@@ -304,6 +365,264 @@ protected:
 };
 
 
+// ============================================================================
+// Zip Central Directory Utils
+// For appending to zips, which libarchive does not support.  See
+// https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+
+namespace {
+
+static const uint32_t kZipCDHeaderSig = 0x02014b50;
+static const uint32_t kZipEndSig = 0x06054b50;
+static const uint32_t kZip64EndSig = 0x06064b50;
+static const uint32_t kZip64EndLocatorSig = 0x07064b50;
+static const uint16_t kZip64ExtraID = 0x0001;
+static const uint32_t kZipMax32 = 0xFFFFFFFF;
+static const uint16_t kZipMax16 = 0xFFFF;
+
+template <typename T>
+T GetLE(const char *p) {
+  T v = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    v |= T(uint8_t(p[i])) << (8 * i);
+  }
+  return v;
+}
+
+template <typename T>
+void PutLE(char *p, T v) {
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    p[i] = char((v >> (8 * i)) & 0xFF);
+  }
+}
+
+template <typename T>
+void AppendLE(std::string &s, T v) {
+  s.resize(s.size() + sizeof(T));
+  PutLE<T>(&s[s.size() - sizeof(T)], v);
+}
+
+Result<std::string> ReadBytes(std::FILE *f, uint64_t offset, uint64_t size) {
+  std::string buf(size, '\0');
+  if (std::fseek(f, long(offset), SEEK_SET) != 0 ||
+        std::fread(buf.data(), 1, size, f) != size) {
+    return {.error = fmt::format(
+      "Could not read {} bytes at offset {}", size, offset)
+    };
+  }
+  return {.value = std::move(buf)};
+}
+
+// Where to find the central directory of a zip, per its end records
+struct ZipEnd {
+  uint64_t n_entries = 0;
+  uint64_t cd_size = 0;
+  uint64_t cd_offset = 0;
+};
+
+// Read the end records (including any Zip64 end records) of the zip that
+// occupies bytes [begin, end) of `f`.  Offsets are relative to `begin`.
+Result<ZipEnd> ReadZipEnd(std::FILE *f, uint64_t begin, uint64_t end) {
+  static const uint64_t kEndSize = 22;
+  static const uint64_t kLocatorSize = 20;
+  static const uint64_t kZip64EndSize = 56;
+
+  // The end record is followed by a comment of up to 64KB
+  const uint64_t tail_begin = 
+    std::max(begin, end > kEndSize + kZipMax16 ? end - kEndSize - kZipMax16 : 0);
+  auto maybe_tail = ReadBytes(f, tail_begin, end - tail_begin);
+  if (!maybe_tail.IsOk()) {
+    return {.error = maybe_tail.error};
+  }
+  const std::string &tail = *maybe_tail.value;
+  if (tail.size() < kEndSize) {
+    return {.error = "Too small to be a zip"};
+  }
+
+  std::optional<size_t> end_pos;
+  for (size_t i = tail.size() - kEndSize + 1; i-- > 0; ) {
+    const char *p = tail.data() + i;
+    if (GetLE<uint32_t>(p) == kZipEndSig &&
+          i + kEndSize + GetLE<uint16_t>(p + 20) == tail.size()) {
+      end_pos = i;
+      break;
+    }
+  }
+  if (!end_pos.has_value()) {
+    return {.error = "Could not find the end of the zip central directory"};
+  }
+
+  const char *p = tail.data() + *end_pos;
+  ZipEnd z = {
+    .n_entries = GetLE<uint16_t>(p + 10),
+    .cd_size = GetLE<uint32_t>(p + 12),
+    .cd_offset = GetLE<uint32_t>(p + 16),
+  };
+  if (z.n_entries == kZipMax16 || 
+        z.cd_size == kZipMax32 || 
+        z.cd_offset == kZipMax32) {
+
+    // Zip64: the real values are in the Zip64 end record
+    const uint64_t abs_end_pos = tail_begin + *end_pos;
+    if (abs_end_pos < begin + kLocatorSize) {
+      return {.error = "Zip64 end locator is missing"};
+    }
+    auto maybe_locator = ReadBytes(f, abs_end_pos - kLocatorSize, kLocatorSize);
+    if (!maybe_locator.IsOk()) {
+      return {.error = maybe_locator.error};
+    }
+    const char *loc = maybe_locator.value->data();
+    if (GetLE<uint32_t>(loc) != kZip64EndLocatorSig) {
+      return {.error = "Zip64 end locator is missing"};
+    }
+
+    auto maybe_rec = ReadBytes(
+      f, begin + GetLE<uint64_t>(loc + 8), kZip64EndSize);
+    if (!maybe_rec.IsOk()) {
+      return {.error = maybe_rec.error};
+    }
+    const char *rec = maybe_rec.value->data();
+    if (GetLE<uint32_t>(rec) != kZip64EndSig) {
+      return {.error = "Zip64 end record is missing"};
+    }
+    z.n_entries = GetLE<uint64_t>(rec + 32);
+    z.cd_size = GetLE<uint64_t>(rec + 40);
+    z.cd_offset = GetLE<uint64_t>(rec + 48);
+  }
+  return {.value = z};
+}
+
+// Encode end records for a central directory (using Zip64 records only if
+// needed)
+std::string EncodeZipEnd(
+    uint64_t n_entries, uint64_t cd_size, uint64_t cd_offset) {
+
+  std::string out;
+  if (n_entries >= kZipMax16 || 
+        cd_size >= kZipMax32 || 
+        cd_offset >= kZipMax32) {
+
+    const uint64_t zip64_end_offset = cd_offset + cd_size;
+    AppendLE<uint32_t>(out, kZip64EndSig);
+    AppendLE<uint64_t>(out, 44); // Size of the rest of this record
+    AppendLE<uint16_t>(out, 45); // Version made by
+    AppendLE<uint16_t>(out, 45); // Version needed
+    AppendLE<uint32_t>(out, 0);  // This disk
+    AppendLE<uint32_t>(out, 0);  // Disk with the central directory
+    AppendLE<uint64_t>(out, n_entries); // ... on this disk
+    AppendLE<uint64_t>(out, n_entries); // ... in total
+    AppendLE<uint64_t>(out, cd_size);
+    AppendLE<uint64_t>(out, cd_offset);
+
+    AppendLE<uint32_t>(out, kZip64EndLocatorSig);
+    AppendLE<uint32_t>(out, 0);
+    AppendLE<uint64_t>(out, zip64_end_offset);
+    AppendLE<uint32_t>(out, 1);  // Total disks
+  }
+
+  AppendLE<uint32_t>(out, kZipEndSig);
+  AppendLE<uint16_t>(out, 0);
+  AppendLE<uint16_t>(out, 0);
+  AppendLE<uint16_t>(out, uint16_t(std::min<uint64_t>(n_entries, kZipMax16)));
+  AppendLE<uint16_t>(out, uint16_t(std::min<uint64_t>(n_entries, kZipMax16)));
+  AppendLE<uint32_t>(out, uint32_t(std::min<uint64_t>(cd_size, kZipMax32)));
+  AppendLE<uint32_t>(out, uint32_t(std::min<uint64_t>(cd_offset, kZipMax32)));
+  AppendLE<uint16_t>(out, 0);  // Comment length
+  return out;
+}
+
+// Add `base` to the local header offset of each of the `n_entries` file
+// headers in central directory `cd`, moving offsets that no longer fit in
+// 32 bits into Zip64 extra fields
+Result<std::string> RebaseCentralDirectory(
+    const std::string &cd, uint64_t n_entries, uint64_t base) {
+
+  static const size_t kHeaderSize = 46;
+  std::string out;
+  out.reserve(cd.size());
+  size_t pos = 0;
+  for (uint64_t e = 0; e < n_entries; ++e) {
+    if (pos + kHeaderSize > cd.size() || 
+          GetLE<uint32_t>(cd.data() + pos) != kZipCDHeaderSig) {
+      return {.error = "Corrupt zip central directory"};
+    }
+    const char *h = cd.data() + pos;
+    const size_t name_len = GetLE<uint16_t>(h + 28);
+    const size_t extra_len = GetLE<uint16_t>(h + 30);
+    const size_t comment_len = GetLE<uint16_t>(h + 32);
+    if (pos + kHeaderSize + name_len + extra_len + comment_len > cd.size()) {
+      return {.error = "Corrupt zip central directory"};
+    }
+
+    std::string header(h, kHeaderSize);
+    std::string name(h + kHeaderSize, name_len);
+    std::string extra(h + kHeaderSize + name_len, extra_len);
+    std::string comment(h + kHeaderSize + name_len + extra_len, comment_len);
+    pos += kHeaderSize + name_len + extra_len + comment_len;
+
+    // The Zip64 extra field holds (in order) whichever of the uncompressed
+    // size, compressed size and offset don't fit in their 32-bit fields
+    const bool big_uncompressed = GetLE<uint32_t>(h + 24) == kZipMax32;
+    const bool big_compressed = GetLE<uint32_t>(h + 20) == kZipMax32;
+    const bool big_offset = GetLE<uint32_t>(h + 42) == kZipMax32;
+    std::optional<size_t> zip64_pos;
+    for (size_t i = 0; i + 4 <= extra.size(); ) {
+      const size_t field_size = GetLE<uint16_t>(extra.data() + i + 2);
+      if (GetLE<uint16_t>(extra.data() + i) == kZip64ExtraID) {
+        zip64_pos = i;
+        break;
+      }
+      i += 4 + field_size;
+    }
+    const size_t offset_pos = 
+      (zip64_pos.has_value() ? *zip64_pos : extra.size()) + 4 +
+      (big_uncompressed ? 8 : 0) + (big_compressed ? 8 : 0);
+
+    if (big_offset) {
+      if (!zip64_pos.has_value() || offset_pos + 8 > extra.size()) {
+        return {.error = "Corrupt zip64 extra field"};
+      }
+      PutLE<uint64_t>(
+        &extra[offset_pos], GetLE<uint64_t>(&extra[offset_pos]) + base);
+    } else {
+      const uint64_t offset = GetLE<uint32_t>(h + 42) + base;
+      if (offset < kZipMax32) {
+        PutLE<uint32_t>(&header[42], uint32_t(offset));
+      } else {
+        // Move the offset to a (new) Zip64 extra field
+        if (!zip64_pos.has_value()) {
+          zip64_pos = extra.size();
+          AppendLE<uint16_t>(extra, kZip64ExtraID);
+          AppendLE<uint16_t>(extra, 0);
+        }
+        std::string offset_bytes;
+        AppendLE<uint64_t>(offset_bytes, offset);
+        extra.insert(offset_pos, offset_bytes);
+        PutLE<uint16_t>(
+          &extra[*zip64_pos + 2], 
+          GetLE<uint16_t>(&extra[*zip64_pos + 2]) + 8);
+        if (extra.size() > kZipMax16) {
+          return {.error = "Zip extra fields are too large"};
+        }
+
+        PutLE<uint32_t>(&header[42], kZipMax32);
+        PutLE<uint16_t>(&header[30], uint16_t(extra.size()));
+        PutLE<uint16_t>(
+          &header[6], std::max<uint16_t>(GetLE<uint16_t>(&header[6]), 45));
+      }
+    }
+
+    out += header;
+    out += name;
+    out += extra;
+    out += comment;
+  }
+  return {.value = std::move(out)};
+}
+
+} // anon namespace
+
+
 class Writer : public LibArchiveArchive::ImplBase {
 public:
 
@@ -414,6 +733,170 @@ public:
 
     return result;
   }
+
+  // Finish the archive (e.g. write a zip's central directory)
+  virtual OkOrErr Finish() {
+    if (!_archive) { return kOK; }
+    
+    std::string error = CheckOrError(archive_write_close(_archive));
+    archive_write_free(_archive);
+    _archive = nullptr;
+    if (!error.empty()) {
+      return {.error = error};
+    }
+    return kOK;
+  }
+};
+
+// Appends entries to an existing zip.  We have libarchive write the new
+// entries (and its own central directory) over the zip's central directory,
+// and then replace libarchive's central directory with one that lists the
+// existing entries followed by the new ones.  Thus appending costs time
+// in proportion to the new data (plus the central directory) rather than
+// to the size of the zip.
+class ZipAppender final : public Writer {
+public:
+  ~ZipAppender() override {
+    // NB: errors are only reported by an explicit `Close()`
+    Finish();
+  }
+
+  OkOrErr Open(Archive::Spec s) {
+    if (_archive || _file) {
+      return {.error = "Programming error: archive already open"};
+    }
+
+    _is_reading = false;
+    _path = s.path;
+    _file = std::fopen(_path.c_str(), "r+b");
+    if (!_file) {
+      return {.error = fmt::format("Can't open {} to append", _path)};
+    }
+
+    OkOrErr r = Start();
+    if (!r.IsOk()) {
+      // Leave the zip untouched
+      if (_archive) {
+        archive_write_free(_archive);
+        _archive = nullptr;
+      }
+      std::fclose(_file);
+      _file = nullptr;
+    }
+    return r;
+  }
+
+  OkOrErr Finish() override {
+    if (!_file) { return kOK; }
+
+    // Finishing libarchive's output only writes its central directory,
+    // which we replace anyway, but a failure means new entries may be bad
+    OkOrErr status = Writer::Finish();
+    if (!status.IsOk()) {
+      std::fclose(_file);
+      _file = nullptr;
+      return status;
+    }
+    std::fflush(_file);
+
+    auto maybe_size = WriteCentralDirectory();
+    std::fclose(_file);
+    _file = nullptr;
+    if (!maybe_size.IsOk()) {
+      return {.error = maybe_size.error};
+    }
+
+    std::error_code ec;
+    fs::resize_file(_path, *maybe_size.value, ec);
+    if (ec) {
+      return {.error = fmt::format("Failed to resize {}: {}", _path, ec.message())};
+    }
+    return kOK;
+  }
+
+protected:
+  std::string _path;
+  std::FILE *_file = nullptr;
+
+  // Where the new entries begin (where the existing central directory
+  // began)
+  uint64_t _base = 0;
+
+  uint64_t _n_existing = 0;
+  std::string _existing_cd;
+
+  // Read the existing central directory and have libarchive write from
+  // where it begins
+  OkOrErr Start() {
+    std::fseek(_file, 0, SEEK_END);
+    const uint64_t size = uint64_t(std::ftell(_file));
+    auto maybe_end = ReadZipEnd(_file, 0, size);
+    if (!maybe_end.IsOk()) {
+      return {.error = fmt::format(
+        "Can't append to {}: {}", _path, maybe_end.error)
+      };
+    }
+    const ZipEnd &end = *maybe_end.value;
+    auto maybe_cd = ReadBytes(_file, end.cd_offset, end.cd_size);
+    if (!maybe_cd.IsOk()) {
+      return {.error = fmt::format(
+        "Can't append to {}: {}", _path, maybe_cd.error)
+      };
+    }
+    _base = end.cd_offset;
+    _n_existing = end.n_entries;
+    _existing_cd = std::move(*maybe_cd.value);
+
+    try {
+
+      std::fseek(_file, long(_base), SEEK_SET);
+      _archive = archive_write_new();
+      CheckOrThrow(archive_write_set_format_zip(_archive));
+      CheckOrThrow(archive_write_set_bytes_in_last_block(_archive, 1));
+      CheckOrThrow(archive_write_open_FILE(_archive, _file));
+
+    } catch (std::exception &e) {
+      return OkOrErr::Err(
+        fmt::format("Error while trying to open for appending: {}", e.what()));
+    }
+
+    return kOK;
+  }
+
+  // Replace the central directory that libarchive wrote with the merged
+  // one; returns the final size of the zip
+  Result<uint64_t> WriteCentralDirectory() {
+    const uint64_t end = uint64_t(std::ftell(_file));
+    auto maybe_new_end = ReadZipEnd(_file, _base, end);
+    if (!maybe_new_end.IsOk()) {
+      return {.error = maybe_new_end.error};
+    }
+    const ZipEnd &new_end = *maybe_new_end.value;
+    const uint64_t cd_offset = _base + new_end.cd_offset;
+
+    auto maybe_new_cd = ReadBytes(_file, cd_offset, new_end.cd_size);
+    if (!maybe_new_cd.IsOk()) {
+      return {.error = maybe_new_cd.error};
+    }
+    auto maybe_rebased = RebaseCentralDirectory(
+      *maybe_new_cd.value, new_end.n_entries, _base);
+    if (!maybe_rebased.IsOk()) {
+      return {.error = maybe_rebased.error};
+    }
+
+    std::string tail = std::move(_existing_cd);
+    tail += *maybe_rebased.value;
+    tail += EncodeZipEnd(
+      _n_existing + new_end.n_entries, tail.size(), cd_offset);
+    if (std::fseek(_file, long(cd_offset), SEEK_SET) != 0 ||
+          std::fwrite(tail.data(), 1, tail.size(), _file) != tail.size() ||
+          std::fflush(_file) != 0) {
+      return {.error = fmt::format(
+        "Failed to write central directory to {}", _path)
+      };
+    }
+    return {.value = cd_offset + tail.size()};
+  }
 };
 
 Result<Archive::Ptr> LibArchiveArchive::Open(Archive::Spec s) {
@@ -447,15 +930,45 @@ Result<Archive::Ptr> LibArchiveArchive::Open(Archive::Spec s) {
     OkOrErr r = w.Open(lar->_spec);
     if (!r.IsOk()) { return {.error = r.error}; }
     lar->_impl = pi;
-    
-    // TODO: consider supporting append mode 
-    // https://groups.google.com/forum/#!msg/libarchive-discuss/dEqPZbnimVM/97Gp1LgWf7UJ 
+
+  } else if (lar->_spec.mode == "append") {
+
+    if (lar->_spec.format != "zip") {
+      return {.error = fmt::format(
+        "Append mode is not supported for {} archives", lar->_spec.format)
+      };
+    }
+    if (!fs::is_regular_file(lar->_spec.path)) {
+      return {.error = fmt::format(
+        "Can't find archive to append to {}", lar->_spec.path)
+      };
+    }
+
+    ZipAppender *pa = new ZipAppender();
+    std::shared_ptr<ImplBase> pi(pa);
+    OkOrErr r = pa->Open(lar->_spec);
+    if (!r.IsOk()) { return {.error = r.error}; }
+    lar->_impl = pi;
 
   }
 
   return {.value = p};
 }
 
+OkOrErr LibArchiveArchive::Close() {
+  auto writer = std::dynamic_pointer_cast<Writer>(_impl);
+  _impl.reset();
+  if (writer) {
+    OkOrErr status = writer->Finish();
+    if (!status.IsOk()) {
+      return {.error = fmt::format(
+        "Failed to finish writing {}: {}", GetSpec().path, status.error)
+      };
+    }
+  }
+  return kOK;
+}
+
 std::vector<std::string> LibArchiveArchive::GetNamelist() {
   Reader reader;
   OkOrErr r = reader.Open(GetSpec());
@@ -476,6 +989,53 @@ Archive::ReadStatus LibArchiveArchive::ReadAsStr(const std::string &entryname) {
   return reader.ReadAsStr(entryname);
 }
 
+std::vector<Archive::ReadStatus> LibArchiveArchive::ReadMany(
+    const std::vector<std::string> &entrynames) {
+
+  Reader reader;
+  OkOrErr r = reader.Open(GetSpec());
+  if (!r.IsOk()) {
+    return std::vector<Archive::ReadStatus>(
+      entrynames.size(), Archive::ReadStatus::Err(r.error));
+  }
+
+  return reader.ReadMany(entrynames);
+}
+
+// Keeps one Reader open across reads and continues its forward pass for
+// each entry, starting a new pass only if the entry is not ahead
+class PassReader final : public Archive::SequentialReader {
+public:
+  explicit PassReader(const Archive::Spec &spec) : _spec(spec) { }
+
+  Archive::ReadStatus Read(const std::string &entryname) override {
+    if (_reader) {
+      auto status = _reader->ReadAsStr(entryname);
+      if (!status.IsEntryNotFound()) {
+        return status;
+      }
+    }
+
+    // The entry is behind us (or missing), so start a new pass
+    _reader.reset(new Reader());
+    OkOrErr r = _reader->Open(_spec);
+    if (!r.IsOk()) {
+      _reader.reset();
+      return Archive::ReadStatus::Err(r.error);
+    }
+    return _reader->ReadAsStr(entryname);
+  }
+
+protected:
+  Archive::Spec _spec;
+  std::unique_ptr<Reader> _reader;
+};
+
+std::unique_ptr<Archive::SequentialReader> 
+LibArchiveArchive::OpenSequentialReader() {
+  return std::unique_ptr<Archive::SequentialReader>(new PassReader(GetSpec()));
+}
+
 OkOrErr LibArchiveArchive::Write(
     const std::string &entryname, const std::string &data) {
 
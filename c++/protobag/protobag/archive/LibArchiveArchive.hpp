@@ -38,16 +38,33 @@ public:
   
   virtual std::vector<std::string> GetNamelist() override;
   virtual Archive::ReadStatus ReadAsStr(const std::string &entryname) override;
+  virtual std::vector<Archive::ReadStatus> ReadMany(
+    const std::vector<std::string> &entrynames) override;
+  virtual std::unique_ptr<Archive::SequentialReader> 
+    OpenSequentialReader() override;
 
   virtual OkOrErr Write(
     const std::string &entryname, const std::string &data) override;
 
+  // Finish writing or appending.  NB: Appending to a zip overwrites its
+  // central directory, which is only rewritten (listing both old and new
+  // entries) on close; if the process dies first (or closing fails), the
+  // zip is left without a valid central directory.
+  virtual OkOrErr Close() override;
+
   virtual std::string ToString() const override { 
     return std::string("LibArchiveArchive: ") + GetSpec().path;
   }
 
 
   /// Additional Utils; see ArchiveUtil.hpp for public API
+
+  // Diagnostic counter: the number of passes over archives that all
+  // LibArchiveArchives in this process have started for reading so far.
+  // Each read of an entry that isn't ahead of an open pass (e.g. a
+  // `ReadAsStr()`) starts a new pass, so compare the counts before and after
+  // a read to check how many passes it takes.
+  static size_t GetNumReadPasses();
   
   // Unpack `entryname` to the directory at `dest_dir` (and create any needed
   // sub-directories).  Use a "streaming" write so the entry is never entirely
@@ -54,11 +54,13 @@ std::vector<std::string> MemoryArchive::GetNamelist() {
 Archive::ReadStatus MemoryArchive::ReadAsStr(const std::string &entryname) {
   const std::string &canon_entryname = CanonEntryname(entryname);
 
-  if (_archive_data.find(canon_entryname) == _archive_data.end()) {
+  // NB: Only look up (never insert) so that concurrent readers (e.g. the
+  // workers of `ParallelForEach()`) can share this archive
+  auto it = _archive_data.find(canon_entryname);
+  if (it == _archive_data.end()) {
     return Archive::ReadStatus::EntryNotFound();
   } else {
-    return Archive::ReadStatus::OK(
-      std::string(_archive_data[canon_entryname]));
+    return Archive::ReadStatus::OK(std::string(it->second));
   }
 }
 
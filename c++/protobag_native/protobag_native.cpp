@@ -14,16 +14,21 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 #include <exception>
+#include <mutex>
 #include <optional>
+#include <string_view>
+#include <tuple>
 
 #include <fmt/format.h>
 
 #include <google/protobuf/descriptor.h>
 
+#include <protobag/ColumnExtractor.hpp>
 #include <protobag/Protobag.hpp>
 #include <protobag/ReadSession.hpp>
 #include <protobag/WriteSession.hpp>
@@ -38,23 +43,37 @@ namespace py = pybind11;
 
 using namespace protobag;
 
+// Owns a message payload and exposes it to Python through the buffer
+// protocol, so Python can read it (e.g. via a memoryview) without a copy
+struct native_buffer final {
+  std::string data;
+
+  // Return a memoryview that keeps a new native_buffer holding `data` alive
+  static py::memoryview ToMemoryview(std::string &&data) {
+    py::object buffer = py::cast(native_buffer{.data = std::move(data)});
+    return py::memoryview(buffer);
+  }
+};
+
 // A convenience wrapper to avoid pybind conversion of Entry optional context
 struct native_entry final {
   std::string entryname;
   std::string type_url;
-  py::bytes msg_bytes;
+  py::object msg_bytes; // A memoryview of a native_buffer
 
   bool is_stamped = false;
   std::string topic;
-  int64_t sec;
-  int32_t nanos;
+  int64_t sec = 0;
+  int32_t nanos = 0;
 
   // NB: Don't need descriptor context on decode because python Protobag
   // handles the index directly.  FMI see `DynamicMessageFactory`.
   
-  static native_entry FromEntry(const Entry &entry) {
+  // Create from `entry`, moving its payload.  Expects stamped entries to
+  // have been unpacked already (i.e. by a ReadSession with
+  // `unpack_stamped_messages`), but unpacks any that are still packed.
+  static native_entry FromEntry(Entry &&entry) {
     if (entry.IsStampedMessage()) {
-
       auto maybe_unpacked = entry.UnpackFromStamped();
       if (!maybe_unpacked.IsOk()) {
         throw std::runtime_error(fmt::format(
@@ -62,41 +81,76 @@ struct native_entry final {
           entry.entryname,
           maybe_unpacked.error));
       }
+      return FromEntry(std::move(*maybe_unpacked.value));
+    }
 
-      if (!maybe_unpacked.value->ctx.has_value()) {
-        throw std::runtime_error(fmt::format(
-          "Incorrect unpacking for stamped entry for entry {}",
-          entry.entryname));
-      }
-
-      const Entry &unpacked = *maybe_unpacked.value;
-      return {
-        .entryname = entry.entryname,
-        .type_url = unpacked.ctx->inner_type_url,
-        .msg_bytes = unpacked.msg.value(),
-        
-        .is_stamped = true,
-        .topic = unpacked.ctx->topic,
-        .sec = unpacked.ctx->stamp.seconds(),
-        .nanos = unpacked.ctx->stamp.nanos(),
-      };
-
-    } else {
-
-      return {
-        .entryname = entry.entryname,
-        .type_url = entry.msg.type_url(),
-        .msg_bytes = entry.msg.value(),
-      };
+    native_entry nentry;
+    nentry.entryname = std::move(entry.entryname);
+    nentry.type_url = entry.msg.type_url();
+    nentry.msg_bytes = native_buffer::ToMemoryview(
+      std::move(*entry.msg.mutable_value()));
+    if (entry.ctx.has_value()) {
+      nentry.is_stamped = true;
+      nentry.topic = std::move(entry.ctx->topic);
+      nentry.sec = entry.ctx->stamp.seconds();
+      nentry.nanos = entry.ctx->stamp.nanos();
     }
+    return nentry;
   }
 };
 
 
 
+// A field predicate given from Python as (field_path, op, value), where
+// `value` is a number, a string, or (for "between") a (lower, upper) pair
+typedef std::tuple<std::string, std::string, py::object> py_predicate;
+
+// Python ints become integer operands (so that they compare exactly with
+// int64 / uint64 fields); other numbers become doubles
+inline FieldPredicate::Number ToNumber(const py::object &o) {
+  if (py::isinstance<py::int_>(o)) {
+    try {
+      return o.cast<int64_t>();
+    } catch (const py::cast_error &) {
+      return o.cast<uint64_t>();
+    }
+  }
+  return o.cast<double>();
+}
+
+inline FieldPredicate ToFieldPredicate(const py_predicate &p) {
+  const auto &[field_path, op_str, value] = p;
+  auto maybe_op = FieldPredicate::OpFromString(op_str);
+  if (!maybe_op.IsOk()) {
+    throw std::invalid_argument(maybe_op.error);
+  }
+
+  FieldPredicate pred;
+  pred.field_path = field_path;
+  pred.op = *maybe_op.value;
+  if (pred.op == FieldPredicate::Op::BETWEEN) {
+    auto bounds = value.cast<std::pair<py::object, py::object>>();
+    pred.value = ToNumber(bounds.first);
+    pred.upper = ToNumber(bounds.second);
+  } else if (py::isinstance<py::str>(value)) {
+    pred.str_value = value.cast<std::string>();
+  } else {
+    pred.value = ToNumber(value);
+  }
+  return pred;
+}
+
 class PyReader final {
 public:
-  void Start(const std::string &path, const std::string &sel_pb_bytes) {
+  void Start(
+      const std::string &path,
+      const std::string &sel_pb_bytes,
+      const std::vector<py_predicate> &predicates,
+      size_t shard_index,
+      size_t num_shards,
+      const std::optional<ReadShuffleSpec> &shuffle,
+      const std::string &resume_cursor) {
+
     auto maybe_sel = PBFactory::LoadFromContainer<Selection>(sel_pb_bytes);
     if (!maybe_sel.IsOk()) {
       throw std::invalid_argument(
@@ -106,6 +160,11 @@ public:
           maybe_sel.error));
     }
 
+    std::vector<FieldPredicate> field_predicates;
+    for (const auto &p : predicates) {
+      field_predicates.push_back(ToFieldPredicate(p));
+    }
+
     const Selection &sel = *maybe_sel.value;
     auto maybe_rp = ReadSession::Create({
       .archive_spec = {
@@ -113,23 +172,32 @@ public:
         .mode = "read",
       },
       .selection = sel,
+      .unpack_stamped_messages = true,
+      .predicates = field_predicates,
+      .shard_index = shard_index,
+      .num_shards = num_shards,
+      .shuffle = shuffle,
+      .resume_cursor = resume_cursor,
+      .use_arena = true,
     });
     if (!maybe_rp.IsOk()) {
       throw std::runtime_error(
         fmt::format("Failed to start reader: {}", maybe_rp.error));
     }
 
+    std::lock_guard<std::mutex> lock(_mutex);
     _read_sess = *maybe_rp.value;
+    _finished = false;
   }
 
   std::optional<native_entry> GetNext() {
-    if (!_read_sess) {
-      throw std::runtime_error("Invalid read session");
+    MaybeEntry maybe_entry;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      maybe_entry = ReadNext();
     }
-    auto &reader = *_read_sess;
 
-    auto maybe_entry = reader.GetNext();
-    if (maybe_entry.IsEndOfSequence() || maybe_entry.IsNotFound()) {
+    if (maybe_entry.IsEndOfSequence()) {
       // NB: We use this exception instead of pybind11::stop_iteration due
       // to a bug in pybind related to libc++.  FMI see:
       // * https://gitter.im/pybind/Lobby?at=5f18cfc9361e295cf01fd21a
@@ -141,7 +209,55 @@ public:
       throw std::runtime_error(maybe_entry.error);
     }
 
-    return native_entry::FromEntry(*maybe_entry.value);
+    return native_entry::FromEntry(std::move(*maybe_entry.value));
+  }
+
+  // Read up to `n` entries with the GIL released, then convert them all at
+  // once.  Returns an empty list at the end of the sequence.
+  std::vector<native_entry> GetNextBatch(size_t n) {
+    std::vector<Entry> entries;
+    entries.reserve(n);
+    std::string error;
+    {
+      // NB: Take the lock only after releasing the GIL (and drop it before
+      // re-acquiring the GIL) so that a thread blocked in GetNext() while
+      // holding the GIL can't deadlock with us
+      py::gil_scoped_release release;
+      std::lock_guard<std::mutex> lock(_mutex);
+      while (entries.size() < n && error.empty()) {
+        auto maybe_entry = ReadNext();
+        if (maybe_entry.IsEndOfSequence()) {
+          break;
+        } else if (!maybe_entry.IsOk()) {
+          error = maybe_entry.error;
+        } else {
+          entries.push_back(std::move(*maybe_entry.value));
+        }
+      }
+    }
+    if (!error.empty()) {
+      throw std::runtime_error(error);
+    }
+
+    std::vector<native_entry> nentries;
+    nentries.reserve(entries.size());
+    for (auto &entry : entries) {
+      nentries.push_back(native_entry::FromEntry(std::move(entry)));
+    }
+    return nentries;
+  }
+
+  py::bytes GetCursor() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_read_sess) {
+      throw std::runtime_error("Invalid read session");
+    }
+    auto maybe_cursor = _read_sess->GetCursor();
+    if (!maybe_cursor.IsOk()) {
+      throw std::runtime_error(
+        fmt::format("Failed to get cursor: {}", maybe_cursor.error));
+    }
+    return *maybe_cursor.value;
   }
 
   static py::bytes GetIndex(const std::string &path) {
@@ -174,10 +290,38 @@ public:
     return *maybe_topics.value;
   }
 
-  ReadSession::Ptr GetSession() const { return _read_sess; }
+  ReadSession::Ptr GetSession() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _read_sess;
+  }
 
 protected:
   ReadSession::Ptr _read_sess;
+
+  // GetNextBatch() reads with the GIL released, so the GIL no longer
+  // serializes Python threads sharing this reader; this lock does
+  mutable std::mutex _mutex;
+
+  // Set once the session ends; a missing entry ends the sequence (as it
+  // always has for get_next()) for both the single and batched reads
+  bool _finished = false;
+
+  // Call with `_mutex` held
+  MaybeEntry ReadNext() {
+    if (!_read_sess) {
+      throw std::runtime_error("Invalid read session");
+    }
+    if (_finished) {
+      return MaybeEntry::EndOfSequence();
+    }
+
+    auto maybe_entry = _read_sess->GetNext();
+    if (maybe_entry.IsEndOfSequence() || maybe_entry.IsNotFound()) {
+      _finished = true;
+      return MaybeEntry::EndOfSequence();
+    }
+    return maybe_entry;
+  }
 };
 
 
@@ -204,8 +348,8 @@ public:
     }
 
     std::list<native_entry> nbundle;
-    for (const auto &entry : *next.value) {
-      nbundle.push_back(native_entry::FromEntry(entry));
+    for (auto &entry : *next.value) {
+      nbundle.push_back(native_entry::FromEntry(std::move(entry)));
     }
     return nbundle;
   }
@@ -218,7 +362,8 @@ class PyMaxSlopTimeSync : public PyTimeSyncBase {
 public:
   void Start(
     const PyReader &reader,
-    const MaxSlopTimeSync::Spec &spec) {
+    const MaxSlopTimeSync::Spec &spec,
+    bool plan_from_index) {
 
       auto read_sess = reader.GetSession();
       if (!read_sess) {
@@ -226,7 +371,10 @@ public:
       }
 
       _spec = spec;
-      auto maybe_sync = MaxSlopTimeSync::Create(read_sess, spec);
+      auto maybe_sync = 
+        plan_from_index ?
+          IndexedMaxSlopTimeSync::Create(read_sess, spec) :
+          MaxSlopTimeSync::Create(read_sess, spec);
       if (!maybe_sync.IsOk()) {
         throw std::runtime_error(fmt::format(
           "Failed to create MaxSlopTimeSync: {}", maybe_sync.error));
@@ -241,12 +389,115 @@ protected:
   MaxSlopTimeSync::Spec _spec;
 };
 
+class PyFixedRateTimeSync : public PyTimeSyncBase {
+public:
+  void Start(
+    const PyReader &reader,
+    const FixedRateTimeSync::Spec &spec) {
+
+      auto read_sess = reader.GetSession();
+      if (!read_sess) {
+        throw std::runtime_error("Invalid read session");
+      }
+
+      _spec = spec;
+      auto maybe_sync = FixedRateTimeSync::Create(read_sess, spec);
+      if (!maybe_sync.IsOk()) {
+        throw std::runtime_error(fmt::format(
+          "Failed to create FixedRateTimeSync: {}", maybe_sync.error));
+      }
+
+      _sync = *maybe_sync.value;
+  }
+
+  FixedRateTimeSync::Spec GetSpec() const { return _spec; }
+
+protected:
+  FixedRateTimeSync::Spec _spec;
+};
+
+
+
+// Wrap `v` as a numpy array without copying; `owner` must own `v`
+template <typename T>
+py::array_t<T> AsNumpyArray(const std::vector<T> &v, const py::capsule &owner) {
+  return py::array_t<T>({v.size()}, {sizeof(T)}, v.data(), owner);
+}
+
+py::dict ExtractColumns(
+    const std::string &path,
+    const std::string &topic,
+    const std::vector<std::string> &field_paths,
+    size_t chunk_size,
+    size_t num_threads) {
+
+  Result<ExtractedColumns> maybe_columns;
+  {
+    py::gil_scoped_release release;
+    maybe_columns = ColumnExtractor::Extract({
+      .archive_spec = {
+        .mode = "read",
+        .path = path,
+      },
+      .topic = topic,
+      .field_paths = field_paths,
+      .chunk_size = chunk_size,
+      .num_threads = num_threads,
+    });
+  }
+  if (!maybe_columns.IsOk()) {
+    throw std::runtime_error(fmt::format(
+      "Failed to extract columns from {}: {}", path, maybe_columns.error));
+  }
+
+  // The returned numpy arrays share (and keep alive) these buffers
+  auto *columns = new ExtractedColumns(std::move(*maybe_columns.value));
+  py::capsule owner(columns, [](void *p) {
+    delete reinterpret_cast<ExtractedColumns *>(p);
+  });
+
+  py::dict values;
+  py::dict valid;
+  for (const ExtractedColumn &column : columns->columns) {
+    switch (column.type) {
+      case ExtractedColumn::Type::Double:
+        values[column.field_path.c_str()] = 
+          AsNumpyArray(column.doubles, owner);
+        break;
+      case ExtractedColumn::Type::Int64:
+        values[column.field_path.c_str()] = 
+          AsNumpyArray(column.int64s, owner);
+        break;
+      case ExtractedColumn::Type::String:
+        values[column.field_path.c_str()] = py::make_tuple(
+          py::array_t<uint8_t>(
+            {column.string_data.size()},
+            {sizeof(uint8_t)},
+            (const uint8_t *) column.string_data.data(),
+            owner),
+          AsNumpyArray(column.string_offsets, owner));
+        break;
+    }
+    valid[column.field_path.c_str()] = AsNumpyArray(column.valid, owner);
+  }
+
+  py::dict result;
+  result["topic"] = columns->topic;
+  result["type_url"] = columns->type_url;
+  result["timestamp_ns"] = AsNumpyArray(columns->timestamp_ns, owner);
+  result["values"] = values;
+  result["valid"] = valid;
+  return result;
+}
+
 
 
 class PyWriter final {
 public:
   void Start(WriteSession::Spec s) {
-    s.archive_spec.mode = "write";
+    if (s.archive_spec.mode != "append") {
+      s.archive_spec.mode = "write";
+    }
     auto maybe_w = WriteSession::Create(s);
     if (!maybe_w.IsOk()) {
       throw std::invalid_argument(
@@ -257,8 +508,12 @@ public:
 
   void Close() {
     if (_write_sess) {
-      _write_sess->Close();
+      auto status = _write_sess->Close();
       _write_sess = nullptr;
+      if (!status.IsOk()) {
+        throw std::runtime_error(
+          fmt::format("Failed to close write session. Error {}", status.error));
+      }
     }
   }
 
@@ -308,15 +563,23 @@ public:
 
     auto maybe_fds = DecodeFDS(fds_bytes);
 
-    auto maybe_ok = _write_sess->WriteEntry(
-      Entry::CreateStampedUnchecked(
-        topic,
-        sec,
-        nanos,
-        type_url,
-        msg_bytes,
-        /* fds = */ maybe_fds.has_value() ? &maybe_fds.value() : nullptr,
-        /* descriptor = */ nullptr));
+    // Frame the message straight from the Python bytes buffer (no copies)
+    char *data = nullptr;
+    Py_ssize_t size = 0;
+    if (PyBytes_AsStringAndSize(msg_bytes.ptr(), &data, &size) != 0) {
+      throw py::error_already_set();
+    }
+
+    ::google::protobuf::Timestamp t;
+    t.set_seconds(sec);
+    t.set_nanos(nanos);
+    auto maybe_ok = _write_sess->WriteStampedUnchecked(
+      topic,
+      t,
+      type_url,
+      std::string_view(data, size_t(size)),
+      /* fds = */ maybe_fds.has_value() ? &maybe_fds.value() : nullptr,
+      /* descriptor = */ nullptr);
     if (!maybe_ok.IsOk()) {
       throw std::runtime_error(maybe_ok.error);
     }
@@ -356,6 +619,37 @@ PYBIND11_MODULE(protobag_native, m) {
 
   m.def("get_version", []() { return std::string(PROTOBAG_VERSION);});
 
+  m.def(
+    "extract_columns",
+    &ExtractColumns,
+      py::arg("path"),
+      py::arg("topic"),
+      py::arg("field_paths"),
+      py::arg("chunk_size") = 4096,
+      py::arg("num_threads") = 0,
+    "Extract the values at `field_paths` of every message on `topic` into "
+    "numpy arrays (without copying).  Returns a dict with `timestamp_ns` "
+    "and `values` and `valid` dicts keyed by field path; string values are "
+    "a (uint8 data, int64 offsets) tuple.  FMI see "
+    "`protobag::ColumnExtractor`.");
+
+
+  /// native_buffer
+  py::class_<native_buffer>(
+      m, "native_buffer", py::buffer_protocol(),
+      "A native-owned (bytes) buffer")
+    .def_buffer([](native_buffer &b) -> py::buffer_info {
+      return py::buffer_info(
+        (void *) b.data.data(),
+        sizeof(uint8_t),
+        py::format_descriptor<uint8_t>::format(),
+        1,
+        {b.data.size()},
+        {sizeof(uint8_t)},
+        /* readonly= */ true);
+    })
+    .def("__len__", [](const native_buffer &b) { return b.data.size(); });
+
 
   /// native_entry
   py::class_<native_entry>(m, "native_entry", "Handle to a native entry")
@@ -370,13 +664,55 @@ PYBIND11_MODULE(protobag_native, m) {
 
 
   /// Reading
+  py::class_<ReadShuffleSpec>(
+    m, "ReadShuffleSpec", "Spec for reading entries in shuffled order")
+    .def(py::init<>())
+    .def_readwrite(
+      "block_size",
+      &ReadShuffleSpec::block_size,
+      "Shuffle blocks of this many entries that are contiguous in the archive")
+    .def_readwrite(
+      "buffer_size",
+      &ReadShuffleSpec::buffer_size,
+      "Emit entries at random from a buffer of this many entries")
+    .def_readwrite(
+      "seed",
+      &ReadShuffleSpec::seed,
+      "Random seed; the same seed gives the same order");
+
   py::class_<PyReader>(m, "PyReader", "Handle to a Protobag ReadSession")
     .def(py::init<>(), "Create a null session")
-    .def("start", &PyReader::Start, "Begin reading the given Selection")
+    .def(
+      "start",
+      &PyReader::Start,
+      "Begin reading the given Selection, optionally keeping only entries "
+      "that satisfy all the given (field_path, op, value) predicates and "
+      "reading only shard `shard_index` of `num_shards`, in shuffled order "
+      "if `shuffle` is given.  If `resume_cursor` is given (see "
+      "`get_cursor()`), continue a previous read (and ignore `selection`, "
+      "sharding and `shuffle`)",
+      py::arg("path"),
+      py::arg("selection"),
+      py::arg("predicates") = std::vector<py_predicate>(),
+      py::arg("shard_index") = 0,
+      py::arg("num_shards") = 1,
+      py::arg("shuffle") = py::none(),
+      py::arg("resume_cursor") = py::bytes())
     .def(
       "get_next",
       &PyReader::GetNext,
       "Get next item or None for end of sequence")
+    .def(
+      "get_next_batch",
+      &PyReader::GetNextBatch,
+      "Get up to `n` next items (reading with the GIL released); returns "
+      "an empty list for end of sequence",
+      py::arg("n"))
+    .def(
+      "get_cursor",
+      &PyReader::GetCursor,
+      "Get a (bytes) token for the position of this session after the "
+      "items returned so far; pass it to `start()` to resume reading")
     .def_static(
       "get_index",
       &PyReader::GetIndex,
@@ -422,12 +758,52 @@ PYBIND11_MODULE(protobag_native, m) {
     .def(py::init<>())
     .def(
       "start", &PyMaxSlopTimeSync::Start,
-      "Begin synchronizing the given reader")
+        py::arg("reader"),
+        py::arg("spec"),
+        py::arg("plan_from_index") = false,
+      "Begin synchronizing the given reader; use `plan_from_index` to plan "
+      "bundles using only the protobag index and read only emitted entries")
     .def(
       "get_next",
       &PyMaxSlopTimeSync::GetNext,
       "Get next bundle or None for end of sequence");
 
+  py::class_<FixedRateTimeSync::Spec>(
+    m, "FixedRateTimeSyncSpec", "Spec for a FixedRateTimeSync")
+    .def(py::init<>())
+    .def_readwrite(
+      "topics", &FixedRateTimeSync::Spec::topics, "Synchronize these topics")
+    .def("set_period", 
+      [](FixedRateTimeSync::Spec &s, int64_t sec, int32_t nanos) { 
+        s.period.set_seconds(sec); s.period.set_nanos(nanos);
+      },
+        py::arg("seconds"),
+        py::arg("nanos"),
+      "Emit a bundle every `period`")
+    .def("get_period",
+      [](FixedRateTimeSync::Spec &s) {
+        py::dict d;
+        d["seconds"] = s.period.seconds();
+        d["nanos"] = s.period.nanos();
+        return d;
+      });
+
+  py::class_<PyFixedRateTimeSync>(
+    m, "PyFixedRateTimeSync",
+    "Emit bundles at a fixed rate; each bundle has the nearest messages "
+    "before and after each tick for every topic.  FMI see docs for "
+    "`protobag::FixedRateTimeSync`. ")
+    .def(py::init<>())
+    .def(
+      "start", &PyFixedRateTimeSync::Start,
+        py::arg("reader"),
+        py::arg("spec"),
+      "Begin synchronizing the given reader")
+    .def(
+      "get_next",
+      &PyFixedRateTimeSync::GetNext,
+      "Get next bundle or None for end of sequence");
+
 
   /// Writing
   py::class_<WriteSession::Spec>(m, "WriterSpec", "Spec for a WriteSession")
@@ -447,7 +823,31 @@ PYBIND11_MODULE(protobag_native, m) {
       [](WriteSession::Spec &s, const std::string &v) {
         s.archive_spec.format = v;
       },
-      "Write in this format");
+      "Write in this format")
+    .def_property("append",
+      [](WriteSession::Spec &s) { return s.archive_spec.mode == "append"; },
+      [](WriteSession::Spec &s, bool v) {
+        s.archive_spec.mode = v ? "append" : "write";
+      },
+      "Append to an existing (zip or directory) bag")
+    .def_readwrite(
+      "split_bytes",
+      &WriteSession::Spec::split_bytes,
+      "Start a new numbered bag once a bag holds this many bytes (0: never)")
+    .def("set_split_duration",
+      [](WriteSession::Spec &s, int64_t sec, int32_t nanos) {
+        s.split_duration.set_seconds(sec); s.split_duration.set_nanos(nanos);
+      },
+        py::arg("seconds"),
+        py::arg("nanos"),
+      "Start a new numbered bag once a bag spans this much time")
+    .def("get_split_duration",
+      [](WriteSession::Spec &s) {
+        py::dict d;
+        d["seconds"] = s.split_duration.seconds();
+        d["nanos"] = s.split_duration.nanos();
+        return d;
+      });
 
   py::class_<PyWriter>(m, "PyWriter", "Handle to a Protobag WriteSession")
     .def(py::init<>(), "Create a null session")
@@ -0,0 +1,197 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "protobag/ColumnExtractor.hpp"
+#include "protobag/Entry.hpp"
+#include "protobag/WriteSession.hpp"
+#include "protobag/Utils/StdMsgUtils.hpp"
+
+#include "protobag_test/Utils.hpp"
+
+using namespace protobag;
+using namespace protobag_test;
+
+inline StdMsg_Float ToFloatMsg(float v) {
+  StdMsg_Float m;
+  m.set_value(v);
+  return m;
+}
+
+TEST(ColumnExtractorTest, TestExtractBasic) {
+  static const size_t kNumRows = 100;
+
+  std::list<Entry> entries;
+  for (size_t i = 0; i < kNumRows; ++i) {
+    TopicTime tt;
+    tt.set_topic(i % 2 == 0 ? "even" : "odd");
+    tt.mutable_timestamp()->set_seconds(10 * i);
+    if (i != 7) {
+      tt.set_entryname(fmt::format("entry_{}", i));
+    }
+    entries.push_back(Entry::CreateStamped("/tt", i, 1000, tt));
+    entries.push_back(Entry::CreateStamped("/f", i, 0, ToFloatMsg(0.5f * i)));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto maybe_columns = ColumnExtractor::Extract({
+    .archive_spec = {
+      .mode = "read",
+      .format = "memory",
+      .memory_archive = fixture,
+    },
+    .topic = "/tt",
+    .field_paths = {"timestamp.seconds", "topic", "entryname"},
+    .chunk_size = 16,
+    .num_threads = 3,
+  });
+  ASSERT_TRUE(maybe_columns.IsOk()) << maybe_columns.error;
+  const ExtractedColumns &columns = *maybe_columns.value;
+
+  EXPECT_EQ(columns.topic, "/tt");
+  EXPECT_EQ(columns.type_url, GetTypeURL<TopicTime>());
+  ASSERT_EQ(columns.NumRows(), kNumRows);
+  ASSERT_EQ(columns.columns.size(), 3);
+
+  const auto &seconds = columns.columns[0];
+  EXPECT_EQ(seconds.type, ExtractedColumn::Type::Int64);
+  ASSERT_EQ(seconds.int64s.size(), kNumRows);
+  
+  const auto &topic = columns.columns[1];
+  EXPECT_EQ(topic.type, ExtractedColumn::Type::String);
+  ASSERT_EQ(topic.string_offsets.size(), kNumRows + 1);
+  
+  const auto &entryname = columns.columns[2];
+  ASSERT_EQ(entryname.string_offsets.size(), kNumRows + 1);
+
+  for (size_t i = 0; i < kNumRows; ++i) {
+    EXPECT_EQ(columns.timestamp_ns[i], i * 1000000000 + 1000);
+    
+    EXPECT_TRUE(seconds.valid[i]);
+    EXPECT_EQ(seconds.int64s[i], 10 * i);
+
+    EXPECT_EQ(
+      topic.string_data.substr(
+        topic.string_offsets[i],
+        topic.string_offsets[i + 1] - topic.string_offsets[i]),
+      i % 2 == 0 ? "even" : "odd");
+    
+    EXPECT_EQ(
+      entryname.string_data.substr(
+        entryname.string_offsets[i],
+        entryname.string_offsets[i + 1] - entryname.string_offsets[i]),
+      i == 7 ? "" : fmt::format("entry_{}", i));
+  }
+}
+
+TEST(ColumnExtractorTest, TestExtractDoubles) {
+  std::list<Entry> entries;
+  for (size_t i = 0; i < 10; ++i) {
+    entries.push_back(Entry::CreateStamped("/f", i, 0, ToFloatMsg(0.5f * i)));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto maybe_columns = ColumnExtractor::Extract({
+    .archive_spec = {
+      .mode = "read",
+      .format = "memory",
+      .memory_archive = fixture,
+    },
+    .topic = "/f",
+    .field_paths = {"value"},
+  });
+  ASSERT_TRUE(maybe_columns.IsOk()) << maybe_columns.error;
+  const ExtractedColumns &columns = *maybe_columns.value;
+  ASSERT_EQ(columns.NumRows(), 10);
+  
+  const auto &value = columns.columns[0];
+  EXPECT_EQ(value.type, ExtractedColumn::Type::Double);
+  for (size_t i = 0; i < 10; ++i) {
+    EXPECT_TRUE(value.valid[i]);
+    EXPECT_EQ(value.doubles[i], 0.5 * i);
+  }
+}
+
+TEST(ColumnExtractorTest, TestExtractBadPath) {
+  std::list<Entry> entries = {
+    Entry::CreateStamped("/f", 0, 0, ToFloatMsg(1)),
+  };
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto maybe_columns = ColumnExtractor::Extract({
+    .archive_spec = {
+      .mode = "read",
+      .format = "memory",
+      .memory_archive = fixture,
+    },
+    .topic = "/f",
+    .field_paths = {"does_not_exist"},
+  });
+  ASSERT_FALSE(maybe_columns.IsOk());
+  EXPECT_EQ(
+    maybe_columns.error,
+    "Msg protobag.StdMsg.Float has no field does_not_exist");
+}
+
+TEST(ColumnExtractorTest, TestSinglePassOverZip) {
+  auto testdir = CreateTestTempdir("ColumnExtractorTest.TestSinglePassOverZip");
+  const std::string path = testdir / "bag.zip";
+  {
+    auto maybe_w = WriteSession::Create({
+      .archive_spec = {
+        .mode = "write",
+        .path = path,
+        .format = "zip",
+      },
+    });
+    ASSERT_TRUE(maybe_w.IsOk()) << maybe_w.error;
+    for (size_t i = 0; i < 50; ++i) {
+      auto status = (*maybe_w.value)->WriteEntry(
+        Entry::CreateStamped("/f", i, 0, ToFloatMsg(0.5f * i)));
+      ASSERT_TRUE(status.IsOk()) << status.error;
+    }
+  }
+
+  ReadPassCounter pass_counter;
+  auto maybe_columns = ColumnExtractor::Extract({
+    .archive_spec = {
+      .mode = "read",
+      .path = path,
+      .format = "zip",
+    },
+    .topic = "/f",
+    .field_paths = {"value"},
+    .chunk_size = 16,
+  });
+  ASSERT_TRUE(maybe_columns.IsOk()) << maybe_columns.error;
+  const size_t passes = pass_counter.Get();
+
+  const ExtractedColumns &columns = *maybe_columns.value;
+  ASSERT_EQ(columns.NumRows(), 50);
+  for (size_t i = 0; i < 50; ++i) {
+    EXPECT_EQ(columns.columns[0].doubles[i], 0.5 * i);
+  }
+
+  // Opening the bag and reading its index takes a few passes, and then all
+  // 50 entries come from a single forward pass (rather than one pass each)
+  EXPECT_LE(passes, 5) << passes;
+}
@@ -0,0 +1,117 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "protobag/EntryView.hpp"
+#include "protobag/ReadSession.hpp"
+#include "protobag/Utils/StdMsgUtils.hpp"
+
+#include "protobag_test/Utils.hpp"
+
+using namespace protobag;
+using namespace protobag_test;
+
+TEST(EntryViewTest, TestHeader) {
+  auto entry = Entry::CreateStamped("/s", 3, 4, ToStringMsg("foo"));
+  EntryView view(
+    "/s/3.4.stampedmsg.protobin",
+    PBFactory::ToBinaryString(entry.msg).value.value());
+
+  EXPECT_TRUE(view.IsStampedMessage());
+  EXPECT_FALSE(view.IsRaw());
+  EXPECT_EQ(view.GetTopic(), "/s");
+  EXPECT_EQ(view.GetTypeURL(), GetTypeURL<StdMsg_String>());
+  EXPECT_EQ(view.GetPayload(), ToStringMsg("foo").SerializeAsString());
+  ASSERT_TRUE(view.GetStamp().has_value());
+  EXPECT_EQ(view.GetStamp()->seconds(), 3);
+  EXPECT_EQ(view.GetStamp()->nanos(), 4);
+
+  // Views survive moves
+  EntryView moved = std::move(view);
+  EXPECT_EQ(moved.GetTypeURL(), GetTypeURL<StdMsg_String>());
+
+  auto maybe_entry = moved.ToEntry();
+  ASSERT_TRUE(maybe_entry.IsOk()) << maybe_entry.error;
+  EXPECT_EQ(maybe_entry.value->GetAs<StdMsg_String>().value->value(), "foo");
+  ASSERT_TRUE(maybe_entry.value->ctx.has_value());
+  EXPECT_EQ(maybe_entry.value->ctx->topic, "/s");
+
+  maybe_entry = moved.ToEntry(/* unpack_stamped */ false);
+  ASSERT_TRUE(maybe_entry.IsOk()) << maybe_entry.error;
+  EXPECT_TRUE(maybe_entry.value->IsA<StampedMessage>());
+}
+
+TEST(EntryViewTest, TestReadViews) {
+  std::vector<Entry> entries = {
+    Entry::Create("/moof", ToStringMsg("moof")),
+    Entry::CreateRawFromBytes("/i_am_raw", "i am raw data"),
+  };
+  for (int i = 0; i < 10; ++i) {
+    entries.push_back(Entry::CreateStamped("/i", i, 1, ToIntMsg(i)));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto CreateSession = [&]() {
+    Selection sel;
+    sel.mutable_select_all();
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {
+        .mode = "read",
+        .format = "memory",
+        .memory_archive = fixture,
+      },
+      .selection = sel,
+      .unpack_stamped_messages = true,
+    });
+    if (!maybe_rs.IsOk()) {
+      throw std::runtime_error(maybe_rs.error);
+    }
+    return *maybe_rs.value;
+  };
+
+  auto entry_session = CreateSession();
+  auto view_session = CreateSession();
+  size_t n_stamped = 0;
+  while (true) {
+    auto maybe_entry = entry_session->GetNext();
+    auto maybe_view = view_session->GetNextView();
+    if (maybe_entry.IsEndOfSequence()) {
+      EXPECT_TRUE(maybe_view.IsEndOfSequence()) << maybe_view.error;
+      break;
+    }
+    ASSERT_TRUE(maybe_entry.IsOk()) << maybe_entry.error;
+    ASSERT_TRUE(maybe_view.IsOk()) << maybe_view.error;
+
+    const Entry &expected = *maybe_entry.value;
+    const EntryView &view = *maybe_view.value;
+    EXPECT_EQ(view.GetEntryname(), expected.entryname);
+    EXPECT_EQ(view.GetTypeURL(), expected.msg.type_url());
+    if (view.IsStampedMessage()) {
+      ++n_stamped;
+      ASSERT_TRUE(expected.ctx.has_value());
+      EXPECT_EQ(view.GetTopic(), expected.ctx->topic);
+      EXPECT_EQ(view.GetStamp()->seconds(), expected.ctx->stamp.seconds());
+    }
+
+    auto maybe_decoded = view.ToEntry();
+    ASSERT_TRUE(maybe_decoded.IsOk()) << maybe_decoded.error;
+    EXPECT_TRUE(maybe_decoded.value->EntryDataEqualTo(expected));
+  }
+  EXPECT_EQ(n_stamped, 11); // Includes the index
+}
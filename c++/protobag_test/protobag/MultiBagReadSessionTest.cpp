@@ -0,0 +1,191 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <utility>
+#include <vector>
+
+#include "protobag/Entry.hpp"
+#include "protobag/MultiBagReadSession.hpp"
+#include "protobag/WriteSession.hpp"
+#include "protobag/Utils/StdMsgUtils.hpp"
+
+#include "protobag_test/Utils.hpp"
+
+using namespace protobag;
+using namespace protobag_test;
+
+TEST(MultiBagReadSessionTest, TestTimeMerge) {
+  // Bag 0 has even seconds and bag 1 odd seconds (plus a tie at 4)
+  std::vector<Entry> even, odd;
+  for (int i = 0; i < 10; i += 2) {
+    even.push_back(Entry::CreateStamped("/a", i, 0, ToIntMsg(i)));
+  }
+  for (int i = 1; i < 10; i += 2) {
+    odd.push_back(Entry::CreateStamped("/b", i, 0, ToIntMsg(i)));
+  }
+  odd.push_back(Entry::CreateStamped("/b", 4, 0, ToIntMsg(-4)));
+  auto bag0 = CreateMemoryArchive(even);
+  auto bag1 = CreateMemoryArchive(odd);
+
+  Selection sel;
+  sel.mutable_window();
+  auto maybe_s = MultiBagReadSession::Create({
+    .archive_specs = {MemorySpec(bag0), MemorySpec(bag1)},
+    .selection = sel,
+    .unpack_stamped_messages = true,
+  });
+  ASSERT_TRUE(maybe_s.IsOk()) << maybe_s.error;
+  auto &session = **maybe_s.value;
+
+  std::vector<std::pair<int64_t, size_t>> actual;
+  while (true) {
+    auto maybe_entry = session.GetNext();
+    if (maybe_entry.IsEndOfSequence()) { break; }
+    ASSERT_TRUE(maybe_entry.IsOk()) << maybe_entry.error;
+    auto maybe_i = maybe_entry.value->GetAs<StdMsg_Int>();
+    ASSERT_TRUE(maybe_i.IsOk()) << maybe_i.error;
+    actual.push_back({maybe_i.value->value(), session.GetLastBag()});
+  }
+
+  std::vector<std::pair<int64_t, size_t>> expected = {
+    {0, 0}, {1, 1}, {2, 0}, {3, 1}, {4, 0}, {-4, 1},
+    {5, 1}, {6, 0}, {7, 1}, {8, 0}, {9, 1},
+  };
+  EXPECT_EQ(actual, expected);
+}
+
+TEST(MultiBagReadSessionTest, TestSelections) {
+  std::vector<Entry> entries0, entries1;
+  for (int i = 0; i < 5; ++i) {
+    entries0.push_back(Entry::CreateStamped("/a", i, 0, ToIntMsg(i)));
+    entries0.push_back(Entry::CreateStamped("/b", i, 1, ToIntMsg(100 + i)));
+    entries1.push_back(Entry::CreateStamped("/a", i, 2, ToIntMsg(10 + i)));
+  }
+  auto bag0 = CreateMemoryArchive(entries0);
+  auto bag1 = CreateMemoryArchive(entries1);
+
+  auto ReadAll = [&](const Selection &sel) {
+    auto maybe_s = MultiBagReadSession::Create({
+      .archive_specs = {MemorySpec(bag0), MemorySpec(bag1)},
+      .selection = sel,
+      .unpack_stamped_messages = true,
+    });
+    if (!maybe_s.IsOk()) {
+      throw std::runtime_error(maybe_s.error);
+    }
+
+    // Read through a ReadSession
+    auto rs = (*maybe_s.value)->AsReadSession();
+    std::vector<int64_t> values;
+    for (const Entry &entry : *rs) {
+      auto maybe_i = entry.GetAs<StdMsg_Int>();
+      if (!maybe_i.IsOk()) {
+        throw std::runtime_error(maybe_i.error);
+      }
+      values.push_back(maybe_i.value->value());
+    }
+    if (!rs->GetIterationStatus().IsOk()) {
+      throw std::runtime_error(rs->GetIterationStatus().error);
+    }
+    return values;
+  };
+
+  {
+    Selection sel;
+    sel.mutable_window()->add_topics("/a");
+    sel.mutable_window()->mutable_start()->set_seconds(2);
+    EXPECT_EQ(ReadAll(sel), std::vector<int64_t>({2, 12, 3, 13, 4, 14}));
+  }
+
+  {
+    Selection sel;
+    auto *events = sel.mutable_events();
+    {
+      TopicTime *tt = events->add_events();
+      tt->set_topic("/b");
+      tt->mutable_timestamp()->set_seconds(3);
+      tt->mutable_timestamp()->set_nanos(1);
+    }
+    {
+      TopicTime *tt = events->add_events();
+      tt->set_topic("/a");
+      tt->mutable_timestamp()->set_seconds(1);
+      tt->mutable_timestamp()->set_nanos(2);
+    }
+    events->set_require_all(true);
+    EXPECT_EQ(ReadAll(sel), std::vector<int64_t>({11, 103}));
+
+    TopicTime *tt = events->add_events();
+    tt->set_topic("/c");
+    EXPECT_THROW(ReadAll(sel), std::runtime_error);
+  }
+
+  {
+    Selection sel;
+    sel.mutable_select_all();
+    EXPECT_THROW(ReadAll(sel), std::runtime_error);
+  }
+}
+
+TEST(MultiBagReadSessionTest, TestOnePassPerZipBag) {
+  auto testdir = CreateTestTempdir("MultiBagReadSessionTest.TestOnePassPerZipBag");
+
+  // Two bags with interleaved timestamps
+  static const int kNumPerBag = 50;
+  std::vector<std::string> paths;
+  for (int b = 0; b < 2; ++b) {
+    const std::string path = testdir / fmt::format("bag{}.zip", b);
+    paths.push_back(path);
+    auto maybe_w = WriteSession::Create({
+      .archive_spec = {
+        .mode = "write",
+        .path = path,
+        .format = "zip",
+      },
+    });
+    ASSERT_TRUE(maybe_w.IsOk()) << maybe_w.error;
+    for (int i = 0; i < kNumPerBag; ++i) {
+      auto status = (*maybe_w.value)->WriteEntry(
+        Entry::CreateStamped("/t", 2 * i + b, 0, ToIntMsg(2 * i + b)));
+      ASSERT_TRUE(status.IsOk()) << status.error;
+    }
+  }
+
+  auto maybe_s = MultiBagReadSession::Create(
+    MultiBagReadSession::Spec::ReadAllFromPaths(paths));
+  ASSERT_TRUE(maybe_s.IsOk()) << maybe_s.error;
+  auto &session = **maybe_s.value;
+
+  ReadPassCounter pass_counter;
+  std::vector<int64_t> values;
+  while (true) {
+    auto maybe_entry = session.GetNext();
+    if (maybe_entry.IsEndOfSequence()) { break; }
+    ASSERT_TRUE(maybe_entry.IsOk()) << maybe_entry.error;
+    values.push_back(maybe_entry.value->GetAs<StdMsg_Int>().value->value());
+  }
+  const size_t passes = pass_counter.Get();
+
+  ASSERT_EQ(values.size(), 2 * kNumPerBag);
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(values[i], int64_t(i));
+  }
+
+  // One forward pass per bag, rather than one per batch of entries
+  EXPECT_EQ(passes, 2);
+}
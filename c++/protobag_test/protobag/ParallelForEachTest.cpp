@@ -0,0 +1,276 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "protobag/Entry.hpp"
+#include "protobag/ParallelForEach.hpp"
+#include "protobag/WriteSession.hpp"
+#include "protobag/Utils/StdMsgUtils.hpp"
+
+#include "protobag_test/Utils.hpp"
+
+using namespace protobag;
+using namespace protobag_test;
+
+namespace {
+
+std::vector<Entry> CreateIntEntries(int n) {
+  std::vector<Entry> entries;
+  for (int i = 0; i < n; ++i) {
+    entries.push_back(Entry::CreateStamped("/i", i, 0, ToIntMsg(i)));
+  }
+  return entries;
+}
+
+ReadSession::Spec ReadTopicFrom(
+    std::shared_ptr<archive::MemoryArchive> fixture,
+    const std::string &topic) {
+
+  Selection sel;
+  sel.mutable_window()->add_topics(topic);
+  return {
+    .archive_spec = {
+      .mode = "read",
+      .format = "memory",
+      .memory_archive = fixture,
+    },
+    .selection = sel,
+    .unpack_stamped_messages = true,
+  };
+}
+
+} // anon namespace
+
+TEST(ParallelForEachTest, TestVisitsEachEntryOnce) {
+  auto fixture = CreateMemoryArchive(CreateIntEntries(1000));
+
+  std::mutex mutex;
+  std::vector<int> values;
+  auto status = ParallelForEach(
+    ReadTopicFrom(fixture, "/i"),
+    [&](const Entry &entry) -> OkOrErr {
+      auto maybe_i = entry.GetAs<StdMsg_Int>();
+      if (!maybe_i.IsOk()) {
+        return {.error = maybe_i.error};
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      values.push_back(maybe_i.value->value());
+      return kOK;
+    },
+    {.num_threads = 4, .chunk_size = 7});
+  ASSERT_TRUE(status.IsOk()) << status.error;
+
+  std::sort(values.begin(), values.end());
+  ASSERT_EQ(values.size(), 1000);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(values[i], i);
+  }
+}
+
+TEST(ParallelForEachTest, TestMapReduce) {
+  auto testdir = CreateTestTempdir("ParallelForEachTest.TestMapReduce");
+  const auto path = testdir / "test.zip";
+  {
+    auto maybe_w = WriteSession::Create({
+      .archive_spec = {
+        .mode = "write",
+        .path = path,
+      },
+    });
+    ASSERT_TRUE(maybe_w.IsOk()) << maybe_w.error;
+    for (const auto &entry : CreateIntEntries(500)) {
+      auto status = (*maybe_w.value)->WriteEntry(entry);
+      ASSERT_TRUE(status.IsOk()) << status.error;
+    }
+  }
+
+  struct SumCount {
+    int64_t sum = 0;
+    size_t count = 0;
+  };
+  auto maybe_acc = MapReduce(
+    ReadSession::Spec::ReadAllFromPath(path),
+    SumCount(),
+    [](SumCount &acc, const Entry &entry) -> OkOrErr {
+      auto maybe_i = entry.GetAs<StdMsg_Int>();
+      if (maybe_i.IsOk()) {
+        acc.sum += maybe_i.value->value();
+        acc.count += 1;
+      }
+      return kOK;
+    },
+    [](SumCount &acc, SumCount &&other) {
+      acc.sum += other.sum;
+      acc.count += other.count;
+    },
+    {.num_threads = 3, .chunk_size = 16});
+  ASSERT_TRUE(maybe_acc.IsOk()) << maybe_acc.error;
+  EXPECT_EQ(maybe_acc.value->count, 500);
+  EXPECT_EQ(maybe_acc.value->sum, 499 * 500 / 2);
+}
+
+TEST(ParallelForEachTest, TestWorkerIndex) {
+  auto fixture = CreateMemoryArchive(CreateIntEntries(100));
+
+  const ParallelOptions opts = {.num_threads = 4, .chunk_size = 1};
+  std::vector<size_t> counts(GetNumWorkers(opts), 0);
+  auto status = ParallelForEachWithWorker(
+    ReadTopicFrom(fixture, "/i"),
+    [&](size_t worker, const Entry &entry) -> OkOrErr {
+      if (worker >= counts.size()) {
+        return {.error = "Bad worker index"};
+      }
+      counts[worker] += 1;
+      return kOK;
+    },
+    opts);
+  ASSERT_TRUE(status.IsOk()) << status.error;
+
+  size_t total = 0;
+  for (size_t count : counts) { total += count; }
+  EXPECT_EQ(total, 100);
+}
+
+TEST(ParallelForEachTest, TestErrors) {
+  auto fixture = CreateMemoryArchive(CreateIntEntries(100));
+
+  {
+    std::atomic<size_t> n(0);
+    auto status = ParallelForEach(
+      ReadTopicFrom(fixture, "/i"),
+      [&](const Entry &entry) -> OkOrErr {
+        if (++n == 10) {
+          return {.error = "moof"};
+        }
+        return kOK;
+      },
+      {.num_threads = 2, .chunk_size = 4});
+    EXPECT_FALSE(status.IsOk());
+    EXPECT_EQ(status.error, "moof");
+  }
+
+  {
+    Selection sel;
+    sel.mutable_entrynames()->add_entrynames("/does/not/exist");
+    auto status = ParallelForEach(
+      {
+        .archive_spec = {
+          .mode = "read",
+          .format = "memory",
+          .memory_archive = fixture,
+        },
+        .selection = sel,
+      },
+      [](const Entry &entry) { return kOK; });
+    EXPECT_FALSE(status.IsOk());
+  }
+
+  {
+    auto spec = ReadTopicFrom(fixture, "/i");
+    spec.shuffle = ReadShuffleSpec();
+    auto status = ParallelForEach(
+      spec, [](const Entry &entry) { return kOK; });
+    EXPECT_FALSE(status.IsOk());
+  }
+}
+
+TEST(ParallelForEachTest, TestFieldPredicates) {
+  auto fixture = CreateMemoryArchive(CreateIntEntries(100));
+  auto spec = ReadTopicFrom(fixture, "/i");
+  spec.predicates = {
+    {.field_path = "value", .op = FieldPredicate::Op::GE, .value = 90},
+  };
+
+  std::mutex mutex;
+  std::vector<int> values;
+  auto status = ParallelForEach(
+    spec,
+    [&](const Entry &entry) -> OkOrErr {
+      // Matches are unpacked
+      if (!entry.ctx.has_value()) {
+        return {.error = "Entry not unpacked"};
+      }
+      auto maybe_i = entry.GetAs<StdMsg_Int>();
+      if (!maybe_i.IsOk()) {
+        return {.error = maybe_i.error};
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      values.push_back(maybe_i.value->value());
+      return kOK;
+    },
+    {.num_threads = 3, .chunk_size = 7});
+  ASSERT_TRUE(status.IsOk()) << status.error;
+
+  std::sort(values.begin(), values.end());
+  std::vector<int> expected;
+  for (int i = 90; i < 100; ++i) {
+    expected.push_back(i);
+  }
+  EXPECT_SEQUENCES_EQUAL(expected, values);
+}
+
+TEST(ParallelForEachTest, TestOnePassPerWorkerOverZip) {
+  auto testdir = CreateTestTempdir("ParallelForEachTest.TestOnePassPerWorkerOverZip");
+  const std::string path = testdir / "bag.zip";
+  {
+    auto maybe_w = WriteSession::Create({
+      .archive_spec = {
+        .mode = "write",
+        .path = path,
+        .format = "zip",
+      },
+    });
+    ASSERT_TRUE(maybe_w.IsOk()) << maybe_w.error;
+    for (const auto &entry : CreateIntEntries(1000)) {
+      auto status = (*maybe_w.value)->WriteEntry(entry);
+      ASSERT_TRUE(status.IsOk()) << status.error;
+    }
+  }
+
+  Selection sel;
+  sel.mutable_window()->add_topics("/i");
+  const ReadSession::Spec spec = {
+    .archive_spec = {
+      .mode = "read",
+      .path = path,
+      .format = "zip",
+    },
+    .selection = sel,
+    .unpack_stamped_messages = true,
+  };
+
+  ReadPassCounter pass_counter;
+  std::atomic<size_t> n_seen(0);
+  auto status = ParallelForEach(
+    spec,
+    [&](const Entry &entry) -> OkOrErr { ++n_seen; return kOK; },
+    {.num_threads = 1, .chunk_size = 64});
+  ASSERT_TRUE(status.IsOk()) << status.error;
+  const size_t passes = pass_counter.Get();
+
+  EXPECT_EQ(n_seen, 1000);
+
+  // Planning the read takes a couple of passes, and then the worker reads
+  // all 16 of its chunks in a single forward pass (rather than one pass per
+  // chunk)
+  EXPECT_LE(passes, 3) << passes;
+}
@@ -0,0 +1,204 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/util/config.h>
+#include <fmt/format.h>
+#include <parquet/arrow/reader.h>
+
+#include "protobag/Entry.hpp"
+#include "protobag/ParquetExporter.hpp"
+#include "protobag/ReadSession.hpp"
+#include "protobag/Utils/StdMsgUtils.hpp"
+#include "protobag/Utils/Tempfile.hpp"
+
+#include "protobag_test/Utils.hpp"
+
+using namespace protobag;
+using namespace protobag_test;
+
+namespace {
+
+std::shared_ptr<arrow::Table> ReadParquetTable(const std::string &path) {
+  auto maybe_infile = arrow::io::ReadableFile::Open(path);
+  if (!maybe_infile.ok()) {
+    throw std::runtime_error(maybe_infile.status().ToString());
+  }
+
+  std::unique_ptr<parquet::arrow::FileReader> reader;
+#if ARROW_VERSION_MAJOR >= 19
+  auto maybe_reader = parquet::arrow::OpenFile(
+    *maybe_infile, arrow::default_memory_pool());
+  if (!maybe_reader.ok()) {
+    throw std::runtime_error(maybe_reader.status().ToString());
+  }
+  reader = std::move(*maybe_reader);
+#else
+  auto status = parquet::arrow::OpenFile(
+    *maybe_infile, arrow::default_memory_pool(), &reader);
+  if (!status.ok()) {
+    throw std::runtime_error(status.ToString());
+  }
+#endif
+
+#if ARROW_VERSION_MAJOR >= 24
+  auto maybe_table = reader->ReadTable();
+  if (!maybe_table.ok()) {
+    throw std::runtime_error(maybe_table.status().ToString());
+  }
+  std::shared_ptr<arrow::Table> table = *maybe_table;
+#else
+  std::shared_ptr<arrow::Table> table;
+  auto status_read = reader->ReadTable(&table);
+  if (!status_read.ok()) {
+    throw std::runtime_error(status_read.ToString());
+  }
+#endif
+  auto maybe_combined = table->CombineChunks();
+  if (!maybe_combined.ok()) {
+    throw std::runtime_error(maybe_combined.status().ToString());
+  }
+  return *maybe_combined;
+}
+
+} // anon namespace
+
+TEST(ParquetExporterTest, TestGetOutputPath) {
+  EXPECT_EQ(
+    ParquetExporter::GetOutputPath("out", "/robot/pose"),
+    "out/robot.pose.parquet");
+  EXPECT_EQ(ParquetExporter::GetOutputPath("out", "t"), "out/t.parquet");
+}
+
+TEST(ParquetExporterTest, TestExport) {
+  static const size_t kNumRows = 10;
+
+  std::list<Entry> entries;
+  for (size_t i = 0; i < kNumRows; ++i) {
+    TopicTime tt;
+    tt.set_topic("topic");
+    tt.mutable_timestamp()->set_seconds(i);
+    tt.set_entryname(fmt::format("entry_{}", i));
+    entries.push_back(Entry::CreateStamped("/tt", i, 500, tt));
+    entries.push_back(Entry::CreateStamped("/s", i, 0, ToStringMsg("s")));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+  const archive::Archive::Spec archive_spec = {
+    .mode = "read",
+    .format = "memory",
+    .memory_archive = fixture,
+  };
+
+  auto maybe_dir = CreateTempdir("ParquetExporterTest");
+  ASSERT_TRUE(maybe_dir.IsOk()) << maybe_dir.error;
+
+  auto maybe_paths = ParquetExporter::Export({
+    .archive_spec = archive_spec,
+    .topics = {"/tt"},
+    .output_dir = maybe_dir.value->string(),
+    .row_group_size = 3,
+  });
+  ASSERT_TRUE(maybe_paths.IsOk()) << maybe_paths.error;
+  ASSERT_EQ(maybe_paths.value->size(), 1);
+  
+  const std::string &path = maybe_paths.value->front();
+  EXPECT_EQ(path, ParquetExporter::GetOutputPath(maybe_dir.value->string(), "/tt"));
+
+  {
+    auto reader = parquet::ParquetFileReader::OpenFile(path);
+    auto metadata = reader->metadata();
+    EXPECT_EQ(metadata->num_rows(), kNumRows);
+    EXPECT_EQ(metadata->num_row_groups(), 4);
+  }
+
+  auto table = ReadParquetTable(path);
+  ASSERT_EQ(table->num_rows(), kNumRows);
+
+  // Check schema
+  auto expected_msg_type = arrow::struct_({
+    arrow::field("topic", arrow::utf8()),
+    arrow::field("timestamp", arrow::struct_({
+      arrow::field("seconds", arrow::int64()),
+      arrow::field("nanos", arrow::int32()),
+    })),
+    arrow::field("entryname", arrow::utf8()),
+  });
+  auto schema = table->schema();
+  ASSERT_EQ(schema->num_fields(), 3);
+  EXPECT_EQ(schema->field(0)->name(), "entryname");
+  EXPECT_TRUE(schema->field(0)->type()->Equals(arrow::utf8()))
+    << schema->field(0)->type()->ToString();
+  EXPECT_EQ(schema->field(1)->name(), "timestamp");
+  EXPECT_TRUE(
+    schema->field(1)->type()->Equals(arrow::timestamp(arrow::TimeUnit::NANO)))
+      << schema->field(1)->type()->ToString();
+  EXPECT_EQ(schema->field(2)->name(), "msg");
+  EXPECT_TRUE(schema->field(2)->type()->Equals(expected_msg_type))
+    << schema->field(2)->type()->ToString();
+
+  // Check cells
+  std::vector<std::string> expected_entrynames;
+  {
+    Selection sel;
+    sel.mutable_window()->add_topics("/tt");
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = archive_spec,
+      .selection = sel,
+    });
+    ASSERT_TRUE(maybe_rs.IsOk()) << maybe_rs.error;
+    while (true) {
+      auto maybe_entry = (*maybe_rs.value)->GetNext();
+      if (maybe_entry.IsEndOfSequence()) { break; }
+      ASSERT_TRUE(maybe_entry.IsOk()) << maybe_entry.error;
+      expected_entrynames.push_back(maybe_entry.value->entryname);
+    }
+  }
+  ASSERT_EQ(expected_entrynames.size(), kNumRows);
+
+  const auto &entryname_col = 
+    static_cast<const arrow::StringArray &>(*table->column(0)->chunk(0));
+  const auto &timestamp_col = 
+    static_cast<const arrow::TimestampArray &>(*table->column(1)->chunk(0));
+  const auto &msg_col = 
+    static_cast<const arrow::StructArray &>(*table->column(2)->chunk(0));
+  const auto &topic_col = 
+    static_cast<const arrow::StringArray &>(*msg_col.GetFieldByName("topic"));
+  const auto &msg_timestamp_col = 
+    static_cast<const arrow::StructArray &>(
+      *msg_col.GetFieldByName("timestamp"));
+  const auto &msg_seconds_col = 
+    static_cast<const arrow::Int64Array &>(
+      *msg_timestamp_col.GetFieldByName("seconds"));
+  const auto &msg_entryname_col = 
+    static_cast<const arrow::StringArray &>(
+      *msg_col.GetFieldByName("entryname"));
+
+  for (size_t i = 0; i < kNumRows; ++i) {
+    EXPECT_EQ(entryname_col.GetString(i), expected_entrynames[i]);
+    EXPECT_EQ(timestamp_col.Value(i), int64_t(i) * 1000000000 + 500);
+    EXPECT_EQ(topic_col.GetString(i), "topic");
+    EXPECT_EQ(msg_seconds_col.Value(i), int64_t(i));
+    EXPECT_EQ(msg_entryname_col.GetString(i), fmt::format("entry_{}", i));
+  }
+}
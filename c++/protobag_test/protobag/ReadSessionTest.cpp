@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <exception>
+#include <numeric>
 #include <vector>
 #include <unordered_map>
 
@@ -27,6 +28,7 @@ limitations under the License.
 #include "protobag/Utils/PBUtils.hpp"
 #include "protobag/Utils/StdMsgUtils.hpp"
 #include "protobag/ReadSession.hpp"
+#include "protobag/WriteSession.hpp"
 
 #include "protobag_test/Utils.hpp"
 
@@ -243,3 +245,508 @@ TEST(ReadSessionTest, DirectoryTestRawMessages) {
 
   ReadAllEntriesAndCheck(testdir, kExpectedEntries);
 }
+
+TEST(ReadSessionTest, TestReadEntryNotFoundNamesEntry) {
+  Selection sel;
+  sel.mutable_select_all();
+  auto rs = CreateInMemoryReadSession(
+    sel,
+    std::vector<Entry>{Entry::Create("/moof", ToStringMsg("moof"))});
+
+  auto maybe_entry = rs->ReadEntry("/does_not_exist");
+  ASSERT_TRUE(maybe_entry.IsNotFound()) << maybe_entry.error;
+  EXPECT_NE(maybe_entry.error.find("/does_not_exist"), std::string::npos)
+    << maybe_entry.error;
+}
+
+TEST(ReadSessionTest, TestFieldPredicates) {
+  std::vector<Entry> entries;
+  for (int i = 0; i < 10; ++i) {
+    TopicTime tt;
+    tt.set_topic(i % 2 == 0 ? "even" : "odd");
+    tt.mutable_timestamp()->set_seconds(i);
+    entries.push_back(Entry::CreateStamped("/tt", i, 0, tt));
+    entries.push_back(Entry::CreateStamped("/i", i, 0, ToIntMsg(i)));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto ReadWith = [&](
+      const std::string &topic,
+      const std::vector<FieldPredicate> &predicates) {
+    Selection sel;
+    sel.mutable_window()->add_topics(topic);
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {
+        .mode = "read",
+        .format = "memory",
+        .memory_archive = fixture,
+      },
+      .selection = sel,
+      .unpack_stamped_messages = true,
+      .predicates = predicates,
+    });
+    if (!maybe_rs.IsOk()) {
+      throw std::runtime_error(maybe_rs.error);
+    }
+    return *maybe_rs.value;
+  };
+
+  {
+    auto rs = ReadWith("/tt", {
+      {.field_path = "timestamp.seconds", .op = FieldPredicate::Op::GE, .value = 5},
+      {.field_path = "topic", .op = FieldPredicate::Op::EQ, .str_value = "even"},
+    });
+    std::vector<int64_t> actual;
+    while (true) {
+      auto maybe_entry = rs->GetNext();
+      if (maybe_entry.IsEndOfSequence()) { break; }
+      ASSERT_TRUE(maybe_entry.IsOk()) << maybe_entry.error;
+      
+      // Matches are unpacked
+      ASSERT_TRUE(maybe_entry.value->ctx.has_value());
+      EXPECT_EQ(maybe_entry.value->ctx->topic, "/tt");
+      auto maybe_tt = maybe_entry.value->GetAs<TopicTime>();
+      ASSERT_TRUE(maybe_tt.IsOk()) << maybe_tt.error;
+      actual.push_back(maybe_tt.value->timestamp().seconds());
+    }
+    EXPECT_EQ(actual, std::vector<int64_t>({6, 8}));
+  }
+
+  {
+    auto rs = ReadWith("/i", {
+      {
+        .field_path = "value",
+        .op = FieldPredicate::Op::BETWEEN,
+        .value = 2,
+        .upper = 3,
+      },
+    });
+    size_t n = 0;
+    while (true) {
+      auto maybe_entry = rs->GetNext();
+      if (maybe_entry.IsEndOfSequence()) { break; }
+      ASSERT_TRUE(maybe_entry.IsOk()) << maybe_entry.error;
+      auto maybe_i = maybe_entry.value->GetAs<StdMsg_Int>();
+      ASSERT_TRUE(maybe_i.IsOk()) << maybe_i.error;
+      EXPECT_TRUE(maybe_i.value->value() >= 2 && maybe_i.value->value() <= 3);
+      ++n;
+    }
+    EXPECT_EQ(n, 2);
+  }
+
+  {
+    // Can't compare a number to a string
+    auto rs = ReadWith("/i", {
+      {.field_path = "value", .op = FieldPredicate::Op::EQ, .str_value = "1"},
+    });
+    auto maybe_entry = rs->GetNext();
+    EXPECT_FALSE(maybe_entry.IsOk());
+  }
+
+  {
+    // A field path that the topic's type lacks (e.g. a typo) is an error
+    // rather than an empty result
+    auto rs = ReadWith("/i", {
+      {.field_path = "valeu", .op = FieldPredicate::Op::EQ, .value = 1},
+    });
+    auto maybe_entry = rs->GetNext();
+    ASSERT_FALSE(maybe_entry.IsOk());
+    EXPECT_FALSE(maybe_entry.IsEndOfSequence());
+    EXPECT_NE(maybe_entry.error.find("valeu"), std::string::npos)
+      << maybe_entry.error;
+  }
+}
+
+TEST(ReadSessionTest, TestFieldPredicatesCompareIntegersExactly) {
+  // Beyond 2^53, consecutive int64s share the same double
+  static const int64_t kBig = (int64_t(1) << 53) + 1;
+  
+  std::vector<Entry> entries;
+  for (int i = -1; i <= 1; ++i) {
+    TopicTime tt;
+    tt.mutable_timestamp()->set_seconds(kBig + i);
+    entries.push_back(Entry::CreateStamped("/tt", i + 1, 0, tt));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto ReadSeconds = [&](const FieldPredicate &pred) {
+    Selection sel;
+    sel.mutable_window()->add_topics("/tt");
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {
+        .mode = "read",
+        .format = "memory",
+        .memory_archive = fixture,
+      },
+      .selection = sel,
+      .unpack_stamped_messages = true,
+      .predicates = {pred},
+    });
+    if (!maybe_rs.IsOk()) {
+      throw std::runtime_error(maybe_rs.error);
+    }
+    std::vector<int64_t> seconds;
+    while (true) {
+      auto maybe_entry = (*maybe_rs.value)->GetNext();
+      if (maybe_entry.IsEndOfSequence()) { break; }
+      if (!maybe_entry.IsOk()) {
+        throw std::runtime_error(maybe_entry.error);
+      }
+      seconds.push_back(
+        maybe_entry.value->GetAs<TopicTime>().value->timestamp().seconds());
+    }
+    return seconds;
+  };
+
+  EXPECT_EQ(
+    ReadSeconds({
+      .field_path = "timestamp.seconds",
+      .op = FieldPredicate::Op::EQ,
+      .value = kBig,
+    }),
+    std::vector<int64_t>({kBig}));
+  EXPECT_EQ(
+    ReadSeconds({
+      .field_path = "timestamp.seconds",
+      .op = FieldPredicate::Op::GT,
+      .value = kBig - 1,
+    }),
+    std::vector<int64_t>({kBig, kBig + 1}));
+  EXPECT_EQ(
+    ReadSeconds({
+      .field_path = "timestamp.seconds",
+      .op = FieldPredicate::Op::BETWEEN,
+      .value = kBig,
+      .upper = uint64_t(kBig + 1),
+    }),
+    std::vector<int64_t>({kBig, kBig + 1}));
+
+  // Floating point operands still compare as doubles
+  EXPECT_EQ(
+    ReadSeconds({
+      .field_path = "timestamp.seconds",
+      .op = FieldPredicate::Op::LT,
+      .value = 1e300,
+    }).size(),
+    3);
+}
+
+TEST(ReadSessionTest, TestShards) {
+  std::vector<Entry> entries;
+  for (int i = 0; i < 10; ++i) {
+    entries.push_back(Entry::CreateStamped("/i", i, 0, ToIntMsg(i)));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto ReadShard = [&](size_t shard_index, size_t num_shards) {
+    Selection sel;
+    sel.mutable_window();
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {
+        .mode = "read",
+        .format = "memory",
+        .memory_archive = fixture,
+      },
+      .selection = sel,
+      .unpack_stamped_messages = true,
+      .shard_index = shard_index,
+      .num_shards = num_shards,
+    });
+    if (!maybe_rs.IsOk()) {
+      throw std::runtime_error(maybe_rs.error);
+    }
+
+    std::vector<int> values;
+    while (true) {
+      auto maybe_entry = (*maybe_rs.value)->GetNext();
+      if (maybe_entry.IsEndOfSequence()) { break; }
+      if (!maybe_entry.IsOk()) {
+        throw std::runtime_error(maybe_entry.error);
+      }
+      values.push_back(maybe_entry.value->GetAs<StdMsg_Int>().value->value());
+    }
+    return values;
+  };
+
+  EXPECT_EQ(ReadShard(0, 1), std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  EXPECT_EQ(ReadShard(0, 3), std::vector<int>({0, 1, 2}));
+  EXPECT_EQ(ReadShard(1, 3), std::vector<int>({3, 4, 5}));
+  EXPECT_EQ(ReadShard(2, 3), std::vector<int>({6, 7, 8, 9}));
+  EXPECT_EQ(ReadShard(11, 20), std::vector<int>({5}));
+  EXPECT_EQ(ReadShard(0, 20), std::vector<int>());
+
+  EXPECT_THROW(ReadShard(3, 3), std::runtime_error);
+}
+
+TEST(ReadSessionTest, TestShuffle) {
+  static const int kNumEntries = 50;
+
+  std::vector<Entry> entries;
+  for (int i = 0; i < kNumEntries; ++i) {
+    entries.push_back(Entry::CreateStamped("/i", i, 0, ToIntMsg(i)));
+  }
+
+  auto testdir = CreateTestTempdir("ReadSessionTest.TestShuffle");
+  const std::string path = (testdir / "bag.zip").string();
+  {
+    auto maybe_ws = WriteSession::Create({
+      .archive_spec = {.mode = "write", .path = path},
+    });
+    ASSERT_TRUE(maybe_ws.IsOk()) << maybe_ws.error;
+    for (const auto &entry : entries) {
+      auto status = (*maybe_ws.value)->WriteEntry(entry);
+      ASSERT_TRUE(status.IsOk()) << status.error;
+    }
+  }
+
+  auto ReadShuffled = [&](uint64_t seed) {
+    Selection sel;
+    sel.mutable_window();
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {.mode = "read", .path = path},
+      .selection = sel,
+      .unpack_stamped_messages = true,
+      .shuffle = ReadShuffleSpec{
+        .block_size = 4,
+        .buffer_size = 8,
+        .seed = seed,
+      },
+    });
+    if (!maybe_rs.IsOk()) {
+      throw std::runtime_error(maybe_rs.error);
+    }
+
+    std::vector<int> values;
+    while (true) {
+      auto maybe_entry = (*maybe_rs.value)->GetNext();
+      if (maybe_entry.IsEndOfSequence()) { break; }
+      if (!maybe_entry.IsOk()) {
+        throw std::runtime_error(maybe_entry.error);
+      }
+      values.push_back(maybe_entry.value->GetAs<StdMsg_Int>().value->value());
+    }
+    return values;
+  };
+
+  auto actual = ReadShuffled(1337);
+  EXPECT_EQ(actual, ReadShuffled(1337));
+  EXPECT_NE(actual, ReadShuffled(1338));
+
+  std::vector<int> expected(kNumEntries);
+  std::iota(expected.begin(), expected.end(), 0);
+  EXPECT_NE(actual, expected);
+  std::sort(actual.begin(), actual.end());
+  EXPECT_EQ(actual, expected);
+}
+
+TEST(ReadSessionTest, TestResumeFromCursor) {
+  static const int kNumEntries = 30;
+
+  auto testdir = CreateTestTempdir("ReadSessionTest.TestResumeFromCursor");
+  const std::string path = (testdir / "bag.zip").string();
+  {
+    auto maybe_ws = WriteSession::Create({
+      .archive_spec = {.mode = "write", .path = path},
+    });
+    ASSERT_TRUE(maybe_ws.IsOk()) << maybe_ws.error;
+    for (int i = 0; i < kNumEntries; ++i) {
+      auto status = (*maybe_ws.value)->WriteEntry(
+        Entry::CreateStamped("/i", i, 0, ToIntMsg(i)));
+      ASSERT_TRUE(status.IsOk()) << status.error;
+    }
+  }
+
+  auto ReadValues = [](ReadSession &rs, size_t max_entries) {
+    std::vector<int> values;
+    while (values.size() < max_entries) {
+      auto maybe_entry = rs.GetNext();
+      if (maybe_entry.IsEndOfSequence()) { break; }
+      if (!maybe_entry.IsOk()) {
+        throw std::runtime_error(maybe_entry.error);
+      }
+      values.push_back(maybe_entry.value->GetAs<StdMsg_Int>().value->value());
+    }
+    return values;
+  };
+
+  auto CheckResume = [&](const ReadSession::Spec &spec) {
+    auto maybe_expected = ReadSession::Create(spec);
+    ASSERT_TRUE(maybe_expected.IsOk()) << maybe_expected.error;
+    auto expected = ReadValues(**maybe_expected.value, kNumEntries);
+
+    auto maybe_rs = ReadSession::Create(spec);
+    ASSERT_TRUE(maybe_rs.IsOk()) << maybe_rs.error;
+    auto actual = ReadValues(**maybe_rs.value, 13);
+    auto maybe_cursor = (*maybe_rs.value)->GetCursor();
+    ASSERT_TRUE(maybe_cursor.IsOk()) << maybe_cursor.error;
+
+    // Resume from the cursor alone; it carries the selection
+    auto maybe_resumed = ReadSession::Create({
+      .archive_spec = {.mode = "read", .path = path},
+      .unpack_stamped_messages = true,
+      .resume_cursor = *maybe_cursor.value,
+    });
+    ASSERT_TRUE(maybe_resumed.IsOk()) << maybe_resumed.error;
+    auto rest = ReadValues(**maybe_resumed.value, kNumEntries);
+    actual.insert(actual.end(), rest.begin(), rest.end());
+    EXPECT_EQ(actual, expected);
+  };
+
+  Selection sel;
+  sel.mutable_window();
+  CheckResume({
+    .archive_spec = {.mode = "read", .path = path},
+    .selection = sel,
+    .unpack_stamped_messages = true,
+  });
+  CheckResume({
+    .archive_spec = {.mode = "read", .path = path},
+    .selection = sel,
+    .unpack_stamped_messages = true,
+    .shard_index = 1,
+    .num_shards = 2,
+  });
+  CheckResume({
+    .archive_spec = {.mode = "read", .path = path},
+    .selection = sel,
+    .unpack_stamped_messages = true,
+    .shuffle = ReadShuffleSpec{
+      .block_size = 4,
+      .buffer_size = 8,
+      .seed = 1337,
+    },
+  });
+
+  {
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {.mode = "read", .path = path},
+      .resume_cursor = "not a cursor",
+    });
+    EXPECT_FALSE(maybe_rs.IsOk());
+  }
+}
+
+TEST(ReadSessionTest, TestArena) {
+  std::vector<Entry> entries = {
+    Entry::Create("/moof", ToStringMsg("moof")),
+    Entry::CreateRawFromBytes("/i_am_raw", "i am raw data"),
+  };
+  for (int i = 0; i < 100; ++i) {
+    entries.push_back(Entry::CreateStamped("/i", i, 1, ToIntMsg(i)));
+    entries.push_back(Entry::CreateStamped(
+      "/s", i, 2, ToStringMsg(std::string(i * 100, 's'))));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto ReadAll = [&](bool use_arena) {
+    Selection sel;
+    sel.mutable_select_all();
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {
+        .mode = "read",
+        .format = "memory",
+        .memory_archive = fixture,
+      },
+      .selection = sel,
+      .unpack_stamped_messages = true,
+      .use_arena = use_arena,
+    });
+    if (!maybe_rs.IsOk()) {
+      throw std::runtime_error(maybe_rs.error);
+    }
+
+    std::vector<Entry> actual;
+    while (true) {
+      auto maybe_entry = (*maybe_rs.value)->GetNext();
+      if (maybe_entry.IsEndOfSequence()) { break; }
+      if (!maybe_entry.IsOk()) {
+        throw std::runtime_error(maybe_entry.error);
+      }
+      actual.push_back(std::move(*maybe_entry.value));
+    }
+    return actual;
+  };
+
+  auto expected = ReadAll(false);
+  auto actual = ReadAll(true);
+  ASSERT_EQ(expected.size(), actual.size());
+  ASSERT_EQ(expected.size(), entries.size() + 1); // Includes the index
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_TRUE(expected[i].EntryDataEqualTo(actual[i])) << 
+      expected[i].ToString() << " vs " << actual[i].ToString();
+    ASSERT_EQ(expected[i].ctx.has_value(), actual[i].ctx.has_value());
+    if (expected[i].ctx.has_value()) {
+      EXPECT_EQ(expected[i].ctx->topic, actual[i].ctx->topic);
+      EXPECT_EQ(
+        expected[i].ctx->stamp.SerializeAsString(),
+        actual[i].ctx->stamp.SerializeAsString());
+      EXPECT_EQ(expected[i].ctx->inner_type_url, actual[i].ctx->inner_type_url);
+    }
+  }
+}
+
+TEST(ReadSessionTest, TestIterate) {
+  std::vector<Entry> entries;
+  for (int i = 0; i < 10; ++i) {
+    entries.push_back(Entry::CreateStamped("/i", i, 0, ToIntMsg(i)));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto CreateSession = [&](const Selection &sel) {
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {
+        .mode = "read",
+        .format = "memory",
+        .memory_archive = fixture,
+      },
+      .selection = sel,
+      .unpack_stamped_messages = true,
+    });
+    if (!maybe_rs.IsOk()) {
+      throw std::runtime_error(maybe_rs.error);
+    }
+    return *maybe_rs.value;
+  };
+
+  {
+    Selection sel;
+    sel.mutable_window();
+    auto rs = CreateSession(sel);
+    std::vector<int> values;
+    for (const Entry &entry : *rs) {
+      values.push_back(entry.GetAs<StdMsg_Int>().value->value());
+    }
+    EXPECT_TRUE(rs->GetIterationStatus().IsOk());
+    EXPECT_EQ(values, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  }
+
+  // Skip lots of missing entries (without recursing)
+  {
+    Selection sel;
+    auto *entrynames = sel.mutable_entrynames();
+    for (int i = 0; i < 100000; ++i) {
+      entrynames->add_entrynames("/does-not-exist/" + std::to_string(i));
+    }
+    entrynames->add_entrynames(fixture->GetNamelist()[0]);
+    entrynames->set_ignore_missing_entries(true);
+    auto rs = CreateSession(sel);
+    size_t n = 0;
+    for (const Entry &entry : *rs) {
+      EXPECT_EQ(entry.entryname, fixture->GetNamelist()[0]);
+      ++n;
+    }
+    EXPECT_EQ(n, 1);
+    EXPECT_TRUE(rs->GetIterationStatus().IsOk());
+  }
+
+  // Errors stop iteration
+  {
+    Selection sel;
+    sel.mutable_entrynames()->add_entrynames("/does-not-exist");
+    auto rs = CreateSession(sel);
+    size_t n = 0;
+    for (auto it = rs->begin(); it != rs->end(); ++it) { ++n; }
+    EXPECT_EQ(n, 0);
+    EXPECT_FALSE(rs->GetIterationStatus().IsOk());
+  }
+}
@@ -0,0 +1,364 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <list>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "protobag/Entry.hpp"
+#include "protobag/ReadSession.hpp"
+#include "protobag/SharedScan.hpp"
+#include "protobag/WriteSession.hpp"
+#include "protobag/Utils/PBUtils.hpp"
+#include "protobag/Utils/StdMsgUtils.hpp"
+#include "protobag/Utils/TimeSync.hpp"
+
+#include "protobag_test/Utils.hpp"
+
+using namespace protobag;
+using namespace protobag_test;
+
+namespace {
+
+std::list<Entry> CreateFixtureEntries() {
+  std::list<Entry> entries;
+  for (int i = 0; i < 10; ++i) {
+    entries.push_back(Entry::CreateStamped("/t1", i, 0, ToIntMsg(i)));
+    entries.push_back(Entry::CreateStamped("/t2", i, 1000, ToIntMsg(10 * i)));
+  }
+  entries.push_back(Entry::Create("/moof", ToStringMsg("moof")));
+  return entries;
+}
+
+Selection WindowSelection(const std::vector<std::string> &topics) {
+  Selection sel;
+  auto *window = sel.mutable_window();
+  for (const auto &topic : topics) {
+    window->add_topics(topic);
+  }
+  return sel;
+}
+
+std::vector<std::string> ReadAllNames(ReadSession &rs) {
+  std::vector<std::string> names;
+  while (true) {
+    auto maybe_next = rs.GetNext();
+    if (maybe_next.IsEndOfSequence()) {
+      break;
+    }
+    EXPECT_TRUE(maybe_next.IsOk()) << maybe_next.error;
+    if (!maybe_next.IsOk()) {
+      break;
+    }
+    names.push_back(maybe_next.value->entryname);
+  }
+  return names;
+}
+
+std::vector<std::string> ReadAllNamesStandalone(
+    const std::shared_ptr<archive::MemoryArchive> &fixture,
+    const Selection &sel) {
+
+  auto maybe_rs = ReadSession::Create({
+    .archive_spec = MemorySpec(fixture),
+    .selection = sel,
+    .unpack_stamped_messages = true,
+  });
+  if (!maybe_rs.IsOk()) { throw std::runtime_error(maybe_rs.error); }
+  return ReadAllNames(**maybe_rs.value);
+}
+
+} // anon namespace
+
+TEST(SharedScanTest, TestSessionsAndCallbacks) {
+  auto fixture = CreateMemoryArchive(CreateFixtureEntries());
+
+  auto maybe_scan = SharedScan::Create({
+    .archive_spec = MemorySpec(fixture),
+  });
+  ASSERT_TRUE(maybe_scan.IsOk()) << maybe_scan.error;
+  auto scan = *maybe_scan.value;
+
+  auto maybe_rs1 = scan->AddSession(WindowSelection({"/t1"}));
+  ASSERT_TRUE(maybe_rs1.IsOk()) << maybe_rs1.error;
+  auto maybe_rs2 = scan->AddSession(WindowSelection({"/t2"}));
+  ASSERT_TRUE(maybe_rs2.IsOk()) << maybe_rs2.error;
+
+  std::vector<std::string> callback_names;
+  {
+    Selection sel;
+    sel.mutable_entrynames()->add_entrynames("/moof");
+    auto status = scan->AddCallback(sel, [&](const Entry &entry) {
+      callback_names.push_back(entry.entryname);
+    });
+    ASSERT_TRUE(status.IsOk()) << status.error;
+  }
+
+  // Read sessions in lockstep
+  std::vector<std::string> actual1, actual2;
+  bool reading = true;
+  while (reading) {
+    reading = false;
+    for (auto p : {
+          std::make_pair(maybe_rs1.value->get(), &actual1),
+          std::make_pair(maybe_rs2.value->get(), &actual2)}) {
+      auto maybe_next = p.first->GetNext();
+      if (maybe_next.IsOk()) {
+        p.second->push_back(maybe_next.value->entryname);
+        reading = true;
+      } else {
+        ASSERT_TRUE(maybe_next.IsEndOfSequence()) << maybe_next.error;
+      }
+    }
+  }
+
+  EXPECT_SEQUENCES_EQUAL(
+    ReadAllNamesStandalone(fixture, WindowSelection({"/t1"})), actual1);
+  EXPECT_SEQUENCES_EQUAL(
+    ReadAllNamesStandalone(fixture, WindowSelection({"/t2"})), actual2);
+  EXPECT_EQ(actual1.size(), 10);
+  EXPECT_EQ(actual2.size(), 10);
+  EXPECT_SEQUENCES_EQUAL(std::vector<std::string>{"/moof"}, callback_names);
+
+  // Too late to add more consumers
+  EXPECT_FALSE(scan->AddSession(WindowSelection({"/t1"})).IsOk());
+}
+
+TEST(SharedScanTest, TestSyncOnSharedSession) {
+  auto fixture = CreateMemoryArchive(CreateFixtureEntries());
+  const MaxSlopTimeSync::Spec sync_spec = {
+    .topics = {"/t1", "/t2"},
+    .max_slop = SecondsToDuration(0.5),
+  };
+
+  auto ConsumeBundleNames = [](TimeSync &sync) {
+    std::vector<std::string> names;
+    while (true) {
+      auto maybe_bundle = sync.GetNext();
+      if (maybe_bundle.IsEndOfSequence()) {
+        break;
+      }
+      EXPECT_TRUE(maybe_bundle.IsOk()) << maybe_bundle.error;
+      if (!maybe_bundle.IsOk()) {
+        break;
+      }
+      for (const auto &entry : *maybe_bundle.value) {
+        names.push_back(entry.entryname);
+      }
+    }
+    return names;
+  };
+
+  std::vector<std::string> expected;
+  {
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = MemorySpec(fixture),
+      .selection = WindowSelection({}),
+      .unpack_stamped_messages = true,
+    });
+    ASSERT_TRUE(maybe_rs.IsOk()) << maybe_rs.error;
+    auto maybe_sync = MaxSlopTimeSync::Create(*maybe_rs.value, sync_spec);
+    ASSERT_TRUE(maybe_sync.IsOk()) << maybe_sync.error;
+    expected = ConsumeBundleNames(**maybe_sync.value);
+  }
+
+  auto maybe_scan = SharedScan::Create({
+    .archive_spec = MemorySpec(fixture),
+  });
+  ASSERT_TRUE(maybe_scan.IsOk()) << maybe_scan.error;
+  auto scan = *maybe_scan.value;
+
+  auto maybe_rs = scan->AddSession(WindowSelection({}));
+  ASSERT_TRUE(maybe_rs.IsOk()) << maybe_rs.error;
+  size_t n_seen = 0;
+  {
+    auto status = scan->AddCallback(
+      WindowSelection({}), [&](const Entry &entry) { ++n_seen; });
+    ASSERT_TRUE(status.IsOk()) << status.error;
+  }
+
+  auto maybe_sync = MaxSlopTimeSync::Create(*maybe_rs.value, sync_spec);
+  ASSERT_TRUE(maybe_sync.IsOk()) << maybe_sync.error;
+  auto actual = ConsumeBundleNames(**maybe_sync.value);
+
+  EXPECT_EQ(expected.size(), 20);
+  EXPECT_SEQUENCES_EQUAL(expected, actual);
+  EXPECT_EQ(n_seen, 20);
+}
+
+TEST(SharedScanTest, TestQueueOverflow) {
+  auto fixture = CreateMemoryArchive(CreateFixtureEntries());
+
+  auto maybe_scan = SharedScan::Create({
+    .archive_spec = MemorySpec(fixture),
+    .max_queue_size = 2,
+  });
+  ASSERT_TRUE(maybe_scan.IsOk()) << maybe_scan.error;
+  auto scan = *maybe_scan.value;
+
+  auto maybe_rs1 = scan->AddSession(WindowSelection({"/t1"}));
+  ASSERT_TRUE(maybe_rs1.IsOk()) << maybe_rs1.error;
+  auto maybe_rs2 = scan->AddSession(WindowSelection({"/t2"}));
+  ASSERT_TRUE(maybe_rs2.IsOk()) << maybe_rs2.error;
+
+  // Reading only the first session eventually fills the second's queue
+  auto &rs1 = **maybe_rs1.value;
+  bool overflowed = false;
+  for (int i = 0; i < 10 && !overflowed; ++i) {
+    auto maybe_next = rs1.GetNext();
+    overflowed = !maybe_next.IsOk();
+  }
+  EXPECT_TRUE(overflowed);
+}
+
+TEST(SharedScanTest, TestQueueOverflowLosesNoEntries) {
+  auto fixture = CreateMemoryArchive(CreateFixtureEntries());
+
+  auto maybe_scan = SharedScan::Create({
+    .archive_spec = MemorySpec(fixture),
+    .max_queue_size = 2,
+  });
+  ASSERT_TRUE(maybe_scan.IsOk()) << maybe_scan.error;
+  auto scan = *maybe_scan.value;
+
+  auto maybe_rs1 = scan->AddSession(WindowSelection({"/t1"}));
+  ASSERT_TRUE(maybe_rs1.IsOk()) << maybe_rs1.error;
+  auto maybe_rs2 = scan->AddSession(WindowSelection({"/t2"}));
+  ASSERT_TRUE(maybe_rs2.IsOk()) << maybe_rs2.error;
+  auto &rs1 = **maybe_rs1.value;
+  auto &rs2 = **maybe_rs2.value;
+
+  // Read only the first session until the second's queue overflows
+  std::vector<std::string> names1, names2;
+  bool overflowed = false;
+  for (int i = 0; i < 10 && !overflowed; ++i) {
+    auto maybe_next = rs1.GetNext();
+    if (maybe_next.IsOk()) {
+      names1.push_back(maybe_next.value->entryname);
+    } else {
+      overflowed = true;
+    }
+  }
+  ASSERT_TRUE(overflowed);
+
+  // Drain the full session ...
+  for (int i = 0; i < 2; ++i) {
+    auto maybe_next = rs2.GetNext();
+    ASSERT_TRUE(maybe_next.IsOk()) << maybe_next.error;
+    names2.push_back(maybe_next.value->entryname);
+  }
+
+  // ... then read both in lockstep; the scan should resume with the entry
+  // that overflowed
+  bool done1 = false, done2 = false;
+  while (!done1 || !done2) {
+    for (auto [rs, names, done] : {
+            std::make_tuple(&rs1, &names1, &done1),
+            std::make_tuple(&rs2, &names2, &done2)}) {
+      if (*done) { continue; }
+      auto maybe_next = rs->GetNext();
+      if (maybe_next.IsEndOfSequence()) {
+        *done = true;
+        continue;
+      }
+      ASSERT_TRUE(maybe_next.IsOk()) << maybe_next.error;
+      names->push_back(maybe_next.value->entryname);
+    }
+  }
+
+  auto expected1 = ReadAllNamesStandalone(fixture, WindowSelection({"/t1"}));
+  auto expected2 = ReadAllNamesStandalone(fixture, WindowSelection({"/t2"}));
+  EXPECT_EQ(expected1.size(), 10);
+  EXPECT_EQ(expected2.size(), 10);
+  EXPECT_SEQUENCES_EQUAL(expected1, names1);
+  EXPECT_SEQUENCES_EQUAL(expected2, names2);
+}
+
+TEST(SharedScanTest, TestDroppedSessionDoesNotOverflow) {
+  auto fixture = CreateMemoryArchive(CreateFixtureEntries());
+
+  auto maybe_scan = SharedScan::Create({
+    .archive_spec = MemorySpec(fixture),
+    .max_queue_size = 2,
+  });
+  ASSERT_TRUE(maybe_scan.IsOk()) << maybe_scan.error;
+  auto scan = *maybe_scan.value;
+
+  auto maybe_rs1 = scan->AddSession(WindowSelection({"/t1"}));
+  ASSERT_TRUE(maybe_rs1.IsOk()) << maybe_rs1.error;
+  {
+    auto maybe_rs2 = scan->AddSession(WindowSelection({"/t2"}));
+    ASSERT_TRUE(maybe_rs2.IsOk()) << maybe_rs2.error;
+
+    // Start the scan, then drop the second session
+    auto maybe_next = (*maybe_rs1.value)->GetNext();
+    ASSERT_TRUE(maybe_next.IsOk()) << maybe_next.error;
+  }
+
+  auto names = ReadAllNames(**maybe_rs1.value);
+  EXPECT_EQ(names.size(), 9);
+}
+
+TEST(SharedScanTest, TestSinglePassOverZip) {
+  auto testdir = CreateTestTempdir("SharedScanTest.TestSinglePassOverZip");
+  const std::string path = testdir / "bag.zip";
+  {
+    auto maybe_w = WriteSession::Create({
+      .archive_spec = {
+        .mode = "write",
+        .path = path,
+        .format = "zip",
+      },
+    });
+    ASSERT_TRUE(maybe_w.IsOk()) << maybe_w.error;
+    for (const auto &entry : CreateFixtureEntries()) {
+      auto status = (*maybe_w.value)->WriteEntry(entry);
+      ASSERT_TRUE(status.IsOk()) << status.error;
+    }
+  }
+
+  auto maybe_scan = SharedScan::Create({
+    .archive_spec = {
+      .mode = "read",
+      .path = path,
+      .format = "zip",
+    },
+  });
+  ASSERT_TRUE(maybe_scan.IsOk()) << maybe_scan.error;
+  auto scan = *maybe_scan.value;
+
+  std::vector<std::string> names;
+  for (const std::string topic : {"/t1", "/t2"}) {
+    auto status = scan->AddCallback(
+      WindowSelection({topic}),
+      [&](const Entry &entry) { names.push_back(entry.entryname); });
+    ASSERT_TRUE(status.IsOk()) << status.error;
+  }
+
+  ReadPassCounter pass_counter;
+  auto status = scan->Run();
+  ASSERT_TRUE(status.IsOk()) << status.error;
+  const size_t passes = pass_counter.Get();
+
+  EXPECT_EQ(names.size(), 20);
+
+  // Planning the scan reads the index and namelist, and then all 20 entries
+  // come from a single forward pass (rather than one pass per entry)
+  EXPECT_LE(passes, 4) << passes;
+}
@@ -0,0 +1,134 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "protobag/Entry.hpp"
+#include "protobag/TypedReader.hpp"
+#include "protobag/Utils/StdMsgUtils.hpp"
+#include "protobag/Utils/WireScan.hpp"
+
+#include "protobag_test/Utils.hpp"
+
+using namespace protobag;
+using namespace protobag_test;
+
+TEST(TypedReaderTest, TestScanStampedMessage) {
+  auto entry = Entry::CreateStamped("/s", 3, 4, ToStringMsg("foo"));
+  auto maybe_bytes = PBFactory::ToBinaryString(entry.msg);
+  ASSERT_TRUE(maybe_bytes.IsOk()) << maybe_bytes.error;
+
+  AnyView any;
+  ASSERT_TRUE(ScanAny(*maybe_bytes.value, any));
+  EXPECT_EQ(any.type_url, GetTypeURL<StampedMessage>());
+
+  StampedMessageView stamped;
+  ASSERT_TRUE(ScanStampedMessage(any.value, stamped));
+  EXPECT_EQ(stamped.msg.type_url, GetTypeURL<StdMsg_String>());
+  EXPECT_EQ(stamped.msg.value, ToStringMsg("foo").SerializeAsString());
+
+  ::google::protobuf::Timestamp t;
+  ASSERT_TRUE(t.ParseFromArray(
+    stamped.timestamp.data(), int(stamped.timestamp.size())));
+  EXPECT_EQ(t.seconds(), 3);
+  EXPECT_EQ(t.nanos(), 4);
+
+  EXPECT_FALSE(ScanAny(maybe_bytes.value->substr(0, 10), any));
+}
+
+TEST(TypedReaderTest, TestReadStamped) {
+  std::vector<Entry> entries;
+  for (int i = 0; i < 10; ++i) {
+    entries.push_back(Entry::CreateStamped("/i", i, 1, ToIntMsg(i)));
+    entries.push_back(Entry::CreateStamped("/s", i, 1, ToStringMsg("foo")));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto CreateReader = [&](const std::string &topic) {
+    Selection sel;
+    sel.mutable_window()->add_topics(topic);
+    return TypedReader<StdMsg_Int>::Create({
+      .archive_spec = {
+        .mode = "read",
+        .format = "memory",
+        .memory_archive = fixture,
+      },
+      .selection = sel,
+    });
+  };
+
+  {
+    auto maybe_r = CreateReader("/i");
+    ASSERT_TRUE(maybe_r.IsOk()) << maybe_r.error;
+    auto &reader = **maybe_r.value;
+
+    std::vector<int> values;
+    const StdMsg_Int *last = nullptr;
+    while (true) {
+      auto maybe_msg = reader.GetNext();
+      ASSERT_TRUE(maybe_msg.IsOk()) << maybe_msg.error;
+      const StdMsg_Int *msg = *maybe_msg.value;
+      if (!msg) { break; }
+
+      // The message instance is reused
+      if (last) { EXPECT_EQ(msg, last); }
+      last = msg;
+
+      EXPECT_EQ(reader.GetStamp().seconds(), msg->value());
+      EXPECT_EQ(reader.GetStamp().nanos(), 1);
+      EXPECT_EQ(GetTopicFromEntryname(reader.GetEntryname()), "/i");
+      values.push_back(msg->value());
+    }
+    EXPECT_EQ(values, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  }
+
+  {
+    auto maybe_r = CreateReader("/s");
+    ASSERT_TRUE(maybe_r.IsOk()) << maybe_r.error;
+    auto maybe_msg = (*maybe_r.value)->GetNext();
+    EXPECT_FALSE(maybe_msg.IsOk());
+  }
+}
+
+TEST(TypedReaderTest, TestReadRaw) {
+  auto fixture = CreateMemoryArchive(std::vector<Entry>{
+    *Entry::CreateRaw("/raw", ToIntMsg(1337)).value,
+  });
+
+  Selection sel;
+  sel.mutable_entrynames()->add_entrynames("/raw");
+  sel.mutable_entrynames()->set_entries_are_raw(true);
+  auto maybe_r = TypedReader<StdMsg_Int>::Create({
+    .archive_spec = {
+      .mode = "read",
+      .format = "memory",
+      .memory_archive = fixture,
+    },
+    .selection = sel,
+  });
+  ASSERT_TRUE(maybe_r.IsOk()) << maybe_r.error;
+
+  auto maybe_msg = (*maybe_r.value)->GetNext();
+  ASSERT_TRUE(maybe_msg.IsOk()) << maybe_msg.error;
+  ASSERT_TRUE(*maybe_msg.value);
+  EXPECT_EQ((*maybe_msg.value)->value(), 1337);
+
+  maybe_msg = (*maybe_r.value)->GetNext();
+  ASSERT_TRUE(maybe_msg.IsOk()) << maybe_msg.error;
+  EXPECT_FALSE(*maybe_msg.value);
+}
@@ -18,6 +18,8 @@ limitations under the License.
 #include "gtest/gtest.h"
 
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "protobag/Utils/PBUtils.hpp"
 #include "protobag_msg/ProtobagMsg.pb.h"
@@ -148,6 +150,9 @@ TEST(PBUtilsTest, TestDynamicMsgFactoryBasic) {
         kTestDynamicMsgFactoryBasic_FileDescriptorProto_Prototxt);
     ASSERT_TRUE(maybe_fd_msg.IsOk()) << maybe_fd_msg.error;
     factory.RegisterType(*maybe_fd_msg.value);
+
+    // Registering the same file again is a no-op
+    factory.RegisterType(*maybe_fd_msg.value);
   }
 
   EXPECT_EQ(factory.ToString(), kTestDynamicMsgFactoryBasicExpectedStr);
@@ -249,3 +254,338 @@ TEST(PBUtilsTest, TestDynamicMsgFactoryBasic) {
   }
 
 }
+
+TEST(PBUtilsTest, TestDynamicMsgFactoryReuse) {
+  DynamicMsgFactory factory;
+
+  {
+    auto maybe_fd_msg = 
+      PBFactory::LoadFromContainer<::google::protobuf::FileDescriptorProto>(
+        kTestDynamicMsgFactoryBasic_FileDescriptorProto_Prototxt);
+    ASSERT_TRUE(maybe_fd_msg.IsOk()) << maybe_fd_msg.error;
+    factory.RegisterType(*maybe_fd_msg.value);
+  }
+
+  // Prototypes are cached
+  {
+    auto maybe_p1 = factory.GetPrototype("type.googleapis.com/my_package.Moof");
+    ASSERT_TRUE(maybe_p1.IsOk()) << maybe_p1.error;
+    auto maybe_p2 = factory.GetPrototype("type.googleapis.com/my_package.Moof");
+    ASSERT_TRUE(maybe_p2.IsOk()) << maybe_p2.error;
+    EXPECT_EQ(*maybe_p1.value, *maybe_p2.value);
+
+    auto maybe_p3 = factory.GetPrototype("my_package.DoesNotExist");
+    ASSERT_FALSE(maybe_p3.IsOk());
+    EXPECT_EQ(maybe_p3.error, "Could not resolve type my_package.DoesNotExist");
+  }
+
+  // Decode into a re-used message instance
+  std::unique_ptr<::google::protobuf::Message> msgp;
+  {
+    auto res = factory.LoadFromContainer(
+      "my_package.Moof", kTestDynamicMsgFactoryBasic_Msg_Prototxt, msgp);
+    ASSERT_TRUE(res.IsOk()) << res.error;
+    ASSERT_TRUE(msgp);
+    EXPECT_EQ(msgp->GetTypeName(), "my_package.Moof");
+    EXPECT_EQ(*GetDeep_int64(msgp.get(), "inner.inner_v").value, 1337);
+  }
+
+  const ::google::protobuf::Message *first_instance = msgp.get();
+  {
+    std::string moof_bytes;
+    {
+      auto maybe_p = factory.GetPrototype("my_package.Moof");
+      ASSERT_TRUE(maybe_p.IsOk()) << maybe_p.error;
+      std::unique_ptr<::google::protobuf::Message> m((*maybe_p.value)->New());
+      m->GetReflection()->SetString(
+        m.get(), m->GetDescriptor()->FindFieldByName("x"), "moof");
+      moof_bytes = m->SerializeAsString();
+    }
+
+    auto res = factory.LoadFromContainer("my_package.Moof", moof_bytes, msgp);
+    ASSERT_TRUE(res.IsOk()) << res.error;
+    EXPECT_EQ(msgp.get(), first_instance);
+    EXPECT_EQ(*GetDeep_string(msgp.get(), "x").value, "moof");
+
+    // Previous contents are cleared
+    EXPECT_EQ(*GetDeep_int64(msgp.get(), "inner.inner_v").value, 0);
+  }
+
+  // A message of a different type gets replaced
+  {
+    msgp.reset(new StdMsg_String());
+    auto res = factory.LoadFromContainer(
+      "my_package.Moof", kTestDynamicMsgFactoryBasic_Msg_Prototxt, msgp);
+    ASSERT_TRUE(res.IsOk()) << res.error;
+    EXPECT_EQ(msgp->GetTypeName(), "my_package.Moof");
+  }
+}
+
+TEST(PBUtilsTest, TestDynamicMsgFactoryConcurrentDecode) {
+  DynamicMsgFactory factory;
+
+  {
+    auto maybe_fd_msg = 
+      PBFactory::LoadFromContainer<::google::protobuf::FileDescriptorProto>(
+        kTestDynamicMsgFactoryBasic_FileDescriptorProto_Prototxt);
+    ASSERT_TRUE(maybe_fd_msg.IsOk()) << maybe_fd_msg.error;
+    factory.RegisterType(*maybe_fd_msg.value);
+  }
+
+  static const size_t kNumThreads = 8;
+  static const size_t kNumDecodes = 500;
+  std::vector<size_t> thread_num_ok(kNumThreads, 0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      std::unique_ptr<::google::protobuf::Message> msgp;
+      for (size_t i = 0; i < kNumDecodes; ++i) {
+        auto res = factory.LoadFromContainer(
+          "my_package.Moof", kTestDynamicMsgFactoryBasic_Msg_Prototxt, msgp);
+        if (res.IsOk()) {
+          auto maybe_v = GetDeep_int64(msgp.get(), "inner.inner_v");
+          if (maybe_v.IsOk() && *maybe_v.value == 1337) {
+            thread_num_ok[t]++;
+          }
+        }
+      }
+    });
+  }
+
+  // Register more types while decoding
+  for (size_t i = 0; i < 10; ++i) {
+    ::google::protobuf::FileDescriptorProto fd;
+    fd.set_name(fmt::format("other_{}.proto", i));
+    fd.set_package("other_package");
+    fd.add_message_type()->set_name(fmt::format("Other{}", i));
+    factory.RegisterType(fd);
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (size_t t = 0; t < kNumThreads; ++t) {
+    EXPECT_EQ(thread_num_ok[t], kNumDecodes) << "thread " << t;
+  }
+
+  auto maybe_p = factory.GetPrototype("other_package.Other9");
+  EXPECT_TRUE(maybe_p.IsOk()) << maybe_p.error;
+}
+
+static const std::string kTestCompiledFieldPath_FileDescriptorProto_Prototxt = 
+R"(name: "scene.proto"
+package: "my_package"
+message_type {
+  name: "Scene"
+  field {
+    name: "points"
+    number: 1
+    label: LABEL_REPEATED
+    type: TYPE_MESSAGE
+    type_name: ".my_package.Scene.Point"
+  }
+  field {
+    name: "counts"
+    number: 2
+    label: LABEL_REPEATED
+    type: TYPE_MESSAGE
+    type_name: ".my_package.Scene.CountsEntry"
+  }
+  field {
+    name: "kind"
+    number: 3
+    label: LABEL_OPTIONAL
+    type: TYPE_ENUM
+    type_name: ".my_package.Scene.Kind"
+  }
+  field {
+    name: "ids"
+    number: 4
+    label: LABEL_REPEATED
+    type: TYPE_INT32
+  }
+  field {
+    name: "point_by_id"
+    number: 5
+    label: LABEL_REPEATED
+    type: TYPE_MESSAGE
+    type_name: ".my_package.Scene.PointByIdEntry"
+  }
+  nested_type {
+    name: "Point"
+    field {
+      name: "x"
+      number: 1
+      label: LABEL_OPTIONAL
+      type: TYPE_FLOAT
+    }
+  }
+  nested_type {
+    name: "CountsEntry"
+    field {
+      name: "key"
+      number: 1
+      label: LABEL_OPTIONAL
+      type: TYPE_STRING
+    }
+    field {
+      name: "value"
+      number: 2
+      label: LABEL_OPTIONAL
+      type: TYPE_INT64
+    }
+    options {
+      map_entry: true
+    }
+  }
+  nested_type {
+    name: "PointByIdEntry"
+    field {
+      name: "key"
+      number: 1
+      label: LABEL_OPTIONAL
+      type: TYPE_INT32
+    }
+    field {
+      name: "value"
+      number: 2
+      label: LABEL_OPTIONAL
+      type: TYPE_MESSAGE
+      type_name: ".my_package.Scene.Point"
+    }
+    options {
+      map_entry: true
+    }
+  }
+  enum_type {
+    name: "Kind"
+    value {
+      name: "UNKNOWN"
+      number: 0
+    }
+    value {
+      name: "CAR"
+      number: 1
+    }
+  }
+}
+syntax: "proto3"
+)";
+
+static const std::string kTestCompiledFieldPath_Msg_Prototxt = 
+R"(points { x: 1 }
+points { x: 3 }
+counts { key: "car" value: 5 }
+counts { key: "ped" value: 7 }
+kind: CAR
+ids: 10
+ids: 20
+point_by_id { key: -3 value { x: 9 } }
+)";
+
+TEST(PBUtilsTest, TestCompiledFieldPath) {
+  DynamicMsgFactory factory;
+  {
+    auto maybe_fd_msg = 
+      PBFactory::LoadFromContainer<::google::protobuf::FileDescriptorProto>(
+        kTestCompiledFieldPath_FileDescriptorProto_Prototxt);
+    ASSERT_TRUE(maybe_fd_msg.IsOk()) << maybe_fd_msg.error;
+    factory.RegisterType(*maybe_fd_msg.value);
+  }
+
+  auto maybe_prototype = factory.GetPrototype("my_package.Scene");
+  ASSERT_TRUE(maybe_prototype.IsOk()) << maybe_prototype.error;
+  std::unique_ptr<::google::protobuf::Message> msgp(
+    (*maybe_prototype.value)->New());
+  ASSERT_TRUE(
+    ::google::protobuf::TextFormat::ParseFromString(
+      kTestCompiledFieldPath_Msg_Prototxt, msgp.get()));
+  
+  const auto *descriptor = msgp->GetDescriptor();
+  auto Compile = [&](const std::string &path) {
+    auto maybe_cfp = CompiledFieldPath::Compile(descriptor, path);
+    if (!maybe_cfp.IsOk()) { throw std::runtime_error(maybe_cfp.error); }
+    return *maybe_cfp.value;
+  };
+
+  // Repeated
+  EXPECT_EQ(*Compile("points[1].x").Get_float(msgp.get()).value, 3);
+  EXPECT_EQ(*Compile("ids[0]").Get_int32(msgp.get()).value, 10);
+  EXPECT_EQ(*Compile("ids[1]").Get_as_double(msgp.get()).value, 20);
+  {
+    auto maybe_v = Compile("ids[2]").Get_int32(msgp.get());
+    ASSERT_FALSE(maybe_v.IsOk());
+    EXPECT_EQ(
+      maybe_v.error,
+      "Index 2 out of range for field ids of my_package.Scene (size 2)");
+  }
+
+  // Maps
+  EXPECT_EQ(*Compile("counts[ped]").Get_int64(msgp.get()).value, 7);
+  EXPECT_EQ(*Compile("point_by_id[-3].x").Get_float(msgp.get()).value, 9);
+  {
+    auto maybe_v = Compile("counts[bike]").Get_int64(msgp.get());
+    ASSERT_FALSE(maybe_v.IsOk());
+    EXPECT_EQ(maybe_v.error, "Map counts of my_package.Scene has no key bike");
+  }
+
+  // Enums
+  EXPECT_EQ(*Compile("kind").Get_int32(msgp.get()).value, 1);
+  EXPECT_EQ(*Compile("kind").Get_string(msgp.get()).value, "CAR");
+
+  // Messages
+  {
+    auto maybe_v = Compile("points[0]").Get_msg(msgp.get());
+    ASSERT_TRUE(maybe_v.IsOk()) << maybe_v.error;
+    EXPECT_EQ((*maybe_v.value)->DebugString(), "x: 1\n");
+  }
+
+  // Type errors
+  {
+    auto maybe_v = Compile("kind").Get_float(msgp.get());
+    ASSERT_FALSE(maybe_v.IsOk());
+    EXPECT_EQ(
+      maybe_v.error,
+      "Wanted field path kind on msg my_package.Scene to be type float, "
+      "but it is of type enum");
+  }
+
+  // Compile errors
+  {
+    auto maybe_cfp = CompiledFieldPath::Compile(descriptor, "points.x");
+    ASSERT_FALSE(maybe_cfp.IsOk());
+    EXPECT_EQ(
+      maybe_cfp.error,
+      "Field points of my_package.Scene is repeated; select an element with "
+      "[index] (or [key] for maps)");
+  }
+  {
+    auto maybe_cfp = CompiledFieldPath::Compile(descriptor, "kind.x");
+    ASSERT_FALSE(maybe_cfp.IsOk());
+    EXPECT_EQ(
+      maybe_cfp.error,
+      "Field kind of my_package.Scene is not a message; can't get x");
+  }
+  {
+    auto maybe_cfp = CompiledFieldPath::Compile(descriptor, "points[0].y");
+    ASSERT_FALSE(maybe_cfp.IsOk());
+    EXPECT_EQ(maybe_cfp.error, "Msg my_package.Scene.Point has no field y");
+  }
+  {
+    auto maybe_cfp = CompiledFieldPath::Compile(descriptor, "ids[x]");
+    ASSERT_FALSE(maybe_cfp.IsOk());
+    EXPECT_EQ(
+      maybe_cfp.error,
+      "Bad index x for repeated field ids of my_package.Scene");
+  }
+
+  // Wrong message type
+  {
+    StdMsg_String other;
+    auto maybe_v = Compile("kind").Get_int32(&other);
+    ASSERT_FALSE(maybe_v.IsOk());
+    EXPECT_EQ(
+      maybe_v.error,
+      "Field path kind is for msg my_package.Scene, not protobag.StdMsg.String");
+  }
+}
@@ -39,3 +39,26 @@ TEST(ResultTest, TestFail) {
   EXPECT_FALSE(res.IsOk());
   EXPECT_EQ(res.error, "foo");
 }
+
+TEST(ResultTest, TestCodes) {
+  {
+    auto res = Fail();
+    EXPECT_TRUE(res.Is(ResultCode::kError));
+    EXPECT_FALSE(res.Is(ResultCode::kEndOfSequence));
+  }
+  {
+    auto res = Result<int>::Err("EndOfSequence", ResultCode::kEndOfSequence);
+    EXPECT_TRUE(res.Is(ResultCode::kEndOfSequence));
+    EXPECT_FALSE(res.Is(ResultCode::kError));
+  }
+  {
+    // Codes only describe failures
+    Result<int> res = {.value = 1337, .code = ResultCode::kNotFound};
+    EXPECT_FALSE(res.Is(ResultCode::kNotFound));
+  }
+  {
+    // A message that merely looks special is a plain error
+    auto res = Result<int>::Err("EndOfSequence");
+    EXPECT_FALSE(res.Is(ResultCode::kEndOfSequence));
+  }
+}
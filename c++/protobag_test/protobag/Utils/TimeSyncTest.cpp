@@ -120,3 +120,284 @@ TEST(TimeSyncTest, TestMaxSlopSyncBasic) {
   EXPECT_EQ(kExpectedBundles, actual_bundles);
 }
 
+TEST(TimeSyncTest, TestIndexedMaxSlopSyncBasic) {
+  static const std::list<EntryBundle> kExpectedBundles = {
+    {
+      Entry::CreateStamped("/topic1", 0, 0, ToStringMsg("foo")),
+      Entry::CreateStamped("/topic2", 0, 0, ToIntMsg(1337)),
+    },
+
+    {
+      Entry::CreateStamped("/topic1", 1, 0, ToStringMsg("foo")),
+      Entry::CreateStamped("/topic2", 1, 0, ToIntMsg(1337)),
+    },
+  };
+
+  protobag::Selection sel;
+  sel.mutable_window();
+  auto fixture = CreateInMemoryReadSession(
+    sel,
+    Flatten(kExpectedBundles));
+
+  auto maybeSync = IndexedMaxSlopTimeSync::Create(
+    fixture,
+    {
+      .topics = {"/topic1", "/topic2"},
+      .max_slop = SecondsToDuration(0.5),
+    });
+  ASSERT_TRUE(maybeSync.IsOk()) << maybeSync.error;
+
+  auto actual_bundles = ConsumeBundles(*maybeSync.value);
+  ASSERT_EQ(actual_bundles.size(), kExpectedBundles.size());
+  
+  auto actual_it = actual_bundles.begin();
+  for (const auto &expected : kExpectedBundles) {
+    const auto &actual = *actual_it;
+    ASSERT_EQ(actual.size(), expected.size());
+    auto e_it = expected.begin();
+    for (const auto &a : actual) {
+      // Emitted entries are read in full
+      EXPECT_EQ(
+        PBToString(*a.GetTopicTime()),
+        PBToString(*e_it->GetTopicTime()));
+      EXPECT_EQ(a.msg.type_url(), e_it->msg.type_url());
+      EXPECT_EQ(a.msg.value(), e_it->msg.value());
+      ++e_it;
+    }
+    ++actual_it;
+  }
+}
+
+TEST(TimeSyncTest, TestIndexedMaxSlopSyncMatchesMaxSlopSync) {
+  // A high-rate topic synchronized to a low-rate one
+  std::list<Entry> entries;
+  for (int i = 0; i < 30; ++i) {
+    entries.push_back(
+      Entry::CreateStamped("/fast", i / 10, (i % 10) * 100000000, ToIntMsg(i)));
+  }
+  for (int i = 0; i < 3; ++i) {
+    entries.push_back(
+      Entry::CreateStamped("/slow", i, 20000000, ToIntMsg(i)));
+  }
+  auto fixture = CreateMemoryArchive(entries);
+
+  auto GetBundleNames = [&](bool use_index) {
+    protobag::Selection sel;
+    sel.mutable_window();
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {
+        .mode="read",
+        .format="memory",
+        .memory_archive=fixture,
+      },
+      .selection = sel,
+    });
+    if (!maybe_rs.IsOk()) { throw std::runtime_error(maybe_rs.error); }
+    
+    MaxSlopTimeSync::Spec spec = {
+      .topics = {"/fast", "/slow"},
+      .max_slop = SecondsToDuration(0.05),
+      .max_queue_size = 3,
+    };
+    auto maybe_sync = 
+      use_index ?
+        IndexedMaxSlopTimeSync::Create(*maybe_rs.value, spec) :
+        MaxSlopTimeSync::Create(*maybe_rs.value, spec);
+    if (!maybe_sync.IsOk()) { throw std::runtime_error(maybe_sync.error); }
+
+    std::vector<std::string> names;
+    for (const auto &bundle : ConsumeBundles(*maybe_sync.value)) {
+      for (const auto &entry : bundle) {
+        names.push_back(entry.entryname);
+      }
+    }
+    return names;
+  };
+
+  auto expected = GetBundleNames(false);
+  auto actual = GetBundleNames(true);
+  EXPECT_EQ(expected.size(), 6);
+  EXPECT_SEQUENCES_EQUAL(expected, actual);
+}
+
+TEST(TimeSyncTest, TestIndexedMaxSlopSyncRequiresWindow) {
+  protobag::Selection sel;
+  sel.mutable_events();
+  auto fixture = CreateInMemoryReadSession(
+    sel,
+    std::list<Entry>{
+      Entry::CreateStamped("/topic1", 0, 0, ToStringMsg("foo")),
+    });
+
+  auto maybeSync = IndexedMaxSlopTimeSync::Create(
+    fixture,
+    {
+      .topics = {"/topic1"},
+      .max_slop = SecondsToDuration(0.5),
+    });
+  ASSERT_FALSE(maybeSync.IsOk());
+  EXPECT_EQ(
+    maybeSync.error,
+    "IndexedMaxSlopTimeSync only supports Window or All selections");
+}
+
+TEST(TimeSyncTest, TestIndexedSyncsRejectPredicates) {
+  auto fixture = CreateMemoryArchive(std::list<Entry>{
+    Entry::CreateStamped("/a", 0, 0, ToIntMsg(0)),
+    Entry::CreateStamped("/a", 1, 0, ToIntMsg(1)),
+  });
+  protobag::Selection sel;
+  sel.mutable_window();
+  auto maybe_rs = ReadSession::Create({
+    .archive_spec = MemorySpec(fixture),
+    .selection = sel,
+    .unpack_stamped_messages = true,
+    .predicates = {
+      {.field_path = "value", .op = FieldPredicate::Op::EQ, .value = 1},
+    },
+  });
+  ASSERT_TRUE(maybe_rs.IsOk()) << maybe_rs.error;
+
+  // Both syncs plan from the index, so they can't apply the predicates
+  {
+    auto maybeSync = IndexedMaxSlopTimeSync::Create(
+      *maybe_rs.value,
+      {
+        .topics = {"/a"},
+        .max_slop = SecondsToDuration(0.5),
+      });
+    ASSERT_FALSE(maybeSync.IsOk());
+    EXPECT_EQ(
+      maybeSync.error,
+      "IndexedMaxSlopTimeSync does not support field predicates");
+  }
+  {
+    auto maybeSync = FixedRateTimeSync::Create(
+      *maybe_rs.value,
+      {
+        .topics = {"/a"},
+        .period = SecondsToDuration(0.5),
+      });
+    ASSERT_FALSE(maybeSync.IsOk());
+    EXPECT_EQ(
+      maybeSync.error, "FixedRateTimeSync does not support field predicates");
+  }
+}
+
+TEST(TimeSyncTest, TestFixedRateSyncBasic) {
+  protobag::Selection sel;
+  sel.mutable_window();
+  auto fixture = CreateInMemoryReadSession(
+    sel,
+    std::list<Entry>{
+      Entry::CreateStamped("/a", 0, 0, ToIntMsg(0)),
+      Entry::CreateStamped("/a", 1, 0, ToIntMsg(1)),
+      Entry::CreateStamped("/a", 2, 0, ToIntMsg(2)),
+      Entry::CreateStamped("/b", 0, 500000000, ToIntMsg(0)),
+      Entry::CreateStamped("/b", 1, 500000000, ToIntMsg(1)),
+      Entry::CreateStamped("/b", 2, 500000000, ToIntMsg(2)),
+    });
+
+  auto maybeSync = FixedRateTimeSync::Create(
+    fixture,
+    {
+      .topics = {"/a", "/b"},
+      .period = SecondsToDuration(0.5),
+    });
+  ASSERT_TRUE(maybeSync.IsOk()) << maybeSync.error;
+  
+  std::vector<std::string> actual;
+  for (const auto &bundle : ConsumeBundles(*maybeSync.value)) {
+    std::string s;
+    for (const auto &entry : bundle) {
+      auto tt = entry.GetTopicTime();
+      ASSERT_TRUE(tt.has_value());
+      s += fmt::format(
+        "{}@{}.{} ", tt->topic(),
+        tt->timestamp().seconds(), tt->timestamp().nanos() / 100000000);
+    }
+    actual.push_back(s);
+  }
+
+  // Ticks start once every topic has data (0.5s) and stop when some topic
+  // runs out of data (2s)
+  std::vector<std::string> expected = {
+    "/a@0.0 /a@1.0 /b@0.5 /b@0.5 ",
+    "/a@1.0 /a@1.0 /b@0.5 /b@1.5 ",
+    "/a@1.0 /a@2.0 /b@1.5 /b@1.5 ",
+    "/a@2.0 /a@2.0 /b@1.5 /b@2.5 ",
+  };
+  EXPECT_SEQUENCES_EQUAL(expected, actual);
+}
+
+TEST(TimeSyncTest, TestFixedRateSyncReusesEntriesAcrossTicks) {
+  protobag::Selection sel;
+  sel.mutable_window();
+  auto fixture = CreateInMemoryReadSession(
+    sel,
+    std::list<Entry>{
+      Entry::CreateStamped("/a", 0, 0, ToIntMsg(0)),
+      Entry::CreateStamped("/a", 1, 0, ToIntMsg(1)),
+      Entry::CreateStamped("/a", 2, 0, ToIntMsg(2)),
+    });
+
+  // Each entry brackets several ticks
+  auto maybeSync = FixedRateTimeSync::Create(
+    fixture,
+    {
+      .topics = {"/a"},
+      .period = SecondsToDuration(0.25),
+    });
+  ASSERT_TRUE(maybeSync.IsOk()) << maybeSync.error;
+
+  std::vector<std::string> actual;
+  for (const auto &bundle : ConsumeBundles(*maybeSync.value)) {
+    std::string s;
+    for (const auto &entry : bundle) {
+      ASSERT_FALSE(entry.msg.value().empty()) << entry.ToString();
+      auto tt = entry.GetTopicTime();
+      ASSERT_TRUE(tt.has_value());
+      s += fmt::format("{} ", tt->timestamp().seconds());
+    }
+    actual.push_back(s);
+  }
+
+  std::vector<std::string> expected = {
+    "0 0 ", "0 1 ", "0 1 ", "0 1 ",
+    "1 1 ", "1 2 ", "1 2 ", "1 2 ",
+    "2 2 ",
+  };
+  EXPECT_SEQUENCES_EQUAL(expected, actual);
+}
+
+TEST(TimeSyncTest, TestFixedRateSyncRequiresPositivePeriod) {
+  protobag::Selection sel;
+  sel.mutable_window();
+  auto fixture = CreateInMemoryReadSession(
+    sel,
+    std::list<Entry>{
+      Entry::CreateStamped("/a", 0, 0, ToIntMsg(0)),
+    });
+
+  auto maybeSync = FixedRateTimeSync::Create(fixture, {.topics = {"/a"}});
+  ASSERT_FALSE(maybeSync.IsOk());
+}
+
+TEST(TimeSyncTest, TestFixedRateSyncRejectsDuplicateTopics) {
+  protobag::Selection sel;
+  sel.mutable_window();
+  auto fixture = CreateInMemoryReadSession(
+    sel,
+    std::list<Entry>{
+      Entry::CreateStamped("/a", 0, 0, ToIntMsg(0)),
+      Entry::CreateStamped("/a", 1, 0, ToIntMsg(1)),
+    });
+
+  auto maybeSync = FixedRateTimeSync::Create(
+    fixture,
+    {
+      .topics = {"/a", "/a"},
+      .period = SecondsToDuration(0.5),
+    });
+  ASSERT_FALSE(maybeSync.IsOk());
+}
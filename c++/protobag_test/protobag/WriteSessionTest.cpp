@@ -19,10 +19,12 @@ limitations under the License.
 #include <exception>
 #include <vector>
 
+#include "protobag/ReadSession.hpp"
 #include "protobag/Utils/PBUtils.hpp"
 #include "protobag/Utils/StdMsgUtils.hpp"
 #include "protobag/Utils/TopicTime.hpp"
 #include "protobag/WriteSession.hpp"
+#include "protobag/archive/MemoryArchive.hpp"
 
 #include "protobag_test/Utils.hpp"
 
@@ -221,3 +223,265 @@ TEST(WriteSessionDirectory, TestBasic) {
   }
 
 }
+
+TEST(WriteSessionTest, TestWriteStamped) {
+  ::google::protobuf::Timestamp t;
+  t.set_seconds(1337);
+  t.set_nanos(42);
+
+  StdMsg_Bytes large;
+  large.set_value(std::string(1 << 20, 'x'));
+
+  auto WriteAll = [&](bool framed) {
+    auto archive = archive::MemoryArchive::Create();
+    auto wp = OpenWriterAndCheck({
+      .archive_spec = {
+        .mode = "write",
+        .format = "memory",
+        .memory_archive = archive,
+      }
+    });
+    auto Write = [&](
+        const std::string &topic,
+        const ::google::protobuf::Timestamp &t,
+        const auto &msg) {
+      OkOrErr result = framed ?
+        wp->WriteStamped(topic, t, msg) :
+        wp->WriteEntry(Entry::CreateStamped(topic, t, msg));
+      if (!result.IsOk()) {
+        throw std::runtime_error(result.error);
+      }
+    };
+    Write("/topic1", t, ToStringMsg("foo"));
+    Write("/topic1", ::google::protobuf::Timestamp(), ToStringMsg(""));
+    Write("/topic2", t, ToIntMsg(1337));
+    Write("/large", t, large);
+    auto status = wp->Close();
+    if (!status.IsOk()) {
+      throw std::runtime_error(status.error);
+    }
+    return archive->GetData();
+  };
+
+  auto expected = WriteAll(false);
+  auto actual = WriteAll(true);
+  EXPECT_EQ(expected.size(), actual.size());
+  for (const auto &[entryname, data] : expected) {
+    if (IsProtoBagIndexTopic("/" + entryname)) { continue; }
+    ASSERT_TRUE(actual.find(entryname) != actual.end()) << entryname;
+    EXPECT_TRUE(actual[entryname] == data) << entryname;
+  }
+
+  // The index should see the same entries
+  auto GetIndex = [](const std::unordered_map<std::string, std::string> &d) {
+    for (const auto &[entryname, data] : d) {
+      if (IsProtoBagIndexTopic("/" + entryname)) {
+        auto maybe_any = 
+          PBFactory::LoadFromContainer<::google::protobuf::Any>(data);
+        auto maybe_stamped = 
+          PBFactory::UnpackFromAny<StampedMessage>(*maybe_any.value);
+        return *PBFactory::UnpackFromAny<BagIndex>(
+          maybe_stamped.value->msg()).value;
+      }
+    }
+    throw std::runtime_error("No index");
+  };
+  auto expected_index = GetIndex(expected);
+  auto actual_index = GetIndex(actual);
+  EXPECT_EQ(
+    expected_index.time_ordered_entries_size(),
+    actual_index.time_ordered_entries_size());
+  EXPECT_EQ(
+    PBFactory::ToTextFormatString(expected_index.descriptor_pool_data()).value,
+    PBFactory::ToTextFormatString(actual_index.descriptor_pool_data()).value);
+}
+
+TEST(WriteSessionTest, TestSplit) {
+  auto testdir = CreateTestTempdir("WriteSessionTest.TestSplit");
+
+  auto WriteSplit = [&](
+      const std::string &name,
+      size_t split_bytes,
+      const ::google::protobuf::Duration &split_duration) {
+
+    auto wp = OpenWriterAndCheck({
+      .archive_spec = {
+        .mode = "write",
+        .path = testdir / name,
+      },
+      .split_bytes = split_bytes,
+      .split_duration = split_duration,
+    });
+    for (int i = 0; i < 10; ++i) {
+      ::google::protobuf::Timestamp t;
+      t.set_seconds(i);
+      OkOrErr result = wp->WriteStamped("/t", t, ToIntMsg(i));
+      if (!result.IsOk()) {
+        throw std::runtime_error(result.error);
+      }
+    }
+    auto status = wp->Close();
+    if (!status.IsOk()) {
+      throw std::runtime_error(status.error);
+    }
+    return wp->GetBagPaths();
+  };
+
+  auto ReadValues = [](const std::string &path) {
+    std::vector<int64_t> values;
+    auto maybe_index = ReadSession::GetIndex(path);
+    if (!maybe_index.IsOk()) {
+      throw std::runtime_error(maybe_index.error);
+    }
+    auto maybe_rs = ReadSession::Create(ReadSession::Spec::ReadAllFromPath(path));
+    if (!maybe_rs.IsOk()) {
+      throw std::runtime_error(maybe_rs.error);
+    }
+    for (const Entry &entry : **maybe_rs.value) {
+      auto maybe_i = entry.GetAs<StdMsg_Int>();
+      if (maybe_i.IsOk()) {
+        values.push_back(maybe_i.value->value());
+      }
+    }
+    EXPECT_EQ(maybe_index.value->time_ordered_entries_size(), values.size());
+    return values;
+  };
+
+  {
+    // Split every 4 seconds
+    auto paths = WriteSplit("by_duration.zip", 0, SecondsToDuration(4));
+    ASSERT_EQ(paths.size(), 3);
+    EXPECT_EQ(
+      paths[1], 
+      WriteSession::GetSplitPath(testdir / "by_duration.zip", 1));
+    EXPECT_EQ(ReadValues(paths[0]), std::vector<int64_t>({0, 1, 2, 3}));
+    EXPECT_EQ(ReadValues(paths[1]), std::vector<int64_t>({4, 5, 6, 7}));
+    EXPECT_EQ(ReadValues(paths[2]), std::vector<int64_t>({8, 9}));
+
+    // The bag opened ahead of time but never used is discarded
+    EXPECT_FALSE(fs::exists(
+      WriteSession::GetSplitPath(testdir / "by_duration.zip", 3)));
+  }
+
+  {
+    // Split after every 3rd entry (all of which are the same size)
+    std::string framed;
+    {
+      auto entry = Entry::CreateStamped("/t", 0, 0, ToIntMsg(0));
+      framed = *PBFactory::ToBinaryString(entry.msg).value;
+    }
+    auto paths = WriteSplit(
+      "by_size.zip", 3 * framed.size(), ::google::protobuf::Duration());
+    ASSERT_EQ(paths.size(), 4);
+    std::vector<int64_t> values;
+    for (const auto &path : paths) {
+      auto bag_values = ReadValues(path);
+      EXPECT_LE(bag_values.size(), 3);
+      values.insert(values.end(), bag_values.begin(), bag_values.end());
+    }
+    EXPECT_EQ(values, std::vector<int64_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  }
+
+  {
+    auto maybe_w = WriteSession::Create({
+      .archive_spec = {
+        .mode = "write",
+        .format = "memory",
+      },
+      .split_bytes = 10,
+    });
+    EXPECT_FALSE(maybe_w.IsOk());
+  }
+}
+
+TEST(WriteSessionTest, TestSplitFailsToOpenNextBag) {
+  auto testdir = CreateTestTempdir("WriteSessionTest.TestSplitFailsToOpenNextBag");
+  const std::string path = testdir / "bag.zip";
+
+  // Block the second bag's path
+  fs::create_directories(WriteSession::GetSplitPath(path, 1));
+
+  auto wp = OpenWriterAndCheck({
+    .archive_spec = {
+      .mode = "write",
+      .path = path,
+      .format = "zip",
+    },
+    .split_duration = SecondsToDuration(4),
+  });
+  std::vector<std::string> errors;
+  for (int i = 0; i < 6; ++i) {
+    ::google::protobuf::Timestamp t;
+    t.set_seconds(i);
+    OkOrErr result = wp->WriteStamped("/t", t, ToIntMsg(i));
+    if (!result.IsOk()) {
+      errors.push_back(result.error);
+    }
+  }
+  ASSERT_EQ(errors.size(), 2);
+  for (const auto &error : errors) {
+    EXPECT_NE(error.find("Could not open bag 1"), std::string::npos) << error;
+  }
+
+  auto status = wp->Close();
+  ASSERT_FALSE(status.IsOk());
+  EXPECT_NE(
+    status.error.find("Could not open bag 1"), std::string::npos) << status.error;
+
+  // The first bag is still finished with its index
+  auto maybe_index = ReadSession::GetIndex(wp->GetBagPaths()[0]);
+  ASSERT_TRUE(maybe_index.IsOk()) << maybe_index.error;
+  EXPECT_EQ(maybe_index.value->time_ordered_entries_size(), 4);
+}
+
+TEST(WriteSessionTest, TestAppend) {
+  auto testdir = CreateTestTempdir("WriteSessionTest.TestAppend");
+
+  for (const std::string format : {"zip", "directory"}) {
+    const std::string path = testdir / ("bag." + format);
+    auto Write = [&](const std::string &mode, const std::string &topic, int t0) {
+      auto wp = OpenWriterAndCheck({
+        .archive_spec = {
+          .mode = mode,
+          .path = path,
+          .format = format,
+        },
+      });
+      for (int i = t0; i < 10; i += 2) {
+        ExpectWriteOk(*wp, Entry::CreateStamped(topic, i, 0, ToIntMsg(i)));
+      }
+    };
+    Write("write", "/even", 0);
+    Write("append", "/odd", 1);
+
+    // The latest index covers all the entries
+    auto maybe_index = ReadSession::GetIndex(path);
+    ASSERT_TRUE(maybe_index.IsOk()) << maybe_index.error;
+    const BagIndex &index = *maybe_index.value;
+    EXPECT_EQ(index.time_ordered_entries_size(), 10);
+    EXPECT_EQ(index.topic_to_stats().at("/even").n_messages(), 5);
+    EXPECT_EQ(index.topic_to_stats().at("/odd").n_messages(), 5);
+    EXPECT_EQ(index.start().seconds(), 0);
+    EXPECT_EQ(index.end().seconds(), 9);
+
+    Selection sel;
+    sel.mutable_window();
+    auto maybe_rs = ReadSession::Create({
+      .archive_spec = {
+        .mode = "read",
+        .path = path,
+        .format = format,
+      },
+      .selection = sel,
+      .unpack_stamped_messages = true,
+    });
+    ASSERT_TRUE(maybe_rs.IsOk()) << maybe_rs.error;
+    std::vector<int64_t> values;
+    for (const Entry &entry : **maybe_rs.value) {
+      auto maybe_i = entry.GetAs<StdMsg_Int>();
+      ASSERT_TRUE(maybe_i.IsOk()) << maybe_i.error;
+      values.push_back(maybe_i.value->value());
+    }
+    EXPECT_EQ(values, std::vector<int64_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  }
+}
@@ -93,4 +93,84 @@ TEST(LibArchiveArchiveTest, TestRead) {
   }
 }
 
+TEST(LibArchiveArchiveTest, TestReadMany) {
+  auto ar = OpenAndCheck({
+    .mode="read",
+    .path=GetFixture("test.tar"),
+    .format="tar",
+  });
+
+  auto actual = ar->ReadMany({"bar/bar", "does-not-exist", "foo", "bar/bar"});
+  ASSERT_EQ(actual.size(), 4);
+  EXPECT_EQ(actual[0], Archive::ReadStatus::OK("bar"));
+  EXPECT_TRUE(actual[1].IsEntryNotFound());
+  EXPECT_EQ(actual[2], Archive::ReadStatus::OK("foo"));
+  EXPECT_EQ(actual[3], Archive::ReadStatus::OK("bar"));
+}
+
+TEST(LibArchiveArchiveTest, TestZipAppend) {
+  auto testdir = CreateTestTempdir("LibArchiveArchiveTest.TestZipAppend");
+  auto test_file = testdir / "test.zip";
+  const std::string big(100000, 'x');
+  {
+    auto ar = OpenAndCheck({
+      .mode="write",
+      .path=test_file,
+      .format="zip",
+    });
+    EXPECT_TRUE(ar->Write("foo", "foo").IsOk());
+    EXPECT_TRUE(ar->Write("big", big).IsOk());
+  }
+
+  for (const char *name : {"bar/bar", "baz"}) {
+    auto ar = OpenAndCheck({
+      .mode="append",
+      .path=test_file,
+      .format="zip",
+    });
+    auto res = ar->Write(name, name);
+    EXPECT_TRUE(res.IsOk()) << res.error;
+
+    // Close() reports whether the zip was finished; then writes fail
+    auto closed = ar->Close();
+    EXPECT_TRUE(closed.IsOk()) << closed.error;
+    EXPECT_FALSE(ar->Write("late", "late").IsOk());
+  }
+
+  {
+    // Appending nothing leaves the zip as is
+    const auto size = fs::file_size(test_file);
+    OpenAndCheck({
+      .mode="append",
+      .path=test_file,
+      .format="zip",
+    });
+    EXPECT_EQ(fs::file_size(test_file), size);
+  }
+
+  auto ar = OpenAndCheck({
+    .mode="read",
+    .path=test_file,
+    .format="zip",
+  });
+  std::vector<std::string> expected = {"foo", "big", "bar/bar", "baz"};
+  EXPECT_SORTED_SEQUENCES_EQUAL(expected, ar->GetNamelist());
+
+  auto actual = ar->ReadMany({"foo", "big", "bar/bar", "baz"});
+  ASSERT_EQ(actual.size(), 4);
+  EXPECT_EQ(actual[0], Archive::ReadStatus::OK("foo"));
+  EXPECT_EQ(actual[1], Archive::ReadStatus::OK(std::string(big)));
+  EXPECT_EQ(actual[2], Archive::ReadStatus::OK("bar/bar"));
+  EXPECT_EQ(actual[3], Archive::ReadStatus::OK("baz"));
+
+  {
+    auto result = Archive::Open({
+      .mode="append",
+      .path=testdir / "does-not-exist.zip",
+      .format="zip",
+    });
+    EXPECT_FALSE(result.IsOk());
+  }
+}
+
 // TODO: test zip
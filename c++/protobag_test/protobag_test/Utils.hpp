@@ -28,6 +28,7 @@
 #include <filesystem>
 
 #include "protobag/archive/Archive.hpp"
+#include "protobag/archive/LibArchiveArchive.hpp"
 #include "protobag/archive/MemoryArchive.hpp"
 #include "protobag/Utils/Tempfile.hpp"
 #include "protobag/ReadSession.hpp"
@@ -105,12 +106,41 @@ std::shared_ptr<protobag::archive::MemoryArchive> CreateMemoryArchive(
         throw std::runtime_error(status.error);
       }
     }
-    writer.Close();
+    auto status = writer.Close();
+    if (!status.IsOk()) {
+      throw std::runtime_error(status.error);
+    }
   }
 
   return buffer;
 }
 
+// A spec for reading `fixture` (e.g. from `CreateMemoryArchive()`)
+inline
+protobag::archive::Archive::Spec MemorySpec(
+    const std::shared_ptr<protobag::archive::MemoryArchive> &fixture) {
+  return {
+    .mode="read",
+    .format="memory",
+    .memory_archive=fixture,
+  };
+}
+
+// Counts the passes over zip / tar archives started for reading since the
+// counter was created.  NB: `LibArchiveArchive::GetNumReadPasses()` is a
+// process-wide total, so tests should only look at deltas like this one.
+class ReadPassCounter {
+public:
+  ReadPassCounter() : _start(Total()) { }
+  size_t Get() const { return Total() - _start; }
+
+protected:
+  static size_t Total() {
+    return protobag::archive::LibArchiveArchive::GetNumReadPasses();
+  }
+  size_t _start;
+};
+
 template <typename EntryContainerT>
 protobag::ReadSession::Ptr CreateInMemoryReadSession(
     const protobag::Selection &sel,
@@ -163,7 +193,7 @@ void RunCMDAndCheckOutput(
         "Could not create tempdir: {}", maybeTempdir.error));
     }
     auto tempdir = fs::path(*maybeTempdir.value);
-    outpath = (tempdir / "RunCMDAndCheckOutput_out.txt").u8string();
+    outpath = (tempdir / "RunCMDAndCheckOutput_out.txt").string();
   }
 
   std::string full_cmd = fmt::format("{} > {}", cmd, outpath);
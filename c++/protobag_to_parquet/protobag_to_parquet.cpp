@@ -0,0 +1,67 @@
+/*
+Copyright 2020 Standard Cyborg
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+// Export the topics of a protobag to Parquet files.  Usage:
+//   protobag_to_parquet [--row-group-size N] [--threads N] \
+//     <protobag path> <output dir> [topic ...]
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "protobag/ParquetExporter.hpp"
+
+int main(int argc, char **argv) {
+  protobag::ParquetExporter::Spec spec;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--row-group-size" && i + 1 < argc) {
+      spec.row_group_size = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      spec.num_threads = std::strtoull(argv[++i], nullptr, 10);
+    } else {
+      args.push_back(arg);
+    }
+  }
+
+  if (args.size() < 2) {
+    std::cerr << 
+      "Usage: " << argv[0] << 
+        " [--row-group-size N] [--threads N]" <<
+        " <protobag path> <output dir> [topic ...]" << std::endl;
+    return -1;
+  }
+
+  spec.archive_spec = {
+    .mode = "read",
+    .path = args[0],
+  };
+  spec.output_dir = args[1];
+  spec.topics.assign(args.begin() + 2, args.end());
+
+  auto maybe_paths = protobag::ParquetExporter::Export(spec);
+  if (!maybe_paths.IsOk()) {
+    std::cerr << "Export failed: " << maybe_paths.error << std::endl;
+    return -1;
+  }
+  for (const auto &path : *maybe_paths.value) {
+    std::cout << "Wrote " << path << std::endl;
+  }
+  return 0;
+}
@@ -314,7 +314,8 @@ class RawEntry(Entry):
   """
   
   raw_bytes = attr.ib(default='', type='bytearray')
-  """bytearray: Raw message contents"""
+  """bytearray: Raw message contents; a (zero-copy) `memoryview` when read
+  from a protobag"""
 
   @classmethod
   def from_bytes(cls, entryname, raw_bytes, **kwargs):
@@ -338,7 +339,8 @@ class RawEntry(Entry):
       'RawEntry:',
       '  entryname: %s' % self.entryname,
       '  raw_bytes: %s ... (%s bytes)' % (
-        self.raw_bytes[:20].decode() if self.raw_bytes is not None else 'None',
+        bytes(self.raw_bytes[:20]).decode(errors='replace')
+          if self.raw_bytes is not None else 'None',
         len(self.raw_bytes) if self.raw_bytes is not None else 0),
     ]
     return "\n".join(lines)
@@ -350,6 +352,9 @@ class RawEntry(Entry):
 
 class Protobag(object):
 
+  # Number of entries `iter_entries()` reads natively per call
+  READ_BATCH_SIZE = 256
+
   def __init__(self, path=None, serdes=None, msg_classes=None):
     """Handle to a Protobag archive on disk at the given `path`.  Use this
     object to help organize your reads and writes to an existing or new 
@@ -396,11 +401,67 @@ class Protobag(object):
     from protobag.protobag_native import PyReader
     return PyReader.get_topics(self._path)
 
+  def extract_columns(
+        self,
+        topic,
+        field_paths,
+        chunk_size=4096,
+        num_threads=0):
+    """Extract the values at `field_paths` from every message on `topic`
+    into columns, decoding messages in parallel in C++.  Messages are decoded
+    using the descriptor data indexed in the protobag.
+
+    Args:
+      topic (str): Extract messages on this topic.
+      field_paths (list of str): Extract the values at these paths, e.g.
+        'pose.x', 'points[3].y' or 'labels[car]'.  FMI see
+        `protobag::CompiledFieldPath`.
+      chunk_size (optional int): Decode this many messages at a time.
+      num_threads (optional int): Decode using this many threads; by
+        default, use all cores.
+
+    Returns:
+    A dict with a 'timestamp_ns' numpy array (of nanoseconds since the epoch)
+      and one entry per field path: a numpy array of floats or ints (which
+      share memory with the C++ buffers; no copies) or a list of strings.
+      The 'valid' entry is a dict of boolean numpy arrays per field path
+      that are False where a message lacks the value (e.g. a missing map key).
+    """
+    from protobag.protobag_native import extract_columns
+    native = extract_columns(
+      self._path,
+      topic,
+      list(field_paths),
+      chunk_size=chunk_size,
+      num_threads=num_threads)
+    
+    result = {
+      'timestamp_ns': native['timestamp_ns'],
+      'valid': dict(
+        (path, valid.view(bool)) for path, valid in native['valid'].items()),
+    }
+    for path, values in native['values'].items():
+      if isinstance(values, tuple):
+        data, offsets = values
+        data = data.tobytes()
+        values = [
+          data[offsets[i]:offsets[i + 1]].decode('utf-8', errors='replace')
+          for i in range(len(offsets) - 1)
+        ]
+      result[path] = values
+    return result
+
   def iter_entries(
         self,
         selection=None,
         dynamic_decode=True,
-        sync_using_max_slop=None):
+        sync_using_max_slop=None,
+        sync_plan_from_index=False,
+        sync_at_fixed_rate=None,
+        where=None,
+        shard_index=0,
+        num_shards=1,
+        shuffle=None):
     """Create a `ReadSession` and iterate through entries specified by
     the given `selection`; by default "SELECT ALL" (read all entries in 
     the protobag).
@@ -418,6 +479,33 @@ class Protobag(object):
       sync_using_max_slop (optional protobag_native.MaxSlopTimeSyncSpec):
         Synchronize StampedEntry instances in the `selection` using
         a max slop algorithm.  FMI see `protobag_native.PyMaxSlopTimeSync`.
+      sync_plan_from_index (optional bool): When synchronizing, plan bundles
+        using only the protobag index and read only the entries that are
+        emitted; requires a window (or select all) `selection`.  Much faster
+        when synchronizing high-rate topics to a low-rate one.
+      sync_at_fixed_rate (optional protobag_native.FixedRateTimeSyncSpec):
+        Emit bundles at a fixed rate, where each bundle has the nearest
+        message before and after each tick for every topic (in that order).
+        FMI see `protobag_native.PyFixedRateTimeSync`.
+      where (optional list of tuples): Only read entries whose messages
+        satisfy all of these `(field_path, op, value)` predicates, e.g.
+        `[('fix_quality', '>=', 4), ('status', '==', 'OK')]`.  `op` is one
+        of `==`, `!=`, `<`, `<=`, `>`, `>=` or `between` (with a
+        `(lower, upper)` inclusive range as `value`).  Entries are filtered
+        natively (using the descriptors in the protobag index) before they
+        reach Python.  Every selected entry must have the predicates' fields
+        (e.g. a misspelled field path raises an error), so select only the
+        topics that the predicates apply to.
+      shard_index (optional int): With `num_shards`, read only this shard
+        of the selected entries, e.g. the current DataLoader worker id.
+      num_shards (optional int): Split the selected entries into this many
+        contiguous (in time order for time-ordered selections), near-equal
+        shards; each shard reads only its own entries, and the shards 
+        together read each entry exactly once.
+      shuffle (optional protobag_native.ReadShuffleSpec): Read entries in a
+        reproducible, pseudo-random order: blocks of entries that are
+        contiguous in the archive are read (sequentially) in shuffled order
+        and mixed through a shuffle buffer.  Useful for ML training.
     
     Returns:
     Generates `Entry` subclass instances (or a list of `Entry` instances
@@ -447,15 +535,37 @@ class Protobag(object):
         else:
           return
 
+    plan_from_index = (
+      sync_at_fixed_rate is not None or
+      (sync_using_max_slop is not None and sync_plan_from_index))
+    if plan_from_index and (where or num_shards > 1 or shuffle is not None):
+      raise ValueError(
+        "Synchronizing with sync_plan_from_index or sync_at_fixed_rate "
+        "does not support where, num_shards or shuffle")
+
     from protobag.protobag_native import PyReader
     reader = PyReader()
-    reader.start(self._path, selection_bytes)
-
-    if sync_using_max_slop is not None:
+    reader.start(
+      self._path,
+      selection_bytes,
+      predicates=where or [],
+      shard_index=shard_index,
+      num_shards=num_shards,
+      shuffle=shuffle)
+
+    if sync_using_max_slop is not None or sync_at_fixed_rate is not None:
       # Synchronize!
-      from protobag.protobag_native import PyMaxSlopTimeSync
-      sync = PyMaxSlopTimeSync()
-      sync.start(reader, sync_using_max_slop)
+      if sync_at_fixed_rate is not None:
+        from protobag.protobag_native import PyFixedRateTimeSync
+        sync = PyFixedRateTimeSync()
+        sync.start(reader, sync_at_fixed_rate)
+      else:
+        from protobag.protobag_native import PyMaxSlopTimeSync
+        sync = PyMaxSlopTimeSync()
+        sync.start(
+          reader,
+          sync_using_max_slop,
+          plan_from_index=sync_plan_from_index)
 
       def unpack_bundle(bundle):
         return [
@@ -467,9 +577,14 @@ class Protobag(object):
     
     else:
 
-      unpack = lambda nentry: Entry.from_nentry(nentry, serdes=self.serdes)
-      for entry in iter_results(reader, unpack):
-        yield entry
+      # Read in batches so that archive I/O and unpacking happen natively
+      # with the GIL released
+      while True:
+        nentries = reader.get_next_batch(self.READ_BATCH_SIZE)
+        if not nentries:
+          return
+        for nentry in nentries:
+          yield Entry.from_nentry(nentry, serdes=self.serdes)
   
   def get_entry(self, entryname):
     """Convenience for getting a single entry with `entryname`."""
@@ -548,7 +663,8 @@ class _Writer(object):
 
 
   def write_raw(self, entryname, raw_bytes):
-    self._writer.write_raw(entryname, raw_bytes)
+    # NB: `raw_bytes` might be a memoryview from a read entry
+    self._writer.write_raw(entryname, bytes(raw_bytes))
 
   def write_msg(self, entryname, msg):
     self._writer.write_msg(
@@ -679,7 +795,8 @@ class TypedBytes(object):
       '  type_url: %s' % self.type_url,
       '  entryname: %s' % self.entryname,
       '  msg_bytes: %s ... (%s bytes)' % (
-        self.msg_bytes[:20].decode() if self.msg_bytes is not None else 'None',
+        bytes(self.msg_bytes[:20]).decode(errors='replace')
+          if self.msg_bytes is not None else 'None',
         len(self.msg_bytes) if self.msg_bytes is not None else 0),
     ]
     return "\n".join(lines)
@@ -964,7 +1081,9 @@ class DictRowEntry(object):
   @classmethod
   def from_entry(cls, entry):
     if isinstance(entry, RawEntry):
-      msg_dict = {'protobag_raw_entry_bytes': entry.raw_bytes}
+      # NB: `raw_bytes` may be a memoryview of a native buffer, which
+      # can't be pickled (e.g. by Spark); copy it out
+      msg_dict = {'protobag_raw_entry_bytes': bytes(entry.raw_bytes)}
     else:
       msg_dict = json_format.MessageToDict(entry.msg)
 
@@ -15,6 +15,7 @@
 import copy
 import itertools
 import os
+import pickle
 
 import pytest
 
@@ -433,6 +434,173 @@ def test_write_read_stamped_msg():
   ]
   assert actual_bundles == expected_bundles
 
+  # Sync planned from the index should emit the same bundles
+  actual_bundles = []
+  for bundle in bag.iter_entries(
+                    selection=sel,
+                    sync_using_max_slop=spec,
+                    sync_plan_from_index=True):
+    actual_bundles.append(sorted(
+      (entry.topic, entry.timestamp.seconds, entry.msg.value)
+      for entry in bundle
+    ))
+  assert actual_bundles == expected_bundles
+
+  # Test fixed rate sync
+  from protobag.protobag_native import FixedRateTimeSyncSpec
+  spec = FixedRateTimeSyncSpec()
+  spec.topics = ['my_t1', 'my_t2']
+  spec.set_period(seconds=1, nanos=0)
+
+  actual_bundles = []
+  for bundle in bag.iter_entries(selection=sel, sync_at_fixed_rate=spec):
+    actual_bundles.append([
+      (entry.topic, entry.timestamp.seconds, entry.msg.value)
+      for entry in bundle
+    ])
+
+  expected_bundles = [
+    [('my_t1', 1, 1), ('my_t1', 1, 1), ('my_t2', 1, 1), ('my_t2', 1, 1)],
+    [('my_t1', 2, 2), ('my_t1', 2, 2), ('my_t2', 2, 2), ('my_t2', 2, 2)],
+  ]
+  assert actual_bundles == expected_bundles
+
+
+def test_extract_columns():
+  test_root = get_test_tempdir('test_extract_columns')
+  path = os.path.join(test_root, 'bag.zip')
+
+  bag = protobag.Protobag(path=path)
+  writer = bag.create_writer()
+  for t in range(5):
+    writer.write_stamped_msg("ints", to_std_msg(t), t_sec=t)
+    writer.write_stamped_msg("strs", to_std_msg(str(t)), t_sec=t)
+  writer.close()
+
+  columns = bag.extract_columns("ints", ["value"])
+  assert list(columns['timestamp_ns']) == [t * 1000000000 for t in range(5)]
+  assert list(columns['value']) == list(range(5))
+  assert all(columns['valid']['value'])
+
+  columns = bag.extract_columns("strs", ["value"], num_threads=2)
+  assert columns['value'] == [str(t) for t in range(5)]
+
+
+def test_reader_get_next_batch():
+  test_root = get_test_tempdir('test_reader_get_next_batch')
+  path = os.path.join(test_root, 'bag.zip')
+
+  bag = protobag.Protobag(path=path)
+  writer = bag.create_writer()
+  for t in range(5):
+    writer.write_stamped_msg("ints", to_std_msg(t), t_sec=t)
+  writer.close()
+
+  from protobag.protobag_native import PyReader
+  reader = PyReader()
+  sel = protobag.SelectionBuilder.select_window(topics=['ints'])
+  reader.start(path, sel.SerializeToString())
+
+  batches = []
+  while True:
+    batch = reader.get_next_batch(2)
+    if not batch:
+      break
+    batches.append([(nentry.topic, nentry.sec) for nentry in batch])
+  assert batches == [
+    [('ints', 0), ('ints', 1)],
+    [('ints', 2), ('ints', 3)],
+    [('ints', 4)],
+  ]
+
+
+def test_iter_entries_where():
+  test_root = get_test_tempdir('test_iter_entries_where')
+  path = os.path.join(test_root, 'bag.zip')
+
+  bag = protobag.Protobag(path=path)
+  writer = bag.create_writer()
+  for t in range(5):
+    writer.write_stamped_msg("ints", to_std_msg(t), t_sec=t)
+    writer.write_stamped_msg("strs", to_std_msg(str(t)), t_sec=t)
+  writer.close()
+
+  def _get_values(sel, where):
+    return [
+      (entry.topic, entry.msg.value)
+      for entry in bag.iter_entries(selection=sel, where=where)
+    ]
+
+  sel = protobag.SelectionBuilder.select_window(topics=['ints'])
+  assert _get_values(sel, [('value', '>=', 3)]) == [('ints', 3), ('ints', 4)]
+  assert _get_values(sel, [('value', 'between', (1, 2))]) == [
+    ('ints', 1), ('ints', 2)]
+  
+  sel = protobag.SelectionBuilder.select_window(topics=['strs'])
+  assert _get_values(sel, [('value', '==', '2')]) == [('strs', '2')]
+
+  with pytest.raises(ValueError):
+    _get_values(sel, [('value', '~=', '2')])
+
+  # Syncs planned from the index can't apply predicates
+  from protobag.protobag_native import FixedRateTimeSyncSpec
+  spec = FixedRateTimeSyncSpec()
+  spec.topics = ['ints']
+  spec.set_period(seconds=1, nanos=0)
+  with pytest.raises(ValueError):
+    list(bag.iter_entries(
+      selection=sel, where=[('value', '==', '2')], sync_at_fixed_rate=spec))
+
+
+def test_iter_entries_shards():
+  test_root = get_test_tempdir('test_iter_entries_shards')
+  path = os.path.join(test_root, 'bag.zip')
+
+  bag = protobag.Protobag(path=path)
+  writer = bag.create_writer()
+  for t in range(10):
+    writer.write_stamped_msg("ints", to_std_msg(t), t_sec=t)
+  writer.close()
+
+  sel = protobag.SelectionBuilder.select_window(topics=['ints'])
+  shards = [
+    [
+      entry.msg.value
+      for entry in bag.iter_entries(
+        selection=sel, shard_index=i, num_shards=3)
+    ]
+    for i in range(3)
+  ]
+  assert shards == [[0, 1, 2], [3, 4, 5], [6, 7, 8, 9]]
+
+
+def test_iter_entries_shuffle():
+  test_root = get_test_tempdir('test_iter_entries_shuffle')
+  path = os.path.join(test_root, 'bag.zip')
+
+  bag = protobag.Protobag(path=path)
+  writer = bag.create_writer()
+  for t in range(20):
+    writer.write_stamped_msg("ints", to_std_msg(t), t_sec=t)
+  writer.close()
+
+  from protobag.protobag_native import ReadShuffleSpec
+  def _read_shuffled(seed):
+    spec = ReadShuffleSpec()
+    spec.block_size = 2
+    spec.buffer_size = 4
+    spec.seed = seed
+    sel = protobag.SelectionBuilder.select_window(topics=['ints'])
+    return [
+      entry.msg.value
+      for entry in bag.iter_entries(selection=sel, shuffle=spec)
+    ]
+
+  values = _read_shuffled(1)
+  assert values == _read_shuffled(1)
+  assert values != list(range(20))
+  assert sorted(values) == list(range(20))
+
 
 def test_write_read_raw():
   test_root = get_test_tempdir('test_write_read_raw')
@@ -455,6 +623,11 @@ def test_write_read_raw():
   assert entry.entryname == 'raw_data'
   assert entry.raw_bytes == b"i am a raw string"
 
+  # Payloads are exposed without copying
+  assert isinstance(entry.raw_bytes, memoryview)
+  assert entry.raw_bytes.readonly
+  assert 'i am a raw string' in str(entry)
+
 
 ## ============================================================================
 ## == Test DictRowEntry =======================================================
@@ -508,6 +681,7 @@ def test_dict_row_entry_round_trip():
   assert row.entryname == "raw_data"
   assert row.type_url == ''
   assert row.msg_dict == {'protobag_raw_entry_bytes': b"i am a raw string"}
+  pickle.loads(pickle.dumps(row.msg_dict))
   writer.write_entry(row.to_entry())
 
   writer.close()